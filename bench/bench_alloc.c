@@ -0,0 +1,235 @@
+// bench_alloc.c — heap allocations per pairing on simulated devices (Linux, glibc).
+//
+// Interposes malloc/calloc/realloc/free, pairs `n` controllers one after
+// another through sixaxis_process_one (read, compare-then-write, forced
+// write + verify) and reports allocations per pairing once warm. The first
+// controller is paired once as a warm-up (one-time setup such as the profile
+// index, stdio buffers and the first deadline helper) and is not counted.
+//
+// Runs twice: on the mock transport, and on the hidraw backend against a fake
+// /sys + /dev tree with the default deadline set, so the deadline helper path
+// is covered too. The hidraw nodes are regular files; ioctl is interposed as
+// well and answers the descriptor and feature requests for them like a DS4.
+// The pairing path is meant to allocate nothing, so any steady-state
+// allocation on either transport fails.
+//
+// usage: bench_alloc [controllers=200] [mock spec=ds4=N/2,ds3=N/2,decoy=20]
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/hidraw.h>
+
+#include "hid_transport.h"
+#include "hid_transport_mock.h"
+#include "sixaxis_pair.h"
+#include "sixaxis_profile.h"
+
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void  __libc_free(void *);
+
+static atomic_ulong allocs;
+
+void *malloc(size_t n)            { allocs++; return __libc_malloc(n); }
+void *calloc(size_t n, size_t sz) { allocs++; return __libc_calloc(n, sz); }
+void *realloc(void *p, size_t n)  { allocs++; return __libc_realloc(p, n); }
+void  free(void *p)               { __libc_free(p); }
+
+// ---------- fake hidraw DS4s ----------
+// Every node is a regular file; a real hidraw fd is a character device, so
+// anything else is passed through to the kernel.
+#define DS4_PID 0x09CC
+
+typedef struct { ino_t ino; uint8_t host[6]; } fake_dev;
+
+static fake_dev fakes[MOCK_MAX_DEVICES];
+static size_t   nfakes;
+static const sixaxis_profile *ds4;
+
+static fake_dev *fake_of(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return NULL;
+    for (size_t i = 0; i < nfakes; i++)
+        if (fakes[i].ino == st.st_ino) return &fakes[i];
+    return NULL;
+}
+
+// Vendor collection declaring the profile's MAC report only.
+static size_t ds4_desc(uint8_t *out) {
+    size_t k = 0;
+    out[k++] = 0x06; out[k++] = 0x00; out[k++] = 0xFF;   // Usage Page (vendor)
+    out[k++] = 0x09; out[k++] = 0x01;                    // Usage
+    out[k++] = 0xA1; out[k++] = 0x01;                    // Collection (Application)
+    out[k++] = 0x85; out[k++] = ds4->report_id;          // Report ID
+    out[k++] = 0x75; out[k++] = 0x08;                    // Report Size 8
+    out[k++] = 0x95; out[k++] = (uint8_t)(ds4->report_len - 1); // Report Count
+    out[k++] = 0x09; out[k++] = ds4->report_id;          // Usage
+    out[k++] = 0xB1; out[k++] = 0x02;                    // Feature (Data,Var,Abs)
+    out[k++] = 0xC0;                                     // End Collection
+    return k;
+}
+
+int ioctl(int fd, unsigned long req, ...) {
+    va_list ap;
+    va_start(ap, req);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+    fake_dev *d = fake_of(fd);
+    if (!d) return (int)syscall(SYS_ioctl, fd, req, arg);
+
+    uint8_t desc[32];
+    size_t desc_len = ds4_desc(desc);
+    if (req == HIDIOCGRDESCSIZE) { *(int *)arg = (int)desc_len; return 0; }
+    if (req == HIDIOCGRDESC) {
+        struct hidraw_report_descriptor *rd = (struct hidraw_report_descriptor *)arg;
+        memcpy(rd->value, desc, desc_len);
+        rd->size = (uint32_t)desc_len;
+        return 0;
+    }
+    uint8_t *buf = (uint8_t *)arg;
+    size_t len = _IOC_SIZE(req);
+    if (_IOC_TYPE(req) == 'H' && len >= ds4->report_len && buf[0] == ds4->report_id) {
+        if (_IOC_NR(req) == _IOC_NR(HIDIOCGFEATURE(0))) {
+            memset(buf + 1, 0, len - 1);
+            sixaxis_profile_put_mac(ds4, buf, d->host);
+            return (int)len;
+        }
+        if (_IOC_NR(req) == _IOC_NR(HIDIOCSFEATURE(0))) {
+            sixaxis_profile_get_mac(ds4, buf, d->host);
+            return (int)len;
+        }
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+static void write_file(const char *path, const char *text) {
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); exit(1); }
+    fputs(text, f);
+    fclose(f);
+}
+
+// <root>/sys/hidrawN/device/uevent and an empty <root>/dev/hidrawN per DS4.
+static void make_tree(const char *root, size_t n) {
+    char p[HID_PATH_MAX], text[256];
+    snprintf(p, sizeof(p), "%s/sys", root); mkdir(p, 0755);
+    snprintf(p, sizeof(p), "%s/dev", root); mkdir(p, 0755);
+    for (size_t i = 0; i < n; i++) {
+        snprintf(p, sizeof(p), "%s/sys/hidraw%zu", root, i);        mkdir(p, 0755);
+        snprintf(p, sizeof(p), "%s/sys/hidraw%zu/device", root, i); mkdir(p, 0755);
+        snprintf(p, sizeof(p), "%s/sys/hidraw%zu/device/uevent", root, i);
+        snprintf(text, sizeof(text), "HID_ID=0003:%08X:%08X\nHID_NAME=Fake Wireless Controller\n",
+                 SONY_VID, DS4_PID);
+        write_file(p, text);
+        snprintf(p, sizeof(p), "%s/dev/hidraw%zu", root, i);
+        write_file(p, "");
+        struct stat st;
+        if (stat(p, &st) != 0) { perror(p); exit(1); }
+        fakes[i].ino = st.st_ino;
+    }
+    nfakes = n;
+}
+
+static void remove_tree(const char *root, size_t n) {
+    char p[HID_PATH_MAX];
+    for (size_t i = 0; i < n; i++) {
+        snprintf(p, sizeof(p), "%s/sys/hidraw%zu/device/uevent", root, i); unlink(p);
+        snprintf(p, sizeof(p), "%s/sys/hidraw%zu/device", root, i);        rmdir(p);
+        snprintf(p, sizeof(p), "%s/sys/hidraw%zu", root, i);               rmdir(p);
+        snprintf(p, sizeof(p), "%s/dev/hidraw%zu", root, i);               unlink(p);
+    }
+    snprintf(p, sizeof(p), "%s/sys", root); rmdir(p);
+    snprintf(p, sizeof(p), "%s/dev", root); rmdir(p);
+    rmdir(root);
+}
+
+// ---------- passes ----------
+static sixaxis_device devs[MOCK_MAX_DEVICES];
+
+// Pairs devs[1..n) four times; adds to *total and *failed.
+static void run_passes(const hid_transport *tp, size_t n, unsigned long *total, size_t *failed) {
+    static const uint8_t mac[6] = { 0x11,0x22,0x33,0x44,0x55,0x66 };
+    static const char *const passes[] = { "read", "update", "unchanged", "force" };
+    sixaxis_batch_opts update = { 1, SIXAXIS_VERIFY_DEFAULT, 0, NULL, NULL, 0 };
+    sixaxis_batch_opts force  = { 1, SIXAXIS_VERIFY_DEFAULT, 1, NULL, NULL, 0 };
+
+    // Warm-up on devs[0]: one-time setup is not steady state.
+    sixaxis_process_one(tp, &devs[0], mac, &update);
+
+    printf("%s: %zu controllers, 1 warm-up, %zu measured per pass\n", tp->name, n, n - 1);
+    for (int p = 0; p < 4; p++) {
+        unsigned long before = allocs;
+        for (size_t i = 1; i < n; i++) {
+            sixaxis_device *d = &devs[i];
+            if (p == 0)      sixaxis_process_one(tp, d, NULL, &update);
+            else if (p == 3) sixaxis_process_one(tp, d, mac, &force);
+            else             sixaxis_process_one(tp, d, mac, &update);
+            if (d->result == SIXAXIS_SET_FAILED || d->result == SIXAXIS_SET_TIMEOUT) (*failed)++;
+        }
+        unsigned long used = allocs - before;
+        *total += used;
+        printf("  %-10s %8zu pairings %8lu allocations (%.2f per pairing)\n",
+               passes[p], n - 1, used, (double)used / (double)(n - 1));
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 200;
+    char spec[128];
+    if (argc > 2) snprintf(spec, sizeof(spec), "%s", argv[2]);
+    else snprintf(spec, sizeof(spec), "ds4=%zu,ds3=%zu,decoy=20", n - n / 2, n / 2);
+    if (n == 0 || !mock_hid_configure(spec)) {
+        fprintf(stderr, "usage: %s [controllers] [mock spec]\n", argv[0]);
+        return 1;
+    }
+
+    unsigned long total = 0;
+    size_t pairings = 0, failed = 0;
+
+    const hid_transport *tp = &hid_transport_mock;
+    tp->set_timeout(SIXAXIS_DEFAULT_TIMEOUT_MS);
+    size_t found = sixaxis_enumerate(tp, devs, MOCK_MAX_DEVICES);
+    if (found > MOCK_MAX_DEVICES) found = MOCK_MAX_DEVICES;
+    if (found < 2) { fprintf(stderr, "need at least 2 simulated controllers in '%s'\n", spec); return 1; }
+    printf("spec: %s\n", spec);
+    run_passes(tp, found, &total, &failed);
+    pairings += 4 * (found - 1);
+
+    // Same pairings through hidraw, deadline helpers included.
+    size_t nhid = n < 2 ? 2 : n > MOCK_MAX_DEVICES ? MOCK_MAX_DEVICES : n;
+    char root[] = "/tmp/sixaxis_allocXXXXXX";
+    if (!mkdtemp(root)) { perror("mkdtemp"); return 1; }
+    ds4 = sixaxis_profile_for(SONY_VID, DS4_PID);
+    make_tree(root, nhid);
+    char sys[HID_PATH_MAX], dev[HID_PATH_MAX];
+    snprintf(sys, sizeof(sys), "%s/sys", root);
+    snprintf(dev, sizeof(dev), "%s/dev", root);
+    hidraw_set_roots(sys, dev);
+    tp = &hid_transport_hidraw;
+    tp->set_timeout(SIXAXIS_DEFAULT_TIMEOUT_MS);
+    found = sixaxis_enumerate(tp, devs, MOCK_MAX_DEVICES);
+    if (found > MOCK_MAX_DEVICES) found = MOCK_MAX_DEVICES;
+    if (found >= 2) {
+        run_passes(tp, found, &total, &failed);
+        pairings += 4 * (found - 1);
+    } else {
+        fprintf(stderr, "hidraw: fake tree in %s enumerated %zu nodes\n", root, found);
+        failed++;
+    }
+    remove_tree(root, nhid);
+
+    printf("steady state: %.2f allocations per pairing, %zu failed\n",
+           (double)total / (double)pairings, failed);
+    return total ? 3 : failed ? 2 : 0;
+}
@@ -0,0 +1,126 @@
+// bench_enumerate.c — enumeration cost with N decoy HID interfaces (Linux hidraw).
+//
+// Builds a fake /sys/class/hidraw + /dev tree with `decoys` non-Sony nodes and
+// `sony` DS4 nodes, then times the VID-filtered enumerate against the old
+// strategy of opening every node to learn its vendor ID, and against the
+// device cache (devcache.h) looking up only the interfaces it remembers.
+//
+// Times are raw. The fake nodes are plain files that open in about a
+// microsecond, so here reading sysfs costs more than opening every node; what
+// the filtered scan saves is the opens, each a driver round trip on real
+// hardware, which this bench counts but cannot time. Exits 3 if the filtered
+// scan or the cache revalidation opens any node.
+//
+// usage: bench_enumerate [decoys=200] [sony=2] [reps=200]
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/hidraw.h>
+
+#include "devcache.h"
+#include "hid_transport.h"
+#include "sixaxis_stats.h"
+
+static void write_file(const char *path, const char *text) {
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); exit(1); }
+    fputs(text, f);
+    fclose(f);
+}
+
+static void make_node(const char *root, int n, unsigned vid, unsigned pid, const char *name) {
+    char p[HID_PATH_MAX], text[256];
+    snprintf(p, sizeof(p), "%s/sys/hidraw%d", root, n);           mkdir(p, 0755);
+    snprintf(p, sizeof(p), "%s/sys/hidraw%d/device", root, n);    mkdir(p, 0755);
+    snprintf(p, sizeof(p), "%s/sys/hidraw%d/device/uevent", root, n);
+    snprintf(text, sizeof(text), "DRIVER=hid-generic\nHID_ID=0003:%08X:%08X\nHID_NAME=%s\n", vid, pid, name);
+    write_file(p, text);
+    snprintf(p, sizeof(p), "%s/dev/hidraw%d", root, n);
+    write_file(p, "");
+}
+
+static int count_cb(const hid_device_info *d, void *user) {
+    (void)d;
+    (*(int *)user)++;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int decoys = argc > 1 ? atoi(argv[1]) : 200;
+    int sony   = argc > 2 ? atoi(argv[2]) : 2;
+    int reps   = argc > 3 ? atoi(argv[3]) : 200;
+
+    char root[] = "/tmp/sixaxis_enumXXXXXX";
+    if (!mkdtemp(root)) { perror("mkdtemp"); return 1; }
+    char sys[HID_PATH_MAX], dev[HID_PATH_MAX];
+    snprintf(sys, sizeof(sys), "%s/sys", root); mkdir(sys, 0755);
+    snprintf(dev, sizeof(dev), "%s/dev", root); mkdir(dev, 0755);
+
+    for (int i = 0; i < decoys; i++) make_node(root, i, 0x046D, 0xC000 + (unsigned)i, "Logitech decoy");
+    for (int i = 0; i < sony; i++)   make_node(root, decoys + i, SONY_VID, 0x09CC, "Sony Wireless Controller");
+    hidraw_set_roots(sys, dev);
+
+    const hid_transport *tp = &hid_transport_hidraw;
+
+    // VID-filtered enumeration (current backend).
+    unsigned long opens0 = hidraw_open_count();
+    int found = 0;
+    uint64_t t0 = sixaxis_clock_ns();
+    for (int r = 0; r < reps; r++) tp->enumerate(SONY_VID, count_cb, &found);
+    double filtered_ms = (double)(sixaxis_clock_ns() - t0) / 1e6 / reps;
+    unsigned long filtered_opens = (hidraw_open_count() - opens0) / (unsigned long)reps;
+
+    // Old strategy: open every node, ask for its vendor, close.
+    unsigned long naive_opens = 0;
+    t0 = sixaxis_clock_ns();
+    for (int r = 0; r < reps; r++) {
+        DIR *d = opendir(dev);
+        struct dirent *e;
+        while ((e = readdir(d)) != NULL) {
+            if (strncmp(e->d_name, "hidraw", 6) != 0) continue;
+            char p[HID_PATH_MAX];
+            snprintf(p, sizeof(p), "%s/%s", dev, e->d_name);
+            int fd = open(p, O_RDWR | O_CLOEXEC);
+            naive_opens++;
+            if (fd < 0) continue;
+            struct hidraw_devinfo di;
+            char name[HID_STR_MAX];
+            if (ioctl(fd, HIDIOCGRAWINFO, &di) == 0) (void)ioctl(fd, HIDIOCGRAWNAME(sizeof(name)), name);
+            close(fd);
+        }
+        closedir(d);
+    }
+    double naive_ms = (double)(sixaxis_clock_ns() - t0) / 1e6 / reps;
+
+    // Device cache: primed by one scan, then each run revalidates the cached paths.
+    static devcache dc;
+    devcache_scan(&dc, tp);
+    opens0 = hidraw_open_count();
+    int cached = 0;
+    t0 = sixaxis_clock_ns();
+    for (int r = 0; r < reps; r++) {
+        devcache_revalidate(&dc, tp);
+        cached += (int)dc.n;
+    }
+    double cache_ms = (double)(sixaxis_clock_ns() - t0) / 1e6 / reps;
+    unsigned long cache_opens = (hidraw_open_count() - opens0) / (unsigned long)reps;
+
+    printf("interfaces: %d decoy + %d sony, %d reps (plain-file nodes, raw times)\n", decoys, sony, reps);
+    printf("%-18s %10s %12s %8s\n", "strategy", "opens/run", "ms/run", "found");
+    printf("%-18s %10lu %12.4f %8d\n", "vid-filtered", filtered_opens, filtered_ms, found / reps);
+    printf("%-18s %10lu %12.4f %8s\n", "open-every-node", naive_opens / (unsigned long)reps, naive_ms, "-");
+    printf("%-18s %10lu %12.4f %8d\n", "device-cache", cache_opens, cache_ms, cached / reps);
+
+    char cmd[HID_PATH_MAX + 16];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", root);
+    if (system(cmd) != 0) fprintf(stderr, "could not remove %s\n", root);
+    if (found / reps != sony || cached / reps != sony) return 1;
+    return filtered_opens || cache_opens ? 3 : 0;
+}
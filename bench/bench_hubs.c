@@ -0,0 +1,105 @@
+// bench_hubs.c — controllers per minute across hub trees, with and without a
+// per-hub transfer cap.
+//
+// Sets a new MAC on 7 simulated DS4s per hub for 1..8 hubs through
+// sixaxis_set_many. Each hub of the mock carries hub_max transfers at once and
+// refuses the rest as busy, like a contended control pipe; refused transfers
+// cost the verify backoff. Runs for hub_max 1, 2, 4 and 8 (or the one given)
+// and compares no cap, caps of 1, 2 and 4, and the default, each the best of
+// REPS runs. The default must
+// reach 2/3 of the best setting at every hub count and hub_max (else exit 3),
+// so it has to find each hub's limit rather than match one guess.
+//
+// usage: bench_hubs [hub_max=1,2,4,8] [xfer_us=2000] [jobs=32]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hid_transport_mock.h"
+#include "sixaxis_pair.h"
+#include "sixaxis_stats.h"
+
+static sixaxis_device devs[64];
+
+#define REPS 3
+
+// Controllers per minute for one hub count, hub_max and cap, best of REPS
+// runs; prints a row.
+static double run(unsigned hubs, unsigned hub_max, unsigned cap, unsigned xfer_us, unsigned jobs) {
+    const hid_transport *tp = &hid_transport_mock;
+    double best_ms = 0, rate = 0;
+    size_t failed = 0;
+    unsigned long contention = 0;
+    for (int r = 0; r < REPS; r++) {
+        mock_hid_config cfg;
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.get_us = cfg.set_us = xfer_us;
+        cfg.hub_max = hub_max;
+        mock_hid_reset(&cfg);
+        mock_hid_populate(hubs * 7, 0, 0, 0);
+        tp->set_timeout(SIXAXIS_DEFAULT_TIMEOUT_MS);
+
+        size_t n = sixaxis_enumerate(tp, devs, 64);
+        if (n > 64) n = 64;
+        static const uint8_t mac[6] = { 0x11,0x22,0x33,0x44,0x55,0x66 };
+        sixaxis_batch_opts opts = { jobs, SIXAXIS_VERIFY_DEFAULT, 0, NULL, NULL, cap };
+        uint64_t t0 = sixaxis_clock_ns();
+        size_t ok = sixaxis_set_many(tp, mac, devs, n, &opts);
+        double ms = (double)(sixaxis_clock_ns() - t0) / 1e6;
+        if (r > 0 && (double)ok * 60000.0 / ms <= rate) continue;
+        mock_hid_stats st;
+        mock_hid_get_stats(&st);
+        best_ms = ms;
+        rate = (double)ok * 60000.0 / ms;
+        failed = n - ok;
+        contention = st.hub_contention;
+    }
+    char name[16];
+    if (cap == SIXAXIS_PER_HUB_UNLIMITED) snprintf(name, sizeof(name), "-");
+    else if (cap == SIXAXIS_DEFAULT_PER_HUB) snprintf(name, sizeof(name), "def %u", cap);
+    else snprintf(name, sizeof(name), "%u", cap);
+    printf("%7u %5u %8s  %9.1f %12.0f %7zu %11lu\n", hub_max, hubs, name, best_ms, rate, failed,
+           contention);
+    return rate;
+}
+
+int main(int argc, char **argv) {
+    unsigned xfer_us = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 10) : 2000;
+    unsigned jobs    = argc > 3 ? (unsigned)strtoul(argv[3], NULL, 10) : 32;
+    unsigned hub_maxes[4] = { 1, 2, 4, 8 };
+    size_t nmax = 4;
+    static const unsigned hub_counts[] = { 1, 2, 4, 8 };
+    const unsigned want[] = { SIXAXIS_PER_HUB_UNLIMITED, 1, 2, 4 };
+    unsigned caps[5];
+    size_t ncaps = 0, def;
+    int bad = 0;
+    if (argc > 1) { hub_maxes[0] = (unsigned)strtoul(argv[1], NULL, 10); nmax = 1; }
+    if (hub_maxes[0] == 0 || jobs == 0) {
+        fprintf(stderr, "usage: %s [hub_max>=1] [xfer_us] [jobs>=1]\n", argv[0]);
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(want) / sizeof(want[0]); i++)
+        if (want[i] != SIXAXIS_DEFAULT_PER_HUB) caps[ncaps++] = want[i];
+    def = ncaps;
+    caps[ncaps++] = SIXAXIS_DEFAULT_PER_HUB;
+
+    printf("get/set %u us, %u jobs, 7 controllers per hub\n", xfer_us, jobs);
+    printf("%7s %5s %8s  %9s %12s %7s %11s\n", "hub_max", "hubs", "per_hub", "ms", "ctrl/min",
+           "failed", "contention");
+    for (size_t m = 0; m < nmax; m++) {
+        for (size_t h = 0; h < sizeof(hub_counts) / sizeof(hub_counts[0]); h++) {
+            double rate[5], best = 0;
+            for (size_t c = 0; c < ncaps; c++) {
+                rate[c] = run(hub_counts[h], hub_maxes[m], caps[c], xfer_us, jobs);
+                if (c != def && rate[c] > best) best = rate[c];
+            }
+            if (rate[def] * 3 < best * 2) {
+                printf("        default reaches %.0f%% of the best setting\n", 100.0 * rate[def] / best);
+                bad = 1;
+            }
+        }
+    }
+    return bad ? 3 : 0;
+}
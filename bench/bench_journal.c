@@ -0,0 +1,121 @@
+// bench_journal.c — journal throughput with several threads appending at once.
+//
+// Each of `threads` threads appends `records` pairing records as fast as it
+// can, the journal is closed (final commit + fsync), then the file is read
+// back. Reports records per second including the fsyncs, and fails (exit 3)
+// if a record is missing or torn.
+//
+// usage: bench_journal [threads=8] [records=20000]
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "journal.h"
+#include "sixaxis_stats.h"
+
+#define MAX_THREADS 64
+
+typedef struct {
+    journal      *j;
+    unsigned      id;
+    unsigned long records;
+} worker;
+
+#ifdef _WIN32
+static DWORD WINAPI run(LPVOID arg)
+#else
+static void *run(void *arg)
+#endif
+{
+    worker *w = (worker *)arg;
+    journal_record r;
+    memset(&r, 0, sizeof(r));
+    r.vid = 0x054C;
+    r.pid = 0x05C4;
+    r.op = JOURNAL_OP_SET;
+    r.flags = JOURNAL_F_OLD_MAC;
+    for (unsigned long i = 0; i < w->records; i++) {
+        r.time_us = journal_now_us();
+        r.latency_us = (uint32_t)i;
+        r.new_mac[4] = (uint8_t)w->id;
+        r.new_mac[5] = (uint8_t)i;
+        snprintf(r.serial, sizeof(r.serial), "a05a%02x%06lx", w->id, i);
+        snprintf(r.path, sizeof(r.path), "/dev/hidraw%u", w->id);
+        journal_append(w->j, &r);
+    }
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+static int count_cb(const journal_record *r, void *user) {
+    (void)r;
+    (*(unsigned long *)user)++;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    unsigned threads = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 10) : 8;
+    unsigned long records = argc > 2 ? strtoul(argv[2], NULL, 10) : 20000;
+    const char *file = "bench_journal.bin";
+    if (threads == 0 || threads > MAX_THREADS || records == 0) {
+        fprintf(stderr, "usage: %s [threads<=%d] [records per thread]\n", argv[0], MAX_THREADS);
+        return 1;
+    }
+
+    char err[256];
+    remove(file);
+    journal *j = journal_open(file, err, sizeof(err));
+    if (!j) { fprintf(stderr, "%s\n", err); return 1; }
+
+    worker w[MAX_THREADS];
+#ifdef _WIN32
+    HANDLE t[MAX_THREADS];
+#else
+    pthread_t t[MAX_THREADS];
+#endif
+    uint64_t t0 = sixaxis_clock_ns();
+    for (unsigned i = 0; i < threads; i++) {
+        w[i].j = j;
+        w[i].id = i;
+        w[i].records = records;
+#ifdef _WIN32
+        t[i] = CreateThread(NULL, 0, run, &w[i], 0, NULL);
+#else
+        pthread_create(&t[i], NULL, run, &w[i]);
+#endif
+    }
+    for (unsigned i = 0; i < threads; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(t[i], INFINITE);
+        CloseHandle(t[i]);
+#else
+        pthread_join(t[i], NULL);
+#endif
+    }
+    double t_append = (double)(sixaxis_clock_ns() - t0) / 1e3;
+    journal_close(j);
+    double t_total = (double)(sixaxis_clock_ns() - t0) / 1e3;
+
+    unsigned long got = 0, want = records * threads;
+    int torn = 0;
+    long n = journal_read(file, count_cb, &got, &torn, err, sizeof(err));
+    remove(file);
+    if (n < 0) { fprintf(stderr, "%s\n", err); return 1; }
+
+    printf("records: %lu from %u threads, %.0f ns/append\n", want, threads, t_append * 1e3 / (double)want);
+    printf("durable: %.1f ms, %.0f records/s (fsync included)\n", t_total / 1e3, (double)want * 1e6 / t_total);
+    printf("read back: %lu%s\n", got, torn ? " (torn tail)" : "");
+    return got == want && !torn ? 0 : 3;
+}
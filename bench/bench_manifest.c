@@ -0,0 +1,56 @@
+// bench_manifest.c — manifest load time and lookup cost as the row count grows.
+//
+// Writes a CSV manifest of `rows` serial -> MAC rows, loads it, then looks up
+// `lookups` serials (half present, half absent) and reports the load time and
+// nanoseconds per lookup. Flat ns/lookup across row counts means O(1).
+//
+// usage: bench_manifest [rows=100000] [lookups=1000000]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "manifest.h"
+#include "sixaxis_stats.h"
+
+int main(int argc, char **argv) {
+    unsigned long rows = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    unsigned long lookups = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+    const char *file = "bench_manifest.csv";
+    if (rows == 0 || rows > 0xFFFFFF || lookups == 0) {
+        fprintf(stderr, "usage: %s [rows<=16777215] [lookups]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(file, "w");
+    if (!f) { perror(file); return 1; }
+    fprintf(f, "serial,mac\n");
+    for (unsigned long i = 0; i < rows; i++)
+        fprintf(f, "1c:a0:b8:%02lx:%02lx:%02lx,00:1a:7d:%02lx:%02lx:%02lx\n",
+                (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF, (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF);
+    fclose(f);
+
+    char err[256];
+    uint64_t t0 = sixaxis_clock_ns();
+    manifest *m = manifest_load(file, err, sizeof(err));
+    double t_load = (double)(sixaxis_clock_ns() - t0) / 1e3;
+    remove(file);
+    if (!m) { fprintf(stderr, "%s\n", err); return 1; }
+
+    // Present keys in the first half, absent (other OUI) in the second.
+    unsigned long hits = 0;
+    char key[32];
+    t0 = sixaxis_clock_ns();
+    for (unsigned long i = 0; i < lookups; i++) {
+        unsigned long k = (i * 2654435761ul) % rows;
+        snprintf(key, sizeof(key), "%s%06lx", i < lookups / 2 ? "1ca0b8" : "ffffff", k);
+        hits += manifest_find(m, MANIFEST_KEY_SERIAL, key) != NULL;
+    }
+    double t_find = (double)(sixaxis_clock_ns() - t0) / 1e3;
+
+    printf("rows: %zu, load %.1f ms (%.0f ns/row)\n", manifest_rows(m), t_load / 1e3,
+           t_load * 1e3 / (double)rows);
+    printf("lookups: %lu, %lu hits, %.0f ns/lookup (key formatting included)\n",
+           lookups, hits, t_find * 1e3 / (double)lookups);
+    manifest_free(m);
+    return hits == lookups - lookups / 2 ? 0 : 3;
+}
@@ -0,0 +1,98 @@
+// bench_pairing.c — per-phase latency of the pairing sequence on simulated devices.
+//
+// Runs find_sony_hid (enumerate) -> open -> session caps (feature_lengths) ->
+// do_get_mac -> do_set_mac -> close for many iterations against the mock
+// transport and reports p50/p95/p99 per phase plus cycles per second.
+//
+// usage: bench_pairing [iterations=20000] [mock spec=ds4=1,decoy=20]
+//   e.g. bench_pairing 2000 ds4=1,decoy=40,open_us=300,get_us=1000,set_us=1000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hid_transport_mock.h"
+#include "sixaxis_pair.h"
+#include "sixaxis_stats.h"
+
+enum { PH_ENUM, PH_OPEN, PH_CAPS, PH_GET, PH_SET, PH_CYCLE, PH_COUNT };
+static const char *phase_names[PH_COUNT] = { "enumerate", "open", "caps", "get", "set", "cycle" };
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double pct(const double *sorted, size_t n, double p) {
+    size_t i = (size_t)(p * (double)(n - 1) + 0.5);
+    return sorted[i];
+}
+
+int main(int argc, char **argv) {
+    size_t iters = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+    const char *spec = argc > 2 ? argv[2] : "ds4=1,decoy=20";
+    if (iters == 0 || !mock_hid_configure(spec)) {
+        fprintf(stderr, "usage: %s [iterations] [mock spec]\n", argv[0]);
+        return 1;
+    }
+
+    const hid_transport *tp = &hid_transport_mock;
+    double *samples[PH_COUNT];
+    for (int p = 0; p < PH_COUNT; p++) {
+        samples[p] = (double *)malloc(iters * sizeof(double));
+        if (!samples[p]) { fprintf(stderr, "OOM\n"); return 1; }
+    }
+
+    static const uint8_t targets[2][6] = { {0x11,0x22,0x33,0x44,0x55,0x66}, {0xaa,0xbb,0xcc,0xdd,0xee,0xff} };
+    char err[128];
+    size_t failures = 0;
+    uint64_t t_all = sixaxis_clock_ns();
+
+    for (size_t i = 0; i < iters; i++) {
+        hid_device_info d;
+        sixaxis_session s;
+        uint8_t cur[6];
+        uint64_t t0 = sixaxis_clock_ns(), t1, t2, t3, t4, t5;
+
+        if (!find_sony_hid(tp, &d)) { fprintf(stderr, "no simulated controller in '%s'\n", spec); return 1; }
+        t1 = sixaxis_clock_ns();
+        hid_handle h = tp->open(d.path);
+        t2 = sixaxis_clock_ns();
+        if (h == HID_INVALID_HANDLE) { failures++; continue; }
+        int ok = sixaxis_session_attach(&s, tp, h, &d, err, sizeof(err));
+        t3 = sixaxis_clock_ns();
+        ok = ok && do_get_mac(&s, cur, err, sizeof(err));
+        t4 = sixaxis_clock_ns();
+        ok = ok && do_set_mac(&s, targets[i & 1], err, sizeof(err));
+        t5 = sixaxis_clock_ns();
+        sixaxis_session_close(&s);
+        if (!ok) failures++;
+
+        samples[PH_ENUM][i]  = (double)(t1 - t0) / 1e3;
+        samples[PH_OPEN][i]  = (double)(t2 - t1) / 1e3;
+        samples[PH_CAPS][i]  = (double)(t3 - t2) / 1e3;
+        samples[PH_GET][i]   = (double)(t4 - t3) / 1e3;
+        samples[PH_SET][i]   = (double)(t5 - t4) / 1e3;
+        samples[PH_CYCLE][i] = (double)(sixaxis_clock_ns() - t0) / 1e3;
+    }
+    double elapsed = (double)(sixaxis_clock_ns() - t_all) / 1e3;
+
+    printf("spec: %s, %zu iterations, %zu failed\n", spec, iters, failures);
+    printf("%-10s %10s %10s %10s %10s %12s\n", "phase", "p50 us", "p95 us", "p99 us", "mean us", "ops/s");
+    for (int p = 0; p < PH_COUNT; p++) {
+        double sum = 0;
+        for (size_t i = 0; i < iters; i++) sum += samples[p][i];
+        qsort(samples[p], iters, sizeof(double), cmp_double);
+        double mean = sum / (double)iters;
+        printf("%-10s %10.2f %10.2f %10.2f %10.2f %12.0f\n", phase_names[p],
+               pct(samples[p], iters, 0.50), pct(samples[p], iters, 0.95),
+               pct(samples[p], iters, 0.99), mean, mean > 0 ? 1e6 / mean : 0.0);
+        free(samples[p]);
+    }
+    printf("throughput: %.0f cycles/s (%.0f controllers/min)\n",
+           (double)iters * 1e6 / elapsed, (double)iters * 6e7 / elapsed);
+    mock_hid_stats st;
+    mock_hid_get_stats(&st);
+    printf("feature bytes: %.1f per cycle\n", (double)st.bytes / (double)iters);
+    return failures ? 3 : 0;
+}
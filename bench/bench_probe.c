@@ -0,0 +1,78 @@
+// bench_probe.c — serial vs parallel probe pass as the interface count grows.
+//
+// For each count N the mock transport lists N Sony interfaces (DS3s and
+// dongles, the one DS4 last, so find_sony_hid cannot stop early) behind 50
+// decoys, each probe costing probe_us like the open + attribute/string reads
+// of a real interface. Times a full enumerate and find_sony_hid with one
+// probe thread and with `jobs`, and checks both pick the same interface.
+//
+// usage: bench_probe [probe_us=1000] [jobs=8] [reps=5]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hid_probe.h"
+#include "hid_transport_mock.h"
+#include "sixaxis_pair.h"
+#include "sixaxis_stats.h"
+
+static int count_cb(const hid_device_info *d, void *user) {
+    (void)d;
+    (*(int *)user)++;
+    return 0;
+}
+
+// Best of reps, in ms; *picked is what find_sony_hid chose.
+static void run(unsigned jobs, int reps, double *enum_ms, double *find_ms, hid_device_info *picked) {
+    const hid_transport *tp = &hid_transport_mock;
+    hid_probe_set_jobs(jobs);
+    *enum_ms = *find_ms = 1e30;
+    for (int r = 0; r < reps; r++) {
+        int n = 0;
+        uint64_t t0 = sixaxis_clock_ns();
+        tp->enumerate(SONY_VID, count_cb, &n);
+        uint64_t t1 = sixaxis_clock_ns();
+        if (!find_sony_hid(tp, picked)) { fprintf(stderr, "no simulated controller\n"); exit(1); }
+        uint64_t t2 = sixaxis_clock_ns();
+        double e = (double)(t1 - t0) / 1e6, f = (double)(t2 - t1) / 1e6;
+        if (e < *enum_ms) *enum_ms = e;
+        if (f < *find_ms) *find_ms = f;
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned probe_us = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 10) : 1000;
+    unsigned jobs     = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 10) : HID_PROBE_JOBS;
+    int      reps     = argc > 3 ? atoi(argv[3]) : 5;
+    static const int counts[] = { 2, 4, 8, 16, 32, 64, 128 };
+    if (jobs < 2 || reps < 1) {
+        fprintf(stderr, "usage: %s [probe_us] [jobs>=2] [reps]\n", argv[0]);
+        return 1;
+    }
+
+    printf("probe_us=%u, %u probe threads, best of %d\n", probe_us, jobs, reps);
+    printf("%6s  %12s %12s %7s  %12s %12s %7s\n", "sony", "enum 1 ms", "enum N ms", "x",
+           "find 1 ms", "find N ms", "x");
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        mock_hid_config cfg;
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.probe_us = probe_us;
+        mock_hid_reset(&cfg);
+        mock_hid_populate(0, 0, 0, 50);
+        for (int i = 0; i < counts[c] - 1; i++) mock_hid_add(SONY_VID, i % 2 ? 0x0BA0 : 0x0268);
+        mock_hid_add(SONY_VID, 0x05C4);
+
+        double e1, f1, en, fn;
+        hid_device_info serial_pick, parallel_pick;
+        run(1, reps, &e1, &f1, &serial_pick);
+        run(jobs, reps, &en, &fn, &parallel_pick);
+        if (strcmp(serial_pick.path, parallel_pick.path) != 0) {
+            fprintf(stderr, "picks differ: %s vs %s\n", serial_pick.path, parallel_pick.path);
+            return 3;
+        }
+        printf("%6d  %12.2f %12.2f %6.1fx  %12.2f %12.2f %6.1fx\n", counts[c],
+               e1, en, e1 / en, f1, fn, f1 / fn);
+    }
+    return 0;
+}
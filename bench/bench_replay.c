@@ -0,0 +1,94 @@
+// bench_replay.c — a recorded batch replayed at several speeds.
+//
+// Records sixaxis_set_many over simulated DS4s with transfer latency,
+// injected failures and slow-settling firmware, then replays the capture
+// through the same call at the recorded pace, 10x and without waiting.
+// Every replay must reach the recorded outcome for each controller with no
+// divergence (else exit 3); a changed pairing path shows up as a mismatch or as time.
+// Recorded gaps, durations and the verify backoff all scale with the speed;
+// a capture from the field can be given instead.
+//
+// usage: bench_replay [controllers=32] [xfer_us=2000] [jobs=8] [capture.sxc]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hid_capture.h"
+#include "hid_transport_mock.h"
+#include "sixaxis_pair.h"
+#include "sixaxis_stats.h"
+
+#define MAX_DEVS 256
+
+static const uint8_t mac[6] = { 0x11,0x22,0x33,0x44,0x55,0x66 };
+static sixaxis_device recorded[MAX_DEVS], devs[MAX_DEVS];
+
+static size_t pair_all(const hid_transport *tp, sixaxis_device *d, unsigned jobs, double *ms) {
+    tp->set_timeout(SIXAXIS_DEFAULT_TIMEOUT_MS);
+    size_t n = sixaxis_enumerate(tp, d, MAX_DEVS);
+    if (n > MAX_DEVS) n = MAX_DEVS;
+    sixaxis_batch_opts opts = { jobs, SIXAXIS_VERIFY_DEFAULT, 0, NULL, NULL, 0 };
+    uint64_t t0 = sixaxis_clock_ns();
+    sixaxis_set_many(tp, mac, d, n, &opts);
+    *ms = (double)(sixaxis_clock_ns() - t0) / 1e6;
+    return n;
+}
+
+static int find(const sixaxis_device *list, size_t n, const char *path) {
+    for (size_t i = 0; i < n; i++)
+        if (strcmp(list[i].info.path, path) == 0) return (int)i;
+    return -1;
+}
+
+int main(int argc, char **argv) {
+    unsigned count   = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 10) : 32;
+    unsigned xfer_us = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 10) : 2000;
+    unsigned jobs    = argc > 3 ? (unsigned)strtoul(argv[3], NULL, 10) : 8;
+    const char *capture = argc > 4 ? argv[4] : "bench_replay.sxc";
+    static const double speeds[] = { 1.0, 10.0, 0.0 };
+    char err[256];
+    double ms;
+    size_t nrec = 0;
+    int bad = 0;
+    if (count == 0 || count > MAX_DEVS || jobs == 0) {
+        fprintf(stderr, "usage: %s [controllers 1..%d] [xfer_us] [jobs>=1] [capture.sxc]\n", argv[0], MAX_DEVS);
+        return 1;
+    }
+
+    if (argc <= 4) {
+        mock_hid_config cfg;
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.get_us = cfg.set_us = xfer_us;
+        cfg.fail_every = 11;
+        cfg.settle_reads = 1;
+        mock_hid_reset(&cfg);
+        mock_hid_populate(count, 0, 0, 0);
+        const hid_transport *tp = hid_capture_start(&hid_transport_mock, capture, err, sizeof(err));
+        if (!tp) { fprintf(stderr, "%s\n", err); return 1; }
+        nrec = pair_all(tp, recorded, jobs, &ms);
+        if (!hid_capture_stop(err, sizeof(err))) { fprintf(stderr, "%s\n", err); return 1; }
+        printf("recorded %zu controllers, get/set %u us, %u jobs: %.1f ms\n", nrec, xfer_us, jobs, ms);
+    }
+
+    printf("%8s %10s %9s %12s %10s\n", "speed", "ms", "paired", "divergences", "mismatch");
+    for (size_t s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++) {
+        const hid_transport *tp = hid_replay_open(capture, speeds[s], err, sizeof(err));
+        if (!tp) { fprintf(stderr, "%s\n", err); return 1; }
+        size_t n = pair_all(tp, devs, jobs, &ms);
+        size_t paired = 0, mismatch = 0;
+        for (size_t i = 0; i < n; i++) {
+            int r = nrec ? find(recorded, nrec, devs[i].info.path) : -1;
+            if (devs[i].result == SIXAXIS_SET_VERIFIED || devs[i].result == SIXAXIS_SET_UNCHANGED) paired++;
+            if (nrec && (r < 0 || recorded[r].result != devs[i].result)) mismatch++;
+        }
+        hid_replay_stats st;
+        hid_replay_get_stats(&st);
+        char sp[16];
+        if (speeds[s] > 0) snprintf(sp, sizeof(sp), "%gx", speeds[s]);
+        else snprintf(sp, sizeof(sp), "max");
+        printf("%8s %10.1f %9zu %12lu %10zu\n", sp, ms, paired, st.divergences, mismatch);
+        if (st.divergences || mismatch) bad = 1;
+    }
+    return bad ? 3 : 0;
+}
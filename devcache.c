@@ -0,0 +1,216 @@
+// devcache.c — see devcache.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "devcache.h"
+#include "sixaxis_stats.h"
+
+#define HEADER "sixaxis-devcache 1"
+
+// A DS4 controller: the top sony_rank, nothing plugged in since can beat it.
+static int is_top_rank(const hid_device_info *d) {
+    return d->vid == SONY_VID && sony_rank(d->pid) == 0;
+}
+
+static devcache_entry *find(devcache *c, const char *path) {
+    for (size_t i = 0; i < c->n; i++)
+        if (strcmp(c->entries[i].info.path, path) == 0) return &c->entries[i];
+    return NULL;
+}
+
+// ---------- file ----------
+// Splits off the next tab-separated field (the rest of the line for the last).
+static char *field(char **p) {
+    char *f = *p, *tab = f ? strchr(f, '\t') : NULL;
+    if (tab) *tab = 0;
+    *p = tab ? tab + 1 : NULL;
+    return f;
+}
+
+static void copy(char *dst, size_t len, const char *src) {
+    snprintf(dst, len, "%s", src ? src : "");
+}
+
+void devcache_load(devcache *c, const char *file) {
+    char line[HID_PATH_MAX + 2 * HID_STR_MAX + HID_PORT_MAX + 64];
+    FILE *f = fopen(file, "r");
+    memset(c, 0, sizeof(*c));
+    if (!f) return;
+    if (!fgets(line, sizeof(line), f) || strncmp(line, HEADER, strlen(HEADER)) != 0) {
+        fclose(f);
+        return;
+    }
+    while (c->n < DEVCACHE_MAX && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = 0;
+        char *p = line, *path = field(&p), *vid = field(&p), *pid = field(&p);
+        char *feat = field(&p), *rep = field(&p), *serial = field(&p), *port = field(&p);
+        if (!path[0] || !port) continue; // torn or foreign line
+
+        devcache_entry *e = &c->entries[c->n];
+        memset(e, 0, sizeof(*e));
+        copy(e->info.path, sizeof(e->info.path), path);
+        e->info.vid = (uint16_t)strtoul(vid, NULL, 16);
+        e->info.pid = (uint16_t)strtoul(pid, NULL, 16);
+        e->feat_len = (uint16_t)strtoul(feat, NULL, 10);
+        e->report_len = (uint16_t)strtoul(rep, NULL, 10);
+        copy(e->info.serial, sizeof(e->info.serial), serial);
+        copy(e->info.port, sizeof(e->info.port), port);
+        copy(e->info.product, sizeof(e->info.product), p);
+        if (e->info.vid == SONY_VID && !find(c, path)) c->n++;
+    }
+    fclose(f);
+}
+
+// Tabs or line breaks inside a string would shift the fields.
+static void put_field(FILE *f, const char *s, char end) {
+    for (; *s; s++) fputc(*s == '\t' || *s == '\r' || *s == '\n' ? ' ' : *s, f);
+    fputc(end, f);
+}
+
+int devcache_save(devcache *c, const char *file) {
+    if (!c->dirty) return 1;
+    FILE *f = fopen(file, "w");
+    if (!f) return 0;
+    fprintf(f, "%s\n", HEADER);
+    for (size_t i = 0; i < c->n; i++) {
+        const devcache_entry *e = &c->entries[i];
+        put_field(f, e->info.path, '\t');
+        fprintf(f, "%04x\t%04x\t%u\t%u\t", e->info.vid, e->info.pid,
+                (unsigned)e->feat_len, (unsigned)e->report_len);
+        put_field(f, e->info.serial, '\t');
+        put_field(f, e->info.port, '\t');
+        put_field(f, e->info.product, '\n');
+    }
+    if (fclose(f) != 0) return 0;
+    c->dirty = 0;
+    return 1;
+}
+
+// ---------- lookup ----------
+int devcache_revalidate(devcache *c, const hid_transport *tp) {
+    uint64_t t0 = sixaxis_stats_begin();
+    int top = 0;
+    size_t k = 0;
+    for (size_t i = 0; i < c->n; i++) {
+        devcache_entry e = c->entries[i];
+        hid_device_info now;
+        if (!tp->lookup(e.info.path, &now) || now.vid != e.info.vid || now.pid != e.info.pid) {
+            c->dirty = 1;
+            continue;
+        }
+        // Same model at the same path; serial or port may still differ (another unit).
+        if (memcmp(&now, &e.info, sizeof(now)) != 0) {
+            e.info = now;
+            c->dirty = 1;
+        }
+        top |= is_top_rank(&e.info);
+        c->entries[k++] = e;
+    }
+    c->n = k;
+    sixaxis_stats_end(SIXAXIS_PHASE_ENUMERATE, t0, 1, 0, NULL);
+    return top;
+}
+
+typedef struct {
+    devcache       *old;
+    devcache_entry  entries[DEVCACHE_MAX];
+    size_t          n;
+} scan_ctx;
+
+static int scan_cb(const hid_device_info *d, void *user) {
+    scan_ctx *s = (scan_ctx *)user;
+    if (s->n == DEVCACHE_MAX) return 1;
+    devcache_entry *e = &s->entries[s->n++];
+    const devcache_entry *was = find(s->old, d->path);
+    memset(e, 0, sizeof(*e));
+    e->info = *d;
+    if (was && was->info.pid == d->pid) {
+        e->feat_len = was->feat_len;
+        e->report_len = was->report_len;
+    }
+    return 0;
+}
+
+int devcache_scan(devcache *c, const hid_transport *tp) {
+    scan_ctx s;
+    s.old = c;
+    s.n = 0;
+    uint64_t t0 = sixaxis_stats_begin();
+    int n = tp->enumerate(SONY_VID, scan_cb, &s);
+    sixaxis_stats_end(SIXAXIS_PHASE_ENUMERATE, t0, n >= 0, 0, NULL);
+    if (n < 0) return -1;
+    if (s.n != c->n || memcmp(s.entries, c->entries, s.n * sizeof(s.entries[0])) != 0) {
+        memcpy(c->entries, s.entries, s.n * sizeof(s.entries[0]));
+        c->n = s.n;
+        c->dirty = 1;
+    }
+    return (int)c->n;
+}
+
+static void fill(sixaxis_device *dev, const devcache_entry *e) {
+    dev->info = e->info;
+    dev->feat_len = e->feat_len;
+    dev->report_len = e->report_len;
+}
+
+// Preferred interface: the lowest sony_rank, the first one on a tie, as
+// find_sony_hid picks it. A cached DS4 is taken without enumerating; anything
+// less is ranked against a fresh enumeration, so a DS4 plugged in at a new
+// path still beats a cached DS3.
+static int pick_best(devcache *c, const hid_transport *tp, sixaxis_device *dev, int *hit) {
+    int cached = devcache_revalidate(c, tp);
+    if (hit) *hit = cached;
+    if (!cached && devcache_scan(c, tp) <= 0) return 0;
+
+    const devcache_entry *best = NULL;
+    for (size_t i = 0; i < c->n; i++)
+        if (!best || sony_rank(c->entries[i].info.pid) < sony_rank(best->info.pid)) best = &c->entries[i];
+    if (!best) return 0;
+    fill(dev, best);
+    return 1;
+}
+
+int devcache_select(devcache *c, const hid_transport *tp, const sixaxis_selector *sel,
+                    sixaxis_device *dev, int *hit) {
+    if (!sel) return pick_best(c, tp, dev, hit);
+    if (hit) *hit = 0;
+    if (sel->path) {
+        // Looked up directly either way; the cache only contributes lengths.
+        if (!sixaxis_select(tp, sel, &dev->info)) return 0;
+        const devcache_entry *e = find(c, dev->info.path);
+        dev->feat_len = e && e->info.pid == dev->info.pid ? e->feat_len : 0;
+        dev->report_len = e && e->info.pid == dev->info.pid ? e->report_len : 0;
+        if (hit) *hit = e != NULL;
+        return 1;
+    }
+    // The cache cannot tell enumeration order, so index always enumerates.
+    if (sel->index < 0) {
+        devcache_revalidate(c, tp);
+        for (size_t i = 0; i < c->n; i++) {
+            if (!sixaxis_selector_match(sel, &c->entries[i].info)) continue;
+            fill(dev, &c->entries[i]);
+            if (hit) *hit = 1;
+            return 1;
+        }
+    }
+    dev->feat_len = dev->report_len = 0;
+    return sixaxis_select(tp, sel, &dev->info);
+}
+
+void devcache_note(devcache *c, const hid_device_info *info, uint16_t feat_len, uint16_t report_len) {
+    if (!feat_len || info->vid != SONY_VID) return;
+    devcache_entry *e = find(c, info->path);
+    if (!e) {
+        if (c->n == DEVCACHE_MAX) return;
+        e = &c->entries[c->n++];
+        memset(e, 0, sizeof(*e));
+        e->info = *info;
+    } else if (e->info.pid != info->pid || (e->feat_len == feat_len && e->report_len == report_len)) {
+        return;
+    }
+    e->feat_len = feat_len;
+    e->report_len = report_len;
+    c->dirty = 1;
+}
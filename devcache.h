@@ -0,0 +1,66 @@
+// devcache.h — remembered Sony interfaces for a fast cold start.
+//
+// Finding the controller normally takes a full HID enumeration (SetupAPI
+// plus an open per interface on Windows) and opening it a caps query. The
+// cache keeps every Sony interface seen last time with its VID/PID, serial,
+// port, product and the feature lengths a session measured. On the next
+// start each cached path is looked up on its own (tp->lookup: that interface
+// only) and kept only while its VID/PID still match.
+//
+// The cache is a shortcut, not a different choice: the full enumeration is
+// skipped only while a cached DS4 is left, since nothing plugged in since can
+// outrank it. With only a DS3 or a dongle cached, everything is enumerated
+// and ranked again, so a DS4 at a new path wins as it would without a cache.
+//
+// File: a "sixaxis-devcache 1" line, then one tab-separated line per interface:
+//   path vid pid feat_len report_len serial port product
+
+#ifndef DEVCACHE_H
+#define DEVCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hid_transport.h"
+#include "sixaxis_pair.h"
+
+#define DEVCACHE_MAX 16
+
+typedef struct {
+    hid_device_info info;
+    uint16_t        feat_len;    // 0 until a session measured them
+    uint16_t        report_len;
+} devcache_entry;
+
+typedef struct {
+    devcache_entry entries[DEVCACHE_MAX];
+    size_t         n;
+    int            dirty;        // changed since devcache_load
+} devcache;
+
+// A missing, unreadable or foreign file loads as an empty cache.
+void devcache_load(devcache *c, const char *file);
+// Writes the cache if it changed. Returns 0 if the file could not be written.
+int  devcache_save(devcache *c, const char *file);
+
+// Looks every cached path up again, dropping the ones that are gone or now
+// hold another VID/PID. Returns 1 if a DS4 controller is left, i.e. when an
+// enumeration could not find a better device.
+int  devcache_revalidate(devcache *c, const hid_transport *tp);
+// Full enumeration: the cache becomes the Sony interfaces present now,
+// keeping measured lengths of those that did not change. Returns the count,
+// or -1 if the list is unavailable.
+int  devcache_scan(devcache *c, const hid_transport *tp);
+
+// find_sony_hid (sel NULL) or sixaxis_select through the cache. Fills
+// dev->info and the known lengths for sixaxis_process_one; *hit (may be NULL)
+// is 1 when the cache knew the device. With sel, a device the cache does
+// not hold is searched with sixaxis_select's early exit rather than a full
+// scan. Returns 0 when nothing matches.
+int  devcache_select(devcache *c, const hid_transport *tp, const sixaxis_selector *sel,
+                     sixaxis_device *dev, int *hit);
+// Remembers the lengths a session measured (sixaxis_device or sixaxis_session
+// feat_len/report_len) for info.
+void devcache_note(devcache *c, const hid_device_info *info, uint16_t feat_len, uint16_t report_len);
+
+#endif // DEVCACHE_H
@@ -3,63 +3,35 @@
 #endif
 #include <windows.h>
 #include <windowsx.h>
-#include <setupapi.h>
-#include <hidsdi.h>
 #include <commctrl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
-#pragma comment(lib, "setupapi.lib")
-#pragma comment(lib, "hid.lib")
+#include "hid_transport.h"
+#include "hid_transport_mock.h"
+#include "sixaxis_pair.h"
+#include "devcache.h"
+#include "hid_capture.h"
+#include "journal.h"
+#include "presets.h"
+#include "sixaxis_stats.h"
+
 #pragma comment(lib, "comctl32.lib")
 
-/* -------- PID helpers -------- */
-static int is_ds3_pid(USHORT pid){ return (pid==0x0268 || pid==0x042F); }
-static int is_ds4_controller_pid(USHORT pid){
-	switch(pid){ case 0x05C4: case 0x09CC: case 0x0CE6: case 0x0CDA: return 1; default: return 0; }
-}
-static int is_ds4_dongle_pid(USHORT pid){ return pid==0x0BA0; }
-static UCHAR pick_report_id(USHORT pid){ return is_ds3_pid(pid) ? 0xF5 : 0x12; }
-
-/* -------- utils -------- */
-static int char_to_nibble(char c){
-	if(c>='0'&&c<='9') return c-'0';
-	if(c>='a'&&c<='f') return c-'a'+10;
-	if(c>='A'&&c<='F') return c-'A'+10;
-	return -1;
-}
-static int mac_to_bytesA(const char* in, size_t in_len, unsigned char out6[6]){
-	size_t i=0, p=0;
-	while (p+1<in_len && i<6){
-		if(in[p]==':'){ p++; continue; }
-		if(char_to_nibble(in[p])<0 || char_to_nibble(in[p+1])<0) return 0;
-		out6[i++] = (unsigned char)((char_to_nibble(in[p])<<4) | char_to_nibble(in[p+1]));
-		p+=2;
-	}
-	return i==6;
-}
-static void bytes_to_macA_forward(const unsigned char b[6], char out[18]){
-	sprintf(out,"%02x:%02x:%02x:%02x:%02x:%02x",b[0],b[1],b[2],b[3],b[4],b[5]);
-}
-static void bytes_to_macA_reverse(const unsigned char b[6], char out[18]){
-	sprintf(out,"%02x:%02x:%02x:%02x:%02x:%02x",b[5],b[4],b[3],b[2],b[1],b[0]);
-}
+/* SIXAXIS_TRANSPORT=mock (+ SIXAXIS_MOCK spec) runs the GUI against simulated devices;
+   SIXAXIS_RECORD=FILE captures its HID traffic for --replay (hid_capture.h). */
+static const hid_transport *tp = HID_TRANSPORT_DEFAULT;
 
 /* -------- model -------- */
 typedef struct {
-	WCHAR  path[520];
-	USHORT pid;
-	WCHAR  label[160];
+	hid_device_info info;  /* as reported by the transport */
+	uint16_t        feat_len, report_len; /* from the device cache, 0 = query at open */
+	WCHAR           label[160];
 } DeviceItem;
 
-typedef struct {
-	WCHAR name[64];
-	WCHAR mac[32];  /* "aa:bb:cc:dd:ee:ff" */
-} Preset;
-
-/* -------- presets persistence -------- */
+/* -------- per-user files -------- */
 static int get_appdata_path(WCHAR out[MAX_PATH]){
 	DWORD n = GetEnvironmentVariableW(L"APPDATA", out, MAX_PATH);
 	return (n>0 && n<MAX_PATH);
@@ -67,62 +39,22 @@ static int get_appdata_path(WCHAR out[MAX_PATH]){
 static void ensure_dir_exists(const WCHAR* dir){
 	CreateDirectoryW(dir, NULL); /* no-op if exists */
 }
-static void get_presets_file_path(WCHAR out[MAX_PATH]){
-	WCHAR base[MAX_PATH]=L"";
+/* %APPDATA%\SixaxisPairer\<name> (created on demand), else .\<name>.
+   The core opens files with fopen/CreateFileA, so the path is returned in the ANSI code page. */
+static void get_app_file_path(const WCHAR* name, char out[MAX_PATH]){
+	WCHAR base[MAX_PATH]=L"", path[MAX_PATH];
+	_snwprintf(path, MAX_PATH-1, L".\\%ls", name);
 	if(get_appdata_path(base)){
-		_snwprintf(out, MAX_PATH-1, L"%ls\\SixaxisPairer", base);
-		ensure_dir_exists(out);
-		_snwprintf(out, MAX_PATH-1, L"%ls\\SixaxisPairer\\presets.txt", base);
-	}else{
-		lstrcpynW(out, L".\\presets.txt", MAX_PATH);
-	}
-}
-static int load_presets(Preset** arr, size_t* count){
-	*arr=NULL; *count=0;
-	WCHAR path[MAX_PATH]; get_presets_file_path(path);
-	FILE* f = _wfopen(path, L"rt, ccs=UTF-8");
-	if(!f) return 1; /* no presets yet = ok */
-
-	size_t cap=8; Preset* list=(Preset*)calloc(cap,sizeof(Preset));
-	if(!list){ fclose(f); return 0; }
-
-	WCHAR line[256];
-	while(fgetws(line, 256, f)){
-		/* strip newline */
-		size_t L=wcslen(line);
-		while(L>0 && (line[L-1]==L'\n' || line[L-1]==L'\r')){ line[--L]=0; }
-		if(L==0) continue;
-
-		/* expect name=mac */
-		WCHAR* eq = wcschr(line, L'=');
-		if(!eq) continue;
-		*eq = 0;
-		WCHAR* nm = line;
-		WCHAR* mc = eq+1;
-
-		if(*count==cap){
-			cap*=2;
-			Preset* tmp=(Preset*)realloc(list, cap*sizeof(Preset));
-			if(!tmp){ free(list); fclose(f); return 0; }
-			list=tmp;
-		}
-		lstrcpynW(list[*count].name, nm, 64);
-		lstrcpynW(list[*count].mac,  mc, 32);
-		(*count)++;
+		_snwprintf(path, MAX_PATH-1, L"%ls\\SixaxisPairer", base);
+		ensure_dir_exists(path);
+		_snwprintf(path, MAX_PATH-1, L"%ls\\SixaxisPairer\\%ls", base, name);
 	}
-	fclose(f);
-	*arr = list;
-	return 1;
-}
-static int save_presets(const Preset* arr, size_t count){
-	WCHAR path[MAX_PATH]; get_presets_file_path(path);
-	FILE* f = _wfopen(path, L"wt, ccs=UTF-8");
-	if(!f) return 0;
-	for(size_t i=0;i<count;i++){
-		fwprintf(f, L"%ls=%ls\n", arr[i].name, arr[i].mac);
+	BOOL lossy=FALSE;
+	path[MAX_PATH-1]=0;
+	if(!WideCharToMultiByte(CP_ACP,0,path,-1,out,MAX_PATH,NULL,&lossy) || lossy){
+		_snwprintf(path, MAX_PATH-1, L".\\%ls", name);
+		WideCharToMultiByte(CP_ACP,0,path,-1,out,MAX_PATH,NULL,NULL);
 	}
-	fclose(f);
-	return 1;
 }
 static int mac_format_okW(const WCHAR* mac){
 	/* accept XX:XX:XX:XX:XX:XX or XXXXXXXXXXXX */
@@ -138,147 +70,59 @@ static int mac_format_okW(const WCHAR* mac){
 }
 
 /* -------- enumerate Sony HID devices -------- */
-static DeviceItem* list_sony(size_t* count){
-	GUID g;
-	HDEVINFO devs;
-	SP_DEVICE_INTERFACE_DATA ifd;
-	DWORD idx=0, need=0;
-	DeviceItem* arr=0;
-	size_t cap=8;
-
-	*count=0;
-	HidD_GetHidGuid(&g);
-	devs = SetupDiGetClassDevs(&g, NULL, NULL, DIGCF_PRESENT|DIGCF_DEVICEINTERFACE);
-	if(devs==INVALID_HANDLE_VALUE) return NULL;
-
-	arr=(DeviceItem*)calloc(cap, sizeof(DeviceItem));
-	if(!arr){ SetupDiDestroyDeviceInfoList(devs); return NULL; }
-
-	ZeroMemory(&ifd, sizeof(ifd));
-	ifd.cbSize = sizeof(ifd);
-
-	while(SetupDiEnumDeviceInterfaces(devs, NULL, &g, idx++, &ifd)){
-		PSP_DEVICE_INTERFACE_DETAIL_DATA det;
-		HANDLE h;
-		HIDD_ATTRIBUTES a;
-		WCHAR prod[128]={0};
-
-		need=0;
-		SetupDiGetDeviceInterfaceDetail(devs, &ifd, NULL, 0, &need, NULL);
-		det=(PSP_DEVICE_INTERFACE_DETAIL_DATA)malloc(need);
-		if(!det) continue;
-		det->cbSize = sizeof(*det);
-
-		if(SetupDiGetDeviceInterfaceDetail(devs, &ifd, det, need, NULL, NULL)){
-			h = CreateFile(det->DevicePath, GENERIC_READ|GENERIC_WRITE,
-						   FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
-						   FILE_ATTRIBUTE_NORMAL, NULL);
-			if(h==INVALID_HANDLE_VALUE){
-				h = CreateFile(det->DevicePath, GENERIC_WRITE,
-							   FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
-							   FILE_ATTRIBUTE_NORMAL, NULL);
-			}
-			if(h!=INVALID_HANDLE_VALUE){
-				a.Size = sizeof(a);
-				if(HidD_GetAttributes(h, &a) && a.VendorID==0x054C){
-					if(*count==cap){
-						DeviceItem* tmp;
-						cap*=2;
-						tmp=(DeviceItem*)realloc(arr, cap*sizeof(DeviceItem));
-						if(!tmp){ CloseHandle(h); free(det); break; }
-						arr=tmp;
-					}
-					{
-						DeviceItem* it=&arr[*count];
-						ZeroMemory(it, sizeof(*it));
-						lstrcpynW(it->path, det->DevicePath, (int)(sizeof(it->path)/sizeof(WCHAR)));
-						it->pid = a.ProductID;
-
-						HidD_GetProductString(h, prod, sizeof(prod));
-						{
-							const WCHAR *kind = L"Sony HID";
-							if (is_ds4_controller_pid(a.ProductID)) kind = L"Controller";
-							else if (is_ds4_dongle_pid(a.ProductID)) kind = L"Dongle";
-							else if (is_ds3_pid(a.ProductID))       kind = L"DS3/Sixaxis";
-
-							if(prod[0])
-								_snwprintf(it->label, (int)(sizeof(it->label)/sizeof(WCHAR))-1,
-										   L"%ls — %ls (PID %04X)", kind, prod, a.ProductID);
-							else
-								_snwprintf(it->label, (int)(sizeof(it->label)/sizeof(WCHAR))-1,
-										   L"%ls (PID %04X)", kind, a.ProductID);
-						}
-						(*count)++;
-					}
-				}
-				CloseHandle(h);
-			}
-		}
-		free(det);
+typedef struct {
+	DeviceItem* arr;
+	size_t count, cap;
+} SonyList;
+
+static int list_sony_cb(const hid_device_info* d, void* user){
+	SonyList* l=(SonyList*)user;
+	DeviceItem* it;
+	WCHAR prod[HID_STR_MAX]={0};
+	const WCHAR *kind = L"Sony HID";
+	const sixaxis_profile *prof;
+
+	if(l->count==l->cap){
+		size_t cap = l->cap ? l->cap*2 : 8;
+		DeviceItem* tmp=(DeviceItem*)realloc(l->arr, cap*sizeof(DeviceItem));
+		if(!tmp) return 1; /* stop, keep what we have */
+		l->arr=tmp; l->cap=cap;
 	}
-	SetupDiDestroyDeviceInfoList(devs);
-	if(*count==0){ free(arr); return NULL; }
-	return arr;
-}
-
-/* -------- HID feature helpers -------- */
-static int get_feat_len(HANDLE h, USHORT* feat_len){
-	PHIDP_PREPARSED_DATA pp=NULL;
-	HIDP_CAPS caps;
-	NTSTATUS st;
-
-	if(!HidD_GetPreparsedData(h, &pp)) return 0;
-	st = HidP_GetCaps(pp, &caps);
-	HidD_FreePreparsedData(pp);
-	if(st != HIDP_STATUS_SUCCESS) return 0;
-	if(caps.FeatureReportByteLength < 8) return 0;
-	*feat_len = caps.FeatureReportByteLength;
-	return 1;
-}
-
-static int read_mac(HANDLE h, USHORT pid, UCHAR report_id, char out[18]){
-	USHORT L=0;
-	unsigned char* buf;
-	BOOL ok;
-
-	if(!get_feat_len(h,&L)) return 0;
-	buf=(unsigned char*)calloc(L,1);
-	if(!buf) return 0;
-
-	buf[0]=report_id; buf[1]=0x00;
-	ok = HidD_GetFeature(h, buf, L);
-	if(!ok){ free(buf); return 0; }
-
-	if(is_ds3_pid(pid)) bytes_to_macA_forward(buf+2,out);
-	else                bytes_to_macA_reverse(buf+2,out);
-
-	free(buf);
-	return 1;
+	it=&l->arr[l->count];
+	ZeroMemory(it, sizeof(*it));
+	it->info = *d;
+
+	prof = sixaxis_profile_find(d->vid, d->pid);
+	if (prof && prof->kind==SIXAXIS_KIND_DS4)         kind = L"Controller";
+	else if (prof && prof->kind==SIXAXIS_KIND_DONGLE) kind = L"Dongle";
+	else if (prof && prof->kind==SIXAXIS_KIND_DS3)    kind = L"DS3/Sixaxis";
+
+	if(d->product[0]) MultiByteToWideChar(CP_UTF8, 0, d->product, -1, prod, HID_STR_MAX-1);
+	if(prod[0])
+		_snwprintf(it->label, (int)(sizeof(it->label)/sizeof(WCHAR))-1,
+				   L"%ls — %ls (PID %04X)", kind, prod, d->pid);
+	else
+		_snwprintf(it->label, (int)(sizeof(it->label)/sizeof(WCHAR))-1,
+				   L"%ls (PID %04X)", kind, d->pid);
+	l->count++;
+	return 0;
 }
 
-static int write_mac(HANDLE h, USHORT pid, UCHAR report_id, const char* mac_str){
-	size_t n = strlen(mac_str);
-	unsigned char mac[6];
-	USHORT L=0;
-	unsigned char* buf;
-	BOOL ok;
-
-	if(!((n==12)||(n==17)) || !mac_to_bytesA(mac_str,n,mac)) return 0;
-	if(!get_feat_len(h,&L)) return 0;
-	buf=(unsigned char*)calloc(L,1);
-	if(!buf) return 0;
-
-	buf[0]=report_id; buf[1]=0x00;
-	if(is_ds3_pid(pid)){
-		memcpy(buf+2, mac, 6);
-	}else{
-		buf[2]=mac[5]; buf[3]=mac[4]; buf[4]=mac[3];
-		buf[5]=mac[2]; buf[6]=mac[1]; buf[7]=mac[0];
+/* The interfaces the device cache still finds at their old paths, or a full
+   enumeration when none is a DS4 controller or on rescan (Refresh). */
+static DeviceItem* list_sony(devcache* dc, int rescan, size_t* count){
+	SonyList l={0};
+	size_t i;
+	*count=0;
+	if(rescan || !devcache_revalidate(dc, tp)) devcache_scan(dc, tp);
+	for(i=0;i<dc->n;i++){
+		if(list_sony_cb(&dc->entries[i].info, &l)) break;
+		l.arr[l.count-1].feat_len=dc->entries[i].feat_len;
+		l.arr[l.count-1].report_len=dc->entries[i].report_len;
 	}
-
-	ok = HidD_SetFeature(h, buf, L);
-	free(buf);
-	return ok ? 1 : 0;
+	if(l.count==0){ free(l.arr); return NULL; }
+	*count=l.count;
+	return l.arr;
 }
 
 /* -------- GUI -------- */
@@ -298,13 +142,42 @@ typedef struct {
 	HWND hCombo, hEdit, hRead, hSet, hStatus, hRefresh;
 	HWND hPresetCombo, hPresetName, hSavePreset, hLoadPreset, hDelPreset;
 	DeviceItem* items; size_t nitems;
-	Preset* presets; size_t npresets;
+	preset_store* presets; /* loaded once; NULL if the file could not be opened */
+	sixaxis_session sess; size_t sess_item; /* selected device, kept open between clicks */
+	journal* jr; /* NULL if it could not be opened: sets still work, unlogged */
+	devcache dc; char dc_path[MAX_PATH]; /* saved whenever it changed */
+	char stats_path[MAX_PATH]; /* Prometheus text file, rewritten after each Read/Set */
 } App;
 
 static void set_status(HWND h, LPCWSTR msg){ SetWindowTextW(h, msg); }
 
-static void populate_devices(App* a){
-	size_t n=0; DeviceItem* items=list_sony(&n);
+/* Best effort: a scraper simply sees the previous file. */
+static void app_write_stats(App* a){
+	char err[128];
+	sixaxis_stats_write_prometheus(a->stats_path, err, sizeof(err));
+}
+
+/* Session for items[sel]: reused while the selection stays, reopened otherwise. */
+static sixaxis_session* app_session(App* a, int sel){
+	char err[128];
+	if(a->sess.h!=HID_INVALID_HANDLE && a->sess_item==(size_t)sel) return &a->sess;
+	DeviceItem* it=&a->items[sel];
+	sixaxis_session_close(&a->sess);
+	if(!sixaxis_session_open_known(&a->sess, tp, &it->info, it->feat_len, it->report_len, err, sizeof(err))) return NULL;
+	a->sess_item=(size_t)sel;
+	if(it->feat_len!=a->sess.feat_len || it->report_len!=a->sess.report_len){
+		it->feat_len=a->sess.feat_len; it->report_len=a->sess.report_len;
+		devcache_note(&a->dc, &it->info, it->feat_len, it->report_len);
+		devcache_save(&a->dc, a->dc_path);
+	}
+	return &a->sess;
+}
+
+static void populate_devices(App* a, int rescan){
+	size_t n=0; DeviceItem* items;
+	sixaxis_session_close(&a->sess); /* indices are about to change */
+	items=list_sony(&a->dc, rescan, &n);
+	devcache_save(&a->dc, a->dc_path);
 	SendMessage(a->hCombo, CB_RESETCONTENT, 0, 0);
 	if(a->items) free(a->items);
 	a->items = items; a->nitems = n;
@@ -314,23 +187,38 @@ static void populate_devices(App* a){
 		size_t i; int pick=0;
 		for(i=0;i<n;i++){
 			SendMessageW(a->hCombo, CB_ADDSTRING, 0, (LPARAM)items[i].label);
-			if(is_ds4_controller_pid(items[i].pid)) pick=(int)i; /* prefer controller */
+			if(is_ds4_controller_pid(items[i].info.pid)) pick=(int)i; /* prefer controller */
 		}
 		SendMessageW(a->hCombo, CB_SETCURSEL, pick, 0);
 		set_status(a->hStatus, L"Status: device list refreshed.");
 	}
 }
+static int add_preset_cb(const char* name, const uint8_t mac6[6], void* user){
+	WCHAR wname[PRESET_NAME_MAX];
+	(void)mac6;
+	MultiByteToWideChar(CP_UTF8,0,name,-1,wname,PRESET_NAME_MAX);
+	SendMessageW((HWND)user, CB_ADDSTRING, 0, (LPARAM)wname);
+	return 0;
+}
 static void populate_presets(App* a){
-	if(a->presets){ free(a->presets); a->presets=NULL; a->npresets=0; }
-	if(!load_presets(&a->presets, &a->npresets)){
+	char path[MAX_PATH], err[256];
+	get_app_file_path(L"presets.txt", path);
+	a->presets=presets_open(path, err, sizeof(err));
+	if(!a->presets){
 		set_status(a->hStatus, L"Status: failed to load presets.");
 		return;
 	}
-	SendMessage(a->hPresetCombo, CB_RESETCONTENT, 0, 0);
-	for(size_t i=0;i<a->npresets;i++){
-		SendMessageW(a->hPresetCombo, CB_ADDSTRING, 0, (LPARAM)a->presets[i].name);
-	}
-	if(a->npresets>0) SendMessage(a->hPresetCombo, CB_SETCURSEL, 0, 0);
+	presets_each(a->presets, add_preset_cb, a->hPresetCombo);
+	if(presets_count(a->presets)>0) SendMessage(a->hPresetCombo, CB_SETCURSEL, 0, 0);
+}
+/* UTF-8 name of the selected preset; 0 if none is selected. */
+static int selected_preset(App* a, int* sel, char name[PRESET_NAME_MAX]){
+	WCHAR wname[PRESET_NAME_MAX];
+	*sel=(int)SendMessage(a->hPresetCombo, CB_GETCURSEL, 0, 0);
+	if(*sel<0 || !a->presets) return 0;
+	if(SendMessageW(a->hPresetCombo, CB_GETLBTEXTLEN, *sel, 0)>=PRESET_NAME_MAX) return 0;
+	SendMessageW(a->hPresetCombo, CB_GETLBTEXT, *sel, (LPARAM)wname);
+	return WideCharToMultiByte(CP_UTF8,0,wname,-1,name,PRESET_NAME_MAX,NULL,NULL)>0;
 }
 
 static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam){
@@ -395,11 +283,21 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
 
 		a=(App*)calloc(1,sizeof(App));
 		if(!a) return -1;
+		a->sess.h=HID_INVALID_HANDLE;
 		a->hCombo=hCombo; a->hEdit=hEdit; a->hRead=hRead; a->hSet=hSet; a->hStatus=hStat; a->hRefresh=hRef;
 		a->hPresetCombo=hPresetCombo; a->hPresetName=hPresetName; a->hSavePreset=hSaveP; a->hLoadPreset=hLoadP; a->hDelPreset=hDelP;
 		SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)a);
+		{
+			char jpath[MAX_PATH], jerr[128];
+			get_app_file_path(L"journal.bin", jpath);
+			a->jr=journal_open(jpath, jerr, sizeof(jerr));
+		}
 
-		populate_devices(a);
+		get_app_file_path(L"devices.cache", a->dc_path);
+		devcache_load(&a->dc, a->dc_path);
+		get_app_file_path(L"sixaxis.prom", a->stats_path);
+		sixaxis_stats_enable(1);
+		populate_devices(a, 0);
 		populate_presets(a);
 		return 0;
 	}
@@ -409,7 +307,7 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
 		WORD id = LOWORD(wParam);
 
 		if(id==IDC_REFRESH){
-			populate_devices(app);
+			populate_devices(app, 1);
 			return 0;
 		}
 		if(id==IDC_READ || id==IDC_SET){
@@ -419,113 +317,126 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
 				return 0;
 			}
 			{
-				DeviceItem* it=&app->items[sel];
-				HANDLE h = CreateFileW(it->path, GENERIC_READ|GENERIC_WRITE,
-									   FILE_SHARE_READ|FILE_SHARE_WRITE, NULL,
-									   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-				if(h==INVALID_HANDLE_VALUE){
-					h = CreateFileW(it->path, GENERIC_WRITE,
-									FILE_SHARE_READ|FILE_SHARE_WRITE, NULL,
-									OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-				}
-				if(h==INVALID_HANDLE_VALUE){ set_status(app->hStatus, L"Open failed."); return 0; }
-
-				{
-					UCHAR report_id = pick_report_id(it->pid);
-					if(id==IDC_READ){
-						char mac[18]="";
-						if(read_mac(h, it->pid, report_id, mac)){
-							WCHAR wmac[18];
-							MultiByteToWideChar(CP_UTF8,0,mac,-1,wmac,18);
-							SetWindowTextW(app->hEdit, wmac);
-							set_status(app->hStatus, L"Status: MAC read OK.");
-						}else{
-							set_status(app->hStatus, L"Read failed (try replug USB).");
-						}
+				sixaxis_session* ss = app_session(app, sel);
+				char err[128];
+				if(!ss){ set_status(app->hStatus, L"Open failed."); app_write_stats(app); return 0; }
+
+				if(id==IDC_READ){
+					unsigned char cur[6];
+					if(do_get_mac(ss, cur, err, sizeof(err))){
+						char mac[18]; WCHAR wmac[18];
+						format_mac(cur, mac);
+						MultiByteToWideChar(CP_UTF8,0,mac,-1,wmac,18);
+						SetWindowTextW(app->hEdit, wmac);
+						set_status(app->hStatus, L"Status: MAC read OK.");
 					}else{
-						WCHAR wmac[64]; char macA[64];
-						GetWindowTextW(app->hEdit, wmac, 64);
-						if(!mac_format_okW(wmac)){
-							set_status(app->hStatus, L"Invalid MAC format. Use XX:XX:XX:XX:XX:XX.");
-							CloseHandle(h); return 0;
-						}
-						WideCharToMultiByte(CP_UTF8,0,wmac,-1,macA,64,NULL,NULL);
-						if(write_mac(h, it->pid, report_id, macA)){
-							set_status(app->hStatus, L"Status: MAC set OK (replug to verify).");
-						}else{
-							set_status(app->hStatus, L"Set failed.");
-						}
+						sixaxis_session_close(ss); /* reopen on the next click */
+						set_status(app->hStatus, L"Read failed (try replug USB).");
+					}
+				}else{
+					WCHAR wmac[64]; char macA[64]; unsigned char mac6[6]={0};
+					GetWindowTextW(app->hEdit, wmac, 64);
+					if(!mac_format_okW(wmac)){
+						set_status(app->hStatus, L"Invalid MAC format. Use XX:XX:XX:XX:XX:XX.");
+						return 0;
+					}
+					WideCharToMultiByte(CP_UTF8,0,wmac,-1,macA,64,NULL,NULL);
+					sixaxis_set_result r = SIXAXIS_SET_FAILED;
+					uint64_t t0 = sixaxis_clock_ns();
+					if(parse_mac(macA, mac6)) r = do_update_mac(ss, mac6, NULL, err, sizeof(err));
+					sixaxis_stats_result(r);
+					if(app->jr){
+						/* one interactive set: log it and wait for the disk before reporting */
+						sixaxis_device d;
+						journal_record rec;
+						memset(&d, 0, sizeof(d));
+						d.info=ss->info; d.result=r; memcpy(d.mac, mac6, 6);
+						d.has_old_mac=(uint8_t)(r!=SIXAXIS_SET_FAILED && ss->has_old_mac);
+						memcpy(d.old_mac, ss->old_mac, 6);
+						d.latency_us=(uint32_t)((sixaxis_clock_ns()-t0)/1000);
+						journal_record_device(&rec, &d, 1);
+						journal_append(app->jr, &rec);
+						journal_sync(app->jr);
+					}
+					if(r==SIXAXIS_SET_UNCHANGED){
+						set_status(app->hStatus, L"Status: MAC unchanged (already set).");
+					}else if(r==SIXAXIS_SET_VERIFIED){
+						set_status(app->hStatus, L"Status: MAC set and verified.");
+					}else if(r==SIXAXIS_SET_UNVERIFIED){
+						set_status(app->hStatus, L"Status: MAC set, readback did not match (replug to verify).");
+					}else{
+						sixaxis_session_close(ss);
+						set_status(app->hStatus, r==SIXAXIS_SET_TIMEOUT ? L"Set timed out (try replug USB)." : L"Set failed.");
 					}
 				}
-				CloseHandle(h);
+				app_write_stats(app);
 			}
 			return 0;
 		}
 
 		if(id==IDC_LOADP){
-			int sel=(int)SendMessage(app->hPresetCombo, CB_GETCURSEL, 0, 0);
-			if(sel<0 || (size_t)sel>=app->npresets){ set_status(app->hStatus, L"No preset selected."); return 0; }
-			SetWindowTextW(app->hEdit, app->presets[sel].mac);
-			SetWindowTextW(app->hPresetName, app->presets[sel].name);
+			int sel; char name[PRESET_NAME_MAX], mac[18]; unsigned char mac6[6];
+			WCHAR wname[PRESET_NAME_MAX], wmac[18];
+			if(!selected_preset(app, &sel, name) || !presets_find(app->presets, name, mac6)){ set_status(app->hStatus, L"No preset selected."); return 0; }
+			format_mac(mac6, mac);
+			MultiByteToWideChar(CP_UTF8,0,mac,-1,wmac,18);
+			MultiByteToWideChar(CP_UTF8,0,name,-1,wname,PRESET_NAME_MAX);
+			SetWindowTextW(app->hEdit, wmac);
+			SetWindowTextW(app->hPresetName, wname);
 			set_status(app->hStatus, L"Preset loaded into MAC field.");
 			return 0;
 		}
 		if(id==IDC_SAVEP){
-			WCHAR name[64]={0}, mac[64]={0};
-			int i;
-			GetWindowTextW(app->hPresetName, name, 64);
+			WCHAR name[PRESET_NAME_CHARS+1]={0}, mac[64]={0};
+			char nameA[PRESET_NAME_MAX], macA[64], err[256];
+			unsigned char mac6[6];
+			int added=0;
+			GetWindowTextW(app->hPresetName, name, PRESET_NAME_CHARS+1);
 			GetWindowTextW(app->hEdit, mac, 64);
 			if(name[0]==0){ set_status(app->hStatus, L"Enter a preset Name."); return 0; }
 			if(!mac_format_okW(mac)){ set_status(app->hStatus, L"Invalid MAC format."); return 0; }
+			if(!app->presets){ set_status(app->hStatus, L"Presets unavailable."); return 0; }
+			WideCharToMultiByte(CP_UTF8,0,mac,-1,macA,64,NULL,NULL);
+			if(!WideCharToMultiByte(CP_UTF8,0,name,-1,nameA,PRESET_NAME_MAX,NULL,NULL) || !parse_mac(macA, mac6)){
+				set_status(app->hStatus, L"Preset name too long.");
+				return 0;
+			}
 
-			/* upsert */
-			for(i=0;i<(int)app->npresets;i++){
-				if(_wcsicmp(app->presets[i].name, name)==0){
-					lstrcpynW(app->presets[i].mac, mac, 32);
-					if(!save_presets(app->presets, app->npresets)) set_status(app->hStatus, L"Failed to save presets.");
-					populate_presets(app);
-					set_status(app->hStatus, L"Preset updated.");
-					return 0;
-				}
+			/* upsert: one line appended, the list only grows for a new name */
+			if(!presets_put(app->presets, nameA, mac6, &added, err, sizeof(err))){
+				set_status(app->hStatus, L"Failed to save presets.");
+				return 0;
 			}
-			/* new */
-			{
-				Preset* tmp=(Preset*)realloc(app->presets, (app->npresets+1)*sizeof(Preset));
-				if(!tmp){ set_status(app->hStatus, L"Out of memory."); return 0; }
-				app->presets=tmp;
-				lstrcpynW(app->presets[app->npresets].name, name, 64);
-				lstrcpynW(app->presets[app->npresets].mac,  mac,  32);
-				app->npresets++;
-				if(!save_presets(app->presets, app->npresets)) set_status(app->hStatus, L"Failed to save presets.");
-				populate_presets(app);
+			if(added){
+				int at=(int)SendMessageW(app->hPresetCombo, CB_ADDSTRING, 0, (LPARAM)name);
+				SendMessage(app->hPresetCombo, CB_SETCURSEL, at, 0);
 				set_status(app->hStatus, L"Preset saved.");
+			}else{
+				int at=(int)SendMessageW(app->hPresetCombo, CB_FINDSTRINGEXACT, (WPARAM)-1, (LPARAM)name);
+				if(at>=0) SendMessage(app->hPresetCombo, CB_SETCURSEL, at, 0);
+				set_status(app->hStatus, L"Preset updated.");
 			}
 			return 0;
 		}
 		if(id==IDC_DELP){
-			int sel=(int)SendMessage(app->hPresetCombo, CB_GETCURSEL, 0, 0);
-			if(sel<0 || (size_t)sel>=app->npresets){ set_status(app->hStatus, L"No preset selected."); return 0; }
-			/* remove sel */
-			if(app->npresets>0){
-				for(size_t i=sel+1;i<app->npresets;i++) app->presets[i-1]=app->presets[i];
-				app->npresets--;
-				if(app->npresets==0){ free(app->presets); app->presets=NULL; }
-				else{
-					Preset* tmp=(Preset*)realloc(app->presets, app->npresets*sizeof(Preset));
-					if(tmp) app->presets=tmp;
-				}
-				if(!save_presets(app->presets, app->npresets)) set_status(app->hStatus, L"Failed to save presets.");
-				populate_presets(app);
-				set_status(app->hStatus, L"Preset deleted.");
-			}
+			int sel; char name[PRESET_NAME_MAX], err[256]="";
+			if(!selected_preset(app, &sel, name)){ set_status(app->hStatus, L"No preset selected."); return 0; }
+			presets_remove(app->presets, name, err, sizeof(err));
+			if(err[0]){ set_status(app->hStatus, L"Failed to save presets."); return 0; }
+			SendMessage(app->hPresetCombo, CB_DELETESTRING, sel, 0);
+			if(presets_count(app->presets)>0) SendMessage(app->hPresetCombo, CB_SETCURSEL, (size_t)sel<presets_count(app->presets) ? sel : sel-1, 0);
+			set_status(app->hStatus, L"Preset deleted.");
 			return 0;
 		}
 	}
 
 	if(msg==WM_DESTROY){
 		if(app){
+			sixaxis_session_close(&app->sess);
+			journal_close(app->jr);
 			if(app->items) free(app->items);
-			if(app->presets) free(app->presets);
+			presets_close(app->presets);
+			{ char err[256]; hid_capture_stop(err, sizeof(err)); }
 			free(app);
 			SetWindowLongPtr(hwnd, GWLP_USERDATA, 0);
 		}
@@ -551,6 +462,20 @@ int APIENTRY wWinMain(HINSTANCE hInst, HINSTANCE hPrev, LPWSTR lpCmdLine, int nS
 	wcx.hbrBackground = (HBRUSH)(COLOR_WINDOW+1);
 	wcx.lpszClassName = cls;
 
+	{
+		char tname[16]="", spec[256]="", capture[MAX_PATH]="", err[256];
+		GetEnvironmentVariableA("SIXAXIS_MOCK", spec, sizeof(spec));
+		if(GetEnvironmentVariableA("SIXAXIS_TRANSPORT", tname, sizeof(tname)) && strcmp(tname,"mock")==0
+		   && mock_hid_configure(spec)){
+			tp = &hid_transport_mock;
+		}
+		if(GetEnvironmentVariableA("SIXAXIS_RECORD", capture, sizeof(capture))){
+			const hid_transport *rec = hid_capture_start(tp, capture, err, sizeof(err));
+			if(rec) tp = rec;
+		}
+		tp->set_timeout(SIXAXIS_DEFAULT_TIMEOUT_MS); /* a stuck device must not freeze the window */
+	}
+
 	if(!RegisterClassExW(&wcx)) return 0;
 
 	hwnd = CreateWindowExW(0, cls, L"Sixaxis/DS4 Pairer",
@@ -0,0 +1,900 @@
+// hid_capture.c — see hid_capture.h.
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <time.h>
+#endif
+#ifdef _MSC_VER
+#  define CAPTURE_TLS __declspec(thread)
+#else
+#  define CAPTURE_TLS _Thread_local
+#endif
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hid_capture.h"
+#include "sixaxis_stats.h"
+
+#define FILE_HEADER 16
+#define HEAD_SIZE   28
+#define VERSION     1
+
+#define STATUS_FAILED  0
+#define STATUS_OK      1
+#define STATUS_TIMEOUT 2
+
+// last_error() of a replayed call the capture cannot answer.
+#ifdef _WIN32
+#  define ERR_DIVERGED 31ul  // ERROR_GEN_FAILURE
+#  define ERR_GONE     2ul   // ERROR_FILE_NOT_FOUND
+#else
+#  define ERR_DIVERGED ((unsigned long)EIO)
+#  define ERR_GONE     ((unsigned long)ENOENT)
+#endif
+
+// A thread drives one transport at a time, so recorder and replay share it.
+static CAPTURE_TLS unsigned long last_err;
+
+#ifdef _WIN32
+static SRWLOCK lock = SRWLOCK_INIT;
+static CONDITION_VARIABLE drained = CONDITION_VARIABLE_INIT;
+static void lock_state(void)   { AcquireSRWLockExclusive(&lock); }
+static void unlock_state(void) { ReleaseSRWLockExclusive(&lock); }
+static void wait_drained(void) { SleepConditionVariableSRW(&drained, &lock, INFINITE, 0); }
+static void wake_drained(void) { WakeAllConditionVariable(&drained); }
+static void sleep_us(unsigned us) { if (us) Sleep((us + 999) / 1000); }
+#else
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  drained = PTHREAD_COND_INITIALIZER;
+static void lock_state(void)   { pthread_mutex_lock(&lock); }
+static void unlock_state(void) { pthread_mutex_unlock(&lock); }
+static void wait_drained(void) { pthread_cond_wait(&drained, &lock); }
+static void wake_drained(void) { pthread_cond_broadcast(&drained); }
+static void sleep_us(unsigned us) {
+    if (!us) return;
+    struct timespec ts = { (time_t)(us / 1000000u), (long)(us % 1000000u) * 1000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+#endif
+
+// ---------- encoding ----------
+static void put16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put32(uint8_t *p, uint32_t v) { put16(p, (uint16_t)v); put16(p + 2, (uint16_t)(v >> 16)); }
+static void put64(uint8_t *p, uint64_t v) { put32(p, (uint32_t)v); put32(p + 4, (uint32_t)(v >> 32)); }
+static uint16_t get16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t get32(const uint8_t *p) { return get16(p) | (uint32_t)get16(p + 2) << 16; }
+static uint64_t get64(const uint8_t *p) { return get32(p) | (uint64_t)get32(p + 4) << 32; }
+
+typedef struct {
+    uint8_t *p;
+    size_t   n, cap;
+    int      failed;
+} buf;
+
+static void buf_put(buf *b, const void *p, size_t n) {
+    if (b->failed) return;
+    if (b->n + n > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 1024;
+        while (cap < b->n + n) cap *= 2;
+        uint8_t *np = (uint8_t *)realloc(b->p, cap);
+        if (!np) { b->failed = 1; return; }
+        b->p = np;
+        b->cap = cap;
+    }
+    memcpy(b->p + b->n, p, n);
+    b->n += n;
+}
+
+static void put_str(buf *b, const char *s) {
+    uint8_t len[2];
+    size_t n = strlen(s);
+    put16(len, (uint16_t)n);
+    buf_put(b, len, 2);
+    buf_put(b, s, n);
+}
+
+static void put_device(buf *b, const hid_device_info *d) {
+    uint8_t ids[4];
+    put16(ids, d->vid);
+    put16(ids + 2, d->pid);
+    buf_put(b, ids, 4);
+    put_str(b, d->path);
+    put_str(b, d->product);
+    put_str(b, d->serial);
+    put_str(b, d->port);
+}
+
+static int get_str(const uint8_t **p, const uint8_t *end, char *out, size_t cap) {
+    if (end - *p < 2) return 0;
+    size_t n = get16(*p);
+    *p += 2;
+    if ((size_t)(end - *p) < n || n >= cap) return 0;
+    memcpy(out, *p, n);
+    out[n] = 0;
+    *p += n;
+    return 1;
+}
+
+static int get_device(const uint8_t **p, const uint8_t *end, hid_device_info *d) {
+    memset(d, 0, sizeof(*d));
+    if (end - *p < 4) return 0;
+    d->vid = get16(*p);
+    d->pid = get16(*p + 2);
+    *p += 4;
+    return get_str(p, end, d->path, sizeof(d->path)) && get_str(p, end, d->product, sizeof(d->product))
+        && get_str(p, end, d->serial, sizeof(d->serial)) && get_str(p, end, d->port, sizeof(d->port));
+}
+
+static uint8_t status_of(int ok, unsigned long error) {
+    if (ok) return STATUS_OK;
+    return error == HID_ERR_TIMEOUT ? STATUS_TIMEOUT : STATUS_FAILED;
+}
+
+// ---------- recording ----------
+typedef struct {
+    hid_handle h;
+    uint16_t   stream;
+} rec_handle;
+
+static const hid_transport *inner;
+static FILE    *out;
+static int      out_failed;
+static uint64_t rec_start;
+static char   **rec_paths;   // stream i + 1
+static size_t   rec_npaths, rec_cap;
+
+// Caller holds the lock.
+static void rec_write(uint8_t type, uint8_t status, uint16_t stream, uint8_t report, uint16_t arg,
+                      unsigned long error, uint64_t t0, uint64_t t1, const void *p, size_t n) {
+    uint8_t h[HEAD_SIZE];
+    if (!out) return;
+    uint64_t us = (t1 - t0) / 1000;
+    memset(h, 0, sizeof(h));
+    h[0] = type;
+    h[1] = status;
+    put16(h + 2, stream);
+    h[4] = report;
+    put16(h + 6, arg);
+    put32(h + 8, status == STATUS_OK ? 0 : (uint32_t)error);
+    put32(h + 12, us > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)us);
+    put64(h + 16, (t0 - rec_start) / 1000);
+    put32(h + 24, (uint32_t)n);
+    if (fwrite(h, 1, HEAD_SIZE, out) != HEAD_SIZE || (n && fwrite(p, 1, n, out) != n) || fflush(out) != 0)
+        out_failed = 1;
+}
+
+// Stream of path, declared on first use. Caller holds the lock.
+static uint16_t rec_stream(const char *path) {
+    for (size_t i = 0; i < rec_npaths; i++)
+        if (strcmp(rec_paths[i], path) == 0) return (uint16_t)(i + 1);
+    if (rec_npaths == 0xFFFE) { out_failed = 1; return 0; }
+    if (rec_npaths == rec_cap) {
+        size_t cap = rec_cap ? rec_cap * 2 : 64;
+        char **p = (char **)realloc(rec_paths, cap * sizeof(*p));
+        if (!p) { out_failed = 1; return 0; }
+        rec_paths = p;
+        rec_cap = cap;
+    }
+    size_t n = strlen(path);
+    char *copy = (char *)malloc(n + 1);
+    if (!copy) { out_failed = 1; return 0; }
+    memcpy(copy, path, n + 1);
+    rec_paths[rec_npaths++] = copy;
+    uint64_t t = sixaxis_clock_ns();
+    rec_write(CAPTURE_STREAM, STATUS_OK, (uint16_t)rec_npaths, 0, 0, 0, t, t, path, n);
+    return (uint16_t)rec_npaths;
+}
+
+typedef struct {
+    hid_enum_cb cb;
+    void       *user;
+    buf         list;
+} rec_enum;
+
+// Callbacks run on the enumerating thread (see hid_probe_run).
+static int rec_enum_cb(const hid_device_info *info, void *user) {
+    rec_enum *e = (rec_enum *)user;
+    put_device(&e->list, info);
+    return e->cb(info, e->user);
+}
+
+static int rec_enumerate(uint16_t vid, hid_enum_cb cb, void *user) {
+    rec_enum e;
+    memset(&e, 0, sizeof(e));
+    e.cb = cb;
+    e.user = user;
+    uint64_t t0 = sixaxis_clock_ns();
+    int n = inner->enumerate(vid, rec_enum_cb, &e);
+    uint64_t t1 = sixaxis_clock_ns();
+    last_err = inner->last_error();
+    lock_state();
+    if (e.list.failed) out_failed = 1;
+    rec_write(CAPTURE_ENUMERATE, status_of(n >= 0, last_err), 0, 0, vid, last_err, t0, t1,
+              e.list.p, e.list.failed ? 0 : e.list.n);
+    unlock_state();
+    free(e.list.p);
+    return n;
+}
+
+static int rec_lookup(const char *path, hid_device_info *info) {
+    lock_state();
+    uint16_t stream = rec_stream(path);
+    unlock_state();
+    uint64_t t0 = sixaxis_clock_ns();
+    int ok = inner->lookup(path, info);
+    uint64_t t1 = sixaxis_clock_ns();
+    last_err = inner->last_error();
+    buf b;
+    memset(&b, 0, sizeof(b));
+    if (ok) put_device(&b, info);
+    lock_state();
+    if (b.failed) out_failed = 1;
+    rec_write(CAPTURE_LOOKUP, status_of(ok, last_err), stream, 0, 0, last_err, t0, t1,
+              b.p, b.failed ? 0 : b.n);
+    unlock_state();
+    free(b.p);
+    return ok;
+}
+
+static hid_handle rec_open(const char *path) {
+    lock_state();
+    uint16_t stream = rec_stream(path);
+    unlock_state();
+    uint64_t t0 = sixaxis_clock_ns();
+    hid_handle h = inner->open(path);
+    uint64_t t1 = sixaxis_clock_ns();
+    last_err = inner->last_error();
+    rec_handle *rh = NULL;
+    if (h != HID_INVALID_HANDLE) {
+        rh = (rec_handle *)malloc(sizeof(*rh));
+        if (!rh) {
+            inner->close(h);
+            h = HID_INVALID_HANDLE;
+            last_err = (unsigned long)ENOMEM;
+        } else {
+            rh->h = h;
+            rh->stream = stream;
+        }
+    }
+    lock_state();
+    rec_write(CAPTURE_OPEN, status_of(rh != NULL, last_err), stream, 0, 0, last_err, t0, t1, NULL, 0);
+    unlock_state();
+    return rh ? (hid_handle)rh : HID_INVALID_HANDLE;
+}
+
+static void rec_close(hid_handle h) {
+    rec_handle *rh = (rec_handle *)h;
+    uint64_t t0 = sixaxis_clock_ns();
+    inner->close(rh->h);
+    uint64_t t1 = sixaxis_clock_ns();
+    lock_state();
+    rec_write(CAPTURE_CLOSE, STATUS_OK, rh->stream, 0, 0, 0, t0, t1, NULL, 0);
+    unlock_state();
+    free(rh);
+}
+
+static int rec_feature_length(hid_handle h, uint16_t *out_len) {
+    const rec_handle *rh = (const rec_handle *)h;
+    uint64_t t0 = sixaxis_clock_ns();
+    int ok = inner->feature_length(rh->h, out_len);
+    uint64_t t1 = sixaxis_clock_ns();
+    last_err = inner->last_error();
+    lock_state();
+    rec_write(CAPTURE_FEATLEN, status_of(ok, last_err), rh->stream, 0, ok ? *out_len : 0,
+              last_err, t0, t1, NULL, 0);
+    unlock_state();
+    return ok;
+}
+
+static int rec_report_length(hid_handle h, uint8_t report_id, uint16_t *out_len) {
+    const rec_handle *rh = (const rec_handle *)h;
+    uint64_t t0 = sixaxis_clock_ns();
+    int ok = inner->report_length(rh->h, report_id, out_len);
+    uint64_t t1 = sixaxis_clock_ns();
+    last_err = inner->last_error();
+    lock_state();
+    rec_write(CAPTURE_REPLEN, status_of(ok, last_err), rh->stream, report_id, ok ? *out_len : 0,
+              last_err, t0, t1, NULL, 0);
+    unlock_state();
+    return ok;
+}
+
+static int rec_get_feature(hid_handle h, uint8_t *data, size_t len) {
+    const rec_handle *rh = (const rec_handle *)h;
+    uint8_t id = len ? data[0] : 0;
+    uint64_t t0 = sixaxis_clock_ns();
+    int ok = inner->get_feature(rh->h, data, len);
+    uint64_t t1 = sixaxis_clock_ns();
+    last_err = inner->last_error();
+    lock_state();
+    rec_write(CAPTURE_GET, status_of(ok, last_err), rh->stream, id, (uint16_t)len, last_err,
+              t0, t1, data, ok ? len : 0);
+    unlock_state();
+    return ok;
+}
+
+static int rec_set_feature(hid_handle h, const uint8_t *data, size_t len) {
+    const rec_handle *rh = (const rec_handle *)h;
+    uint64_t t0 = sixaxis_clock_ns();
+    int ok = inner->set_feature(rh->h, data, len);
+    uint64_t t1 = sixaxis_clock_ns();
+    last_err = inner->last_error();
+    lock_state();
+    rec_write(CAPTURE_SET, status_of(ok, last_err), rh->stream, len ? data[0] : 0, (uint16_t)len,
+              last_err, t0, t1, data, len);
+    unlock_state();
+    return ok;
+}
+
+static unsigned long capture_last_error(void) {
+    return last_err;
+}
+
+static void rec_set_timeout(unsigned ms) {
+    inner->set_timeout(ms);
+}
+
+static hid_transport recording = {
+    "record",
+    0,
+    rec_enumerate,
+    rec_lookup,
+    rec_open,
+    rec_close,
+    rec_feature_length,
+    rec_report_length,
+    rec_get_feature,
+    rec_set_feature,
+    capture_last_error,
+    rec_set_timeout,
+    NULL,
+};
+
+const hid_transport *hid_capture_start(const hid_transport *tp, const char *file,
+                                       char *err, size_t errlen) {
+    uint8_t h[FILE_HEADER];
+    lock_state();
+    if (out) {
+        unlock_state();
+        snprintf(err, errlen, "a capture is already running");
+        return NULL;
+    }
+    FILE *f = fopen(file, "wb");
+    memset(h, 0, sizeof(h));
+    memcpy(h, "SXC1", 4);
+    put32(h + 4, VERSION);
+    put32(h + 8, tp->flags);
+    if (!f || fwrite(h, 1, sizeof(h), f) != sizeof(h) || fflush(f) != 0) {
+        unlock_state();
+        if (f) fclose(f);
+        snprintf(err, errlen, "cannot write '%s'", file);
+        return NULL;
+    }
+    out = f;
+    out_failed = 0;
+    inner = tp;
+    recording.name = tp->name; // messages read the same with or without a capture
+    recording.flags = tp->flags;
+    recording.wait_ms = tp->wait_ms;
+    rec_start = sixaxis_clock_ns();
+    unlock_state();
+    return &recording;
+}
+
+int hid_capture_stop(char *err, size_t errlen) {
+    lock_state();
+    int ok = !out_failed;
+    if (out && fclose(out) != 0) ok = 0;
+    out = NULL;
+    for (size_t i = 0; i < rec_npaths; i++) free(rec_paths[i]);
+    free(rec_paths);
+    rec_paths = NULL;
+    rec_npaths = rec_cap = 0;
+    unlock_state();
+    if (!ok) snprintf(err, errlen, "capture incomplete: a write failed");
+    return ok;
+}
+
+// ---------- replay ----------
+typedef struct {
+    uint8_t        type, status, report;
+    uint16_t       stream, arg;
+    uint32_t       error, dur_us;
+    uint64_t       start_us;
+    const uint8_t *p;
+    uint32_t       n;
+    uint64_t       due_ns;          // when the replayed call returns, 0 = at once
+} rec;
+
+typedef struct {
+    char           *path;           // NULL for stream 0 (enumerations)
+    size_t         *seq;            // records of this stream, in capture order
+    size_t          n, cap, next;
+    hid_device_info info;           // last device seen at path, for lookups
+    int             known;
+    uint16_t        feat_len;       // answers for caps queries asked off-sequence
+    int             feat_measured;
+    uint16_t        report_len[256];
+    int             played;         // pacing: end of the last record served,
+    uint64_t        rec_end_us;     // in capture time ...
+    uint64_t        play_end_ns;    // ... and on the replay clock
+} stream;
+
+typedef struct {
+    uint8_t    *data;
+    rec        *recs;
+    size_t      nrecs;
+    stream     *streams;            // index = stream ID
+    size_t      nstreams;
+    const rec  *last_enum;
+    double      speed;
+    unsigned long replayed, divergences;
+} replay;
+
+static replay rp;
+// Replay calls in progress. They hold pointers into rp (records, payloads,
+// streams) outside the lock, so a reload waits for this to reach 0.
+static unsigned long rp_calls;
+
+static void call_begin(void) {
+    lock_state();
+    rp_calls++;
+    unlock_state();
+}
+
+static void call_end(void) {
+    lock_state();
+    if (--rp_calls == 0) wake_drained();
+    unlock_state();
+}
+
+static void replay_free(replay *r) {
+    for (size_t i = 0; i < r->nstreams; i++) {
+        free(r->streams[i].path);
+        free(r->streams[i].seq);
+    }
+    free(r->streams);
+    free(r->recs);
+    free(r->data);
+    memset(r, 0, sizeof(*r));
+}
+
+static uint8_t *read_file(const char *file, size_t *size) {
+    FILE *f = fopen(file, "rb");
+    if (!f) return NULL;
+    uint8_t *data = NULL;
+    long n;
+    if (fseek(f, 0, SEEK_END) == 0 && (n = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0
+        && (data = (uint8_t *)malloc((size_t)n + 1)) != NULL) {
+        *size = fread(data, 1, (size_t)n, f);
+    }
+    fclose(f);
+    return data;
+}
+
+static int grow_streams(replay *r, size_t n) {
+    if (n <= r->nstreams) return 1;
+    stream *s = (stream *)realloc(r->streams, n * sizeof(*s));
+    if (!s) return 0;
+    memset(s + r->nstreams, 0, (n - r->nstreams) * sizeof(*s));
+    r->streams = s;
+    r->nstreams = n;
+    return 1;
+}
+
+static int stream_add(stream *s, size_t rec_index) {
+    if (s->n == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 16;
+        size_t *seq = (size_t *)realloc(s->seq, cap * sizeof(*seq));
+        if (!seq) return 0;
+        s->seq = seq;
+        s->cap = cap;
+    }
+    s->seq[s->n++] = rec_index;
+    return 1;
+}
+
+static stream *stream_by_path(replay *r, const char *path) {
+    for (size_t i = 1; i < r->nstreams; i++)
+        if (r->streams[i].path && strcmp(r->streams[i].path, path) == 0) return &r->streams[i];
+    return NULL;
+}
+
+static void note_device(replay *r, const hid_device_info *d) {
+    stream *s = stream_by_path(r, d->path);
+    if (!s) return;
+    s->info = *d;
+    s->known = 1;
+}
+
+// What caps queries asked at other points get: the first recorded answer,
+// else the longest transfer of the device (the largest feature report).
+static void note_lengths(stream *s, const rec *x) {
+    if (x->status != STATUS_OK) return;
+    if (x->type == CAPTURE_FEATLEN && !s->feat_measured) {
+        s->feat_len = x->arg;
+        s->feat_measured = 1;
+    }
+    if (x->type == CAPTURE_REPLEN && !s->report_len[x->report]) s->report_len[x->report] = x->arg;
+}
+
+static void guess_lengths(stream *s, const rec *x) {
+    if (x->type != CAPTURE_GET && x->type != CAPTURE_SET) return;
+    if (!s->report_len[x->report]) s->report_len[x->report] = x->arg;
+    if (x->arg > s->feat_len && !s->feat_measured) s->feat_len = x->arg;
+}
+
+// A truncated tail (the recording run died) ends the capture early.
+static int load(replay *r, const char *file, char *err, size_t errlen) {
+    size_t size = 0;
+    r->data = read_file(file, &size);
+    if (!r->data) {
+        snprintf(err, errlen, "cannot read '%s'", file);
+        return 0;
+    }
+    if (size < FILE_HEADER || memcmp(r->data, "SXC1", 4) != 0 || get32(r->data + 4) != VERSION) {
+        snprintf(err, errlen, "'%s' is not a HID capture", file);
+        return 0;
+    }
+    size_t cap = 0;
+    if (!grow_streams(r, 1)) goto oom;
+    for (size_t off = FILE_HEADER; size - off >= HEAD_SIZE; ) {
+        const uint8_t *h = r->data + off;
+        uint32_t n = get32(h + 24);
+        if (size - off - HEAD_SIZE < n) break;
+        rec x;
+        x.type = h[0];
+        x.status = h[1];
+        x.stream = get16(h + 2);
+        x.report = h[4];
+        x.arg = get16(h + 6);
+        x.error = get32(h + 8);
+        x.dur_us = get32(h + 12);
+        x.start_us = get64(h + 16);
+        x.due_ns = 0;
+        x.p = h + HEAD_SIZE;
+        x.n = n;
+        off += HEAD_SIZE + n;
+        if (x.type == CAPTURE_STREAM) {
+            if (x.stream == 0 || !grow_streams(r, (size_t)x.stream + 1)) goto oom;
+            stream *s = &r->streams[x.stream];
+            free(s->path);
+            if (!(s->path = (char *)malloc(n + 1))) goto oom;
+            memcpy(s->path, x.p, n);
+            s->path[n] = 0;
+            continue;
+        }
+        if (x.stream >= r->nstreams || (x.stream == 0) != (x.type == CAPTURE_ENUMERATE)) break;
+        if (r->nrecs == cap) {
+            cap = cap ? cap * 2 : 256;
+            rec *recs = (rec *)realloc(r->recs, cap * sizeof(*recs));
+            if (!recs) goto oom;
+            r->recs = recs;
+        }
+        r->recs[r->nrecs] = x;
+        if (!stream_add(&r->streams[x.stream], r->nrecs)) goto oom;
+        r->nrecs++;
+    }
+    r->speed = 1.0;
+    r->replayed = r->divergences = 0;
+    for (size_t i = 0; i < r->nrecs; i++) {
+        const rec *x = &r->recs[i];
+        if (x->status != STATUS_OK || (x->type != CAPTURE_ENUMERATE && x->type != CAPTURE_LOOKUP)) continue;
+        const uint8_t *p = x->p, *end = x->p + x->n;
+        hid_device_info d;
+        while (p < end && get_device(&p, end, &d)) note_device(r, &d);
+    }
+    for (size_t i = 0; i < r->nrecs; i++) note_lengths(&r->streams[r->recs[i].stream], &r->recs[i]);
+    for (size_t i = 0; i < r->nrecs; i++) guess_lengths(&r->streams[r->recs[i].stream], &r->recs[i]);
+    return 1;
+oom:
+    snprintf(err, errlen, "out of memory loading '%s'", file);
+    return 0;
+}
+
+static int is_query(uint8_t type) {
+    return type == CAPTURE_LOOKUP || type == CAPTURE_FEATLEN || type == CAPTURE_REPLEN;
+}
+
+// When a call served now from x returns: the recorded gap since the device's
+// previous call, then the recorded duration, both divided by the speed. Time
+// the replaying run spent on its own since that call counts toward the gap.
+static uint64_t schedule(stream *s, const rec *x) {
+    if (rp.speed <= 0) return 0;
+    uint64_t begin = sixaxis_clock_ns();
+    if (s->played && x->start_us > s->rec_end_us) {
+        uint64_t gap = (uint64_t)((double)(x->start_us - s->rec_end_us) * 1000.0 / rp.speed);
+        if (s->play_end_ns + gap > begin) begin = s->play_end_ns + gap;
+    }
+    s->played = 1;
+    s->rec_end_us = x->start_us + x->dur_us;
+    s->play_end_ns = begin + (uint64_t)((double)x->dur_us * 1000.0 / rp.speed);
+    return s->play_end_ns;
+}
+
+// Consumes the next record of s with this type (and report ID, when >= 0),
+// passing over queries the replaying run did not ask. NULL when the next
+// open, close or transfer is something else. Caller holds the lock.
+static const rec *take(stream *s, uint8_t type, int report) {
+    for (size_t i = s->next; i < s->n; i++) {
+        rec *x = &rp.recs[s->seq[i]];
+        if (x->type == type && (report < 0 || x->report == report)) {
+            s->next = i + 1;
+            rp.replayed++;
+            x->due_ns = schedule(s, x);
+            return x;
+        }
+        if (!is_query(x->type)) break;
+    }
+    return NULL;
+}
+
+static stream *stream_of(hid_handle h) {
+    return h > 0 && (size_t)h < rp.nstreams ? &rp.streams[h] : NULL;
+}
+
+static void wait_for(const rec *x) {
+    uint64_t now = sixaxis_clock_ns();
+    if (x->due_ns > now) sleep_us((unsigned)((x->due_ns - now) / 1000));
+}
+
+// Waits out a recorded call and replays its outcome.
+static int outcome(const rec *x) {
+    wait_for(x);
+    if (x->status == STATUS_OK) return 1;
+    last_err = x->status == STATUS_TIMEOUT ? HID_ERR_TIMEOUT : x->error ? x->error : ERR_DIVERGED;
+    return 0;
+}
+
+static int diverged(void) {
+    rp.divergences++;
+    unlock_state();
+    last_err = ERR_DIVERGED;
+    return 0;
+}
+
+// Enumerations come back in capture order; past the last one it is repeated,
+// and a capture without any lists every device it saw.
+static int play_enumerate(uint16_t vid, hid_enum_cb cb, void *user) {
+    lock_state();
+    const rec *x = take(&rp.streams[0], CAPTURE_ENUMERATE, -1);
+    int fresh = x != NULL;
+    if (fresh) rp.last_enum = x;
+    else x = rp.last_enum;
+    unlock_state();
+    int found = 0;
+    if (!x) {
+        // Unlocked: stream info is fixed once loaded, and a reload waits for
+        // this call to end.
+        for (size_t i = 1; i < rp.nstreams; i++) {
+            const stream *s = &rp.streams[i];
+            if (!s->known || (vid && s->info.vid != vid)) continue;
+            found++;
+            if (cb(&s->info, user)) break;
+        }
+        return found;
+    }
+    if (fresh ? !outcome(x) : x->status != STATUS_OK) return -1;
+    const uint8_t *p = x->p, *end = x->p + x->n;
+    hid_device_info d;
+    while (p < end && get_device(&p, end, &d)) {
+        if (vid && d.vid != vid) continue;
+        found++;
+        if (cb(&d, user)) break;
+    }
+    return found;
+}
+
+static int play_lookup(const char *path, hid_device_info *info) {
+    lock_state();
+    stream *s = stream_by_path(&rp, path);
+    const rec *x = s ? take(s, CAPTURE_LOOKUP, -1) : NULL;
+    unlock_state();
+    if (x) {
+        const uint8_t *p = x->p;
+        if (!outcome(x)) return 0;
+        if (get_device(&p, x->p + x->n, info)) return 1;
+    } else if (s && s->known) {
+        *info = s->info;
+        return 1;
+    }
+    last_err = ERR_GONE;
+    return 0;
+}
+
+static hid_handle play_open(const char *path) {
+    lock_state();
+    stream *s = stream_by_path(&rp, path);
+    const rec *x = s ? take(s, CAPTURE_OPEN, -1) : NULL;
+    if (!x) {
+        diverged();
+        return HID_INVALID_HANDLE;
+    }
+    unlock_state();
+    return outcome(x) ? (hid_handle)(s - rp.streams) : HID_INVALID_HANDLE;
+}
+
+static void play_close(hid_handle h) {
+    lock_state();
+    stream *s = stream_of(h);
+    const rec *x = s ? take(s, CAPTURE_CLOSE, -1) : NULL;
+    unlock_state();
+    if (x) wait_for(x);
+}
+
+static int play_feature_length(hid_handle h, uint16_t *out_len) {
+    lock_state();
+    stream *s = stream_of(h);
+    const rec *x = s ? take(s, CAPTURE_FEATLEN, -1) : NULL;
+    unlock_state();
+    if (x) {
+        if (!outcome(x)) return 0;
+        *out_len = x->arg;
+        return 1;
+    }
+    if (!s || !s->feat_len) {
+        last_err = ERR_DIVERGED;
+        return 0;
+    }
+    *out_len = s->feat_len;
+    return 1;
+}
+
+static int play_report_length(hid_handle h, uint8_t report_id, uint16_t *out_len) {
+    lock_state();
+    stream *s = stream_of(h);
+    const rec *x = s ? take(s, CAPTURE_REPLEN, report_id) : NULL;
+    unlock_state();
+    if (x) {
+        if (!outcome(x)) return 0;
+        *out_len = x->arg;
+        return 1;
+    }
+    if (!s || !s->report_len[report_id]) {
+        last_err = ERR_DIVERGED;
+        return 0;
+    }
+    *out_len = s->report_len[report_id];
+    return 1;
+}
+
+static int play_get_feature(hid_handle h, uint8_t *data, size_t len) {
+    if (!len) return 0;
+    lock_state();
+    stream *s = stream_of(h);
+    const rec *x = s ? take(s, CAPTURE_GET, data[0]) : NULL;
+    if (!x) return diverged();
+    unlock_state();
+    if (!outcome(x)) return 0;
+    size_t n = x->n < len ? x->n : len;
+    memcpy(data, x->p, n);
+    memset(data + n, 0, len - n);
+    return 1;
+}
+
+static int play_set_feature(hid_handle h, const uint8_t *data, size_t len) {
+    if (!len) return 0;
+    lock_state();
+    stream *s = stream_of(h);
+    const rec *x = s ? take(s, CAPTURE_SET, data[0]) : NULL;
+    if (!x) return diverged();
+    unlock_state();
+    return outcome(x);
+}
+
+// Transport entry points: each call is counted in flight for its duration.
+static int rp_enumerate(uint16_t vid, hid_enum_cb cb, void *user) {
+    call_begin();
+    int n = play_enumerate(vid, cb, user);
+    call_end();
+    return n;
+}
+
+static int rp_lookup(const char *path, hid_device_info *info) {
+    call_begin();
+    int ok = play_lookup(path, info);
+    call_end();
+    return ok;
+}
+
+static hid_handle rp_open(const char *path) {
+    call_begin();
+    hid_handle h = play_open(path);
+    call_end();
+    return h;
+}
+
+static void rp_close(hid_handle h) {
+    call_begin();
+    play_close(h);
+    call_end();
+}
+
+static int rp_feature_length(hid_handle h, uint16_t *out_len) {
+    call_begin();
+    int ok = play_feature_length(h, out_len);
+    call_end();
+    return ok;
+}
+
+static int rp_report_length(hid_handle h, uint8_t report_id, uint16_t *out_len) {
+    call_begin();
+    int ok = play_report_length(h, report_id, out_len);
+    call_end();
+    return ok;
+}
+
+static int rp_get_feature(hid_handle h, uint8_t *data, size_t len) {
+    call_begin();
+    int ok = play_get_feature(h, data, len);
+    call_end();
+    return ok;
+}
+
+static int rp_set_feature(hid_handle h, const uint8_t *data, size_t len) {
+    call_begin();
+    int ok = play_set_feature(h, data, len);
+    call_end();
+    return ok;
+}
+
+// The verify backoff, on the replay's clock.
+static void rp_wait_ms(unsigned ms) {
+    lock_state();
+    double speed = rp.speed;
+    unlock_state();
+    if (speed > 0 && ms) sleep_us((unsigned)(ms * 1000.0 / speed));
+}
+
+// Recorded outcomes already carry the deadlines of the recording run.
+static void rp_set_timeout(unsigned ms) {
+    (void)ms;
+}
+
+static hid_transport replaying = {
+    "replay",
+    0,
+    rp_enumerate,
+    rp_lookup,
+    rp_open,
+    rp_close,
+    rp_feature_length,
+    rp_report_length,
+    rp_get_feature,
+    rp_set_feature,
+    capture_last_error,
+    rp_set_timeout,
+    rp_wait_ms,
+};
+
+const hid_transport *hid_replay_open(const char *file, double speed, char *err, size_t errlen) {
+    replay r;
+    memset(&r, 0, sizeof(r));
+    if (!load(&r, file, err, errlen)) {
+        replay_free(&r);
+        return NULL;
+    }
+    r.speed = speed > 0 ? speed : 0;
+    lock_state();
+    while (rp_calls) wait_drained();
+    replay_free(&rp);
+    rp = r;
+    replaying.flags = get32(rp.data + 8);
+    unlock_state();
+    return &replaying;
+}
+
+void hid_replay_get_stats(hid_replay_stats *out) {
+    lock_state();
+    out->records = (unsigned long)rp.nrecs;
+    out->replayed = rp.replayed;
+    out->divergences = rp.divergences;
+    unlock_state();
+}
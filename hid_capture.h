@@ -0,0 +1,77 @@
+// hid_capture.h — record HID traffic to a file and replay it as a transport.
+//
+// hid_capture_start wraps any transport: every call is forwarded unchanged,
+// and enumerations, lookups, opens, caps queries and each GetFeature/SetFeature
+// (report ID, bytes, outcome, duration) are appended to a capture file.
+// hid_replay_open turns such a file back into a transport, so a run taken on
+// a station with a misbehaving controller can be replayed through the same
+// pairing code on a machine without hardware, at the recorded pace or faster.
+//
+// Replay follows the capture per interface path, not by wall-clock order, so
+// a batch replayed with other worker counts or hub caps still meets each
+// device's own sequence. Enumerations, lookups and length queries are answered
+// from what the capture saw even where the replaying run asks them at other
+// points (a device cache hit on one side, a miss on the other). Transfers are
+// strict: one that does not match the next recorded transfer of its device
+// fails and is counted as a divergence. Replay the recorded MAC and options
+// to reproduce a run; a capture only knows the answers the devices gave then.
+//
+// File layout, all integers little-endian:
+//   header 16 bytes: "SXC1", u32 version (1), u32 hid_transport.flags, u32 0
+//   records: 28-byte head, then n payload bytes:
+//     0  u8 type (CAPTURE_*)         8  u32 OS error of a failed call
+//     1  u8 status: 0 failed,       12  u32 duration (us)
+//        1 ok, 2 timed out          16  u64 start (us since the capture began)
+//     2  u16 stream                 24  u32 n
+//     4  u8 report ID, 5 u8 0
+//     6  u16 length asked (get/set) or returned (caps), or VID (enumerate)
+//   Stream 0 holds enumerations; a STREAM record names the path of every
+//   other stream before its first use. Payloads: STREAM the path; ENUMERATE
+//   and LOOKUP the devices reported; GET the bytes read; SET the bytes
+//   written. A device is u16 vid, u16 pid, then path, product, serial and
+//   port, each a u16 length and the bytes.
+// Records are flushed as they are written, so a run that hangs or crashes
+// leaves a capture that is whole up to that point.
+
+#ifndef HID_CAPTURE_H
+#define HID_CAPTURE_H
+
+#include <stddef.h>
+
+#include "hid_transport.h"
+
+#define CAPTURE_STREAM    0
+#define CAPTURE_ENUMERATE 1
+#define CAPTURE_LOOKUP    2
+#define CAPTURE_OPEN      3
+#define CAPTURE_CLOSE     4
+#define CAPTURE_FEATLEN   5
+#define CAPTURE_REPLEN    6
+#define CAPTURE_GET       7
+#define CAPTURE_SET       8
+
+// Starts recording inner into file (truncated) and returns the recording
+// transport, or NULL with a reason in err. One capture per process.
+const hid_transport *hid_capture_start(const hid_transport *inner, const char *file,
+                                       char *err, size_t errlen);
+// Closes the capture. Returns 0 with a reason in err if a write failed.
+int hid_capture_stop(char *err, size_t errlen);
+
+// Loads a capture and returns the replaying transport, or NULL with a reason
+// in err. speed scales the recorded time: each call returns after its
+// recorded duration, no sooner than the recorded gap after the device's
+// previous call, and waits the pairing code makes through wait_ms (the verify
+// backoff) shrink alike. 1 = as recorded, 10 = ten times faster, 0 = no
+// waiting at all. One replay per process; loading another replaces it once no
+// call is in flight.
+const hid_transport *hid_replay_open(const char *file, double speed, char *err, size_t errlen);
+
+typedef struct {
+    unsigned long records;      // in the capture
+    unsigned long replayed;     // recorded calls served
+    unsigned long divergences;  // transfers that did not match the capture
+} hid_replay_stats;
+
+void hid_replay_get_stats(hid_replay_stats *out);
+
+#endif // HID_CAPTURE_H
@@ -0,0 +1,74 @@
+// hid_probe.c — see hid_probe.h.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hid_probe.h"
+#include "workpool.h"
+
+static volatile unsigned probe_jobs = HID_PROBE_JOBS;
+
+void hid_probe_set_jobs(unsigned jobs) {
+    probe_jobs = jobs ? jobs : HID_PROBE_JOBS;
+}
+
+unsigned hid_probe_jobs(void) {
+    return probe_jobs;
+}
+
+int hid_probe_add(hid_probe_list *l, const char *path) {
+    if (l->n == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 16;
+        hid_device_info *items = (hid_device_info *)realloc(l->items, cap * sizeof(*items));
+        if (!items) return 0;
+        l->items = items;
+        uint8_t *ok = (uint8_t *)realloc(l->ok, cap);
+        if (!ok) return 0;
+        l->ok = ok;
+        l->cap = cap;
+    }
+    hid_device_info *it = &l->items[l->n++];
+    memset(it, 0, sizeof(*it));
+    strncpy(it->path, path, sizeof(it->path) - 1);
+    return 1;
+}
+
+typedef struct {
+    hid_probe_list *l;
+    uint16_t        vid;
+    hid_probe_fn    probe;
+} probe_ctx;
+
+static int probe_at(const probe_ctx *c, size_t i) {
+    char path[HID_PATH_MAX]; // the probe rewrites the whole item, path included
+    memcpy(path, c->l->items[i].path, sizeof(path));
+    return c->l->ok[i] = (uint8_t)(c->probe(path, c->vid, &c->l->items[i]) != 0);
+}
+
+static void probe_one(size_t i, void *user) {
+    probe_at((const probe_ctx *)user, i);
+}
+
+int hid_probe_run(hid_probe_list *l, uint16_t vid, hid_probe_fn probe, hid_enum_cb cb, void *user) {
+    probe_ctx c = { l, vid, probe };
+    unsigned jobs = hid_probe_jobs();
+    int found = 0;
+    if (jobs > 1 && l->n > 1) {
+        workpool_run(l->n, jobs, probe_one, &c);
+        for (size_t i = 0; i < l->n; i++) {
+            if (!l->ok[i]) continue;
+            found++;
+            if (cb(&l->items[i], user)) break;
+        }
+    } else {
+        for (size_t i = 0; i < l->n; i++) {
+            if (!probe_at(&c, i)) continue;
+            found++;
+            if (cb(&l->items[i], user)) break;
+        }
+    }
+    free(l->items);
+    free(l->ok);
+    memset(l, 0, sizeof(*l));
+    return found;
+}
@@ -0,0 +1,43 @@
+// hid_probe.h — two-pass enumeration for HID backends.
+//
+// Listing interfaces is cheap (SetupDiGetDeviceInterfaceDetail, a path
+// string); learning what one is costs an open and a few round trips to the
+// device (HidD_GetAttributes, product and serial strings). A backend's
+// enumerate therefore collects candidate paths first, then hid_probe_run
+// probes them on a worker pool and reports the hits in listing order, so
+// callers that prefer the first DS4, then DS3, other Sony and dongles pick
+// exactly what a sequential walk would have picked.
+
+#ifndef HID_PROBE_H
+#define HID_PROBE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hid_transport.h"
+
+#define HID_PROBE_JOBS 8   // default probe threads; 1 probes one after another
+
+// Fills *out for path (vid 0 = any); 0 if it is gone or another vendor.
+// Called concurrently from several threads.
+typedef int (*hid_probe_fn)(const char *path, uint16_t vid, hid_device_info *out);
+
+typedef struct {
+    hid_device_info *items;  // path from the listing pass, the rest from the probe
+    uint8_t         *ok;
+    size_t           n, cap;
+} hid_probe_list;
+
+// Listing pass: queues one candidate. Returns 0 when out of memory.
+int  hid_probe_add(hid_probe_list *l, const char *path);
+// Probe pass: probes every queued path on up to hid_probe_jobs() threads,
+// calls cb for each hit in listing order until it returns nonzero, and frees
+// the list. Probing one by one stops at that point too. Returns the number
+// of hits reported.
+int  hid_probe_run(hid_probe_list *l, uint16_t vid, hid_probe_fn probe, hid_enum_cb cb, void *user);
+
+// Probe threads for every later enumeration, 0 = HID_PROBE_JOBS.
+void     hid_probe_set_jobs(unsigned jobs);
+unsigned hid_probe_jobs(void);
+
+#endif // HID_PROBE_H
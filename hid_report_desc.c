@@ -0,0 +1,51 @@
+// hid_report_desc.c — see hid_report_desc.h.
+
+#include <string.h>
+
+#include "hid_report_desc.h"
+
+#define PUSH_DEPTH 8
+
+typedef struct {
+    uint32_t size;    // Report Size (bits per field)
+    uint32_t count;   // Report Count
+    uint8_t  id;      // Report ID
+} globals;
+
+uint16_t hid_desc_feature_lengths(const uint8_t *desc, size_t size, uint16_t lens[256]) {
+    uint32_t bits[256];
+    globals  g = {0, 0, 0}, stack[PUSH_DEPTH];
+    int      sp = 0;
+
+    memset(bits, 0, sizeof(bits));
+    for (size_t i = 0; i < size; ) {
+        uint8_t b = desc[i];
+        if (b == 0xFE) { // long item: bDataSize, bLongItemTag, data
+            if (i + 1 >= size) break;
+            i += 3u + desc[i + 1];
+            continue;
+        }
+        size_t n = (b & 3) == 3 ? 4 : (b & 3);
+        uint32_t v = 0;
+        if (i + 1 + n > size) break;
+        for (size_t k = 0; k < n; k++) v |= (uint32_t)desc[i + 1 + k] << (8 * k);
+
+        switch (b & 0xFC) {
+            case 0x74: g.size  = v; break;            // Report Size
+            case 0x94: g.count = v; break;            // Report Count
+            case 0x84: g.id    = (uint8_t)v; break;   // Report ID
+            case 0xA4: if (sp < PUSH_DEPTH) stack[sp++] = g; break; // Push
+            case 0xB4: if (sp > 0) g = stack[--sp]; break;          // Pop
+            case 0xB0: bits[g.id] += g.size * g.count; break;       // Feature
+            default: break;
+        }
+        i += 1 + n;
+    }
+
+    uint16_t max_len = 0;
+    for (int id = 0; id < 256; id++) {
+        lens[id] = bits[id] ? (uint16_t)(1 + (bits[id] + 7) / 8) : 0;
+        if (lens[id] > max_len) max_len = lens[id];
+    }
+    return max_len;
+}
@@ -0,0 +1,15 @@
+// hid_report_desc.h — minimal HID report descriptor walker.
+
+#ifndef HID_REPORT_DESC_H
+#define HID_REPORT_DESC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fills lens[id] with the byte length of Feature report `id` as transferred
+// through hidraw / hid.dll, i.e. the report ID byte plus the payload; IDs the
+// descriptor does not declare are left 0. Returns the largest length, or 0 if
+// there is no Feature report at all.
+uint16_t hid_desc_feature_lengths(const uint8_t *desc, size_t size, uint16_t lens[256]);
+
+#endif // HID_REPORT_DESC_H
@@ -0,0 +1,95 @@
+// hid_transport.h — pluggable HID transport used by the pairing tools.
+//
+// A backend enumerates HID interfaces, opens one by path and moves feature
+// reports in and out of it. Windows uses SetupAPI + hid.dll
+// (hid_transport_win.c), Linux uses /dev/hidraw* with HIDIOC[GS]FEATURE
+// (hid_transport_hidraw.c).
+
+#ifndef HID_TRANSPORT_H
+#define HID_TRANSPORT_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SONY_VID      0x054C
+#define HID_PATH_MAX  512
+#define HID_STR_MAX   128
+#define HID_PORT_MAX  64
+
+// Opaque per-backend handle (HANDLE on Windows, fd on Linux).
+typedef intptr_t hid_handle;
+#define HID_INVALID_HANDLE ((hid_handle)-1)
+
+// last_error() after an open/get/set ran past the set_timeout deadline.
+#ifdef _WIN32
+#  define HID_ERR_TIMEOUT 1460ul // ERROR_TIMEOUT
+#else
+#  define HID_ERR_TIMEOUT ((unsigned long)ETIMEDOUT)
+#endif
+// last_error() after a get/set the device or its hub refused as busy.
+#ifdef _WIN32
+#  define HID_ERR_BUSY 170ul // ERROR_BUSY
+#else
+#  define HID_ERR_BUSY ((unsigned long)EBUSY)
+#endif
+
+typedef struct {
+    char     path[HID_PATH_MAX];    // UTF-8; \\?\hid#... or /dev/hidrawN
+    uint16_t vid;
+    uint16_t pid;
+    char     product[HID_STR_MAX];  // UTF-8, may be empty
+    char     serial[HID_STR_MAX];   // USB serial number (HID_UNIQ on Linux), may be empty
+    char     port[HID_PORT_MAX];    // USB port: "1-1.2" (sysfs) or "Port_#0002.Hub_#0001"
+                                    // (Windows location), may be empty
+} hid_device_info;
+
+// Called once per matching interface; return nonzero to stop enumerating.
+typedef int (*hid_enum_cb)(const hid_device_info *info, void *user);
+
+// hid_transport.flags
+#define HID_TF_FULL_LENGTH 0x1  // get/set_feature want the largest feature length (hid.dll)
+
+typedef struct hid_transport {
+    const char *name;
+    unsigned    flags;
+    // Reports every present interface with the given vendor ID (0 = any).
+    // Backends filter on VID before opening anything where the OS allows it.
+    // Returns the number of interfaces reported, or -1 if the list is unavailable.
+    int        (*enumerate)(uint16_t vid, hid_enum_cb cb, void *user);
+    // Fills *out for one interface path (e.g. from a hotplug event) without
+    // listing the others. Returns 0 if the path is gone or not a HID interface.
+    int        (*lookup)(const char *path, hid_device_info *out);
+    hid_handle (*open)(const char *path);
+    void       (*close)(hid_handle h);
+    // Largest feature report of the device in bytes, report ID byte included.
+    int        (*feature_length)(hid_handle h, uint16_t *out_len);
+    // Length of one feature report, report ID byte included. Returns 0 if the
+    // device does not declare that ID (or the backend cannot tell).
+    int        (*report_length)(hid_handle h, uint8_t report_id, uint16_t *out_len);
+    // buf[0] carries the report ID. Both return 1 on success, 0 on failure.
+    int        (*get_feature)(hid_handle h, uint8_t *buf, size_t len);
+    int        (*set_feature)(hid_handle h, const uint8_t *buf, size_t len);
+    // OS error of the last failed call on this thread (GetLastError / errno).
+    unsigned long (*last_error)(void);
+    // Deadline for every later open/get/set, in milliseconds; 0 waits forever.
+    // A call that runs out fails with HID_ERR_TIMEOUT.
+    void       (*set_timeout)(unsigned ms);
+    // Pause between retries (the verify backoff); NULL sleeps for real. A
+    // replay scales it with the recorded calls.
+    void       (*wait_ms)(unsigned ms);
+} hid_transport;
+
+#if defined(_WIN32)
+extern const hid_transport hid_transport_win;
+#  define HID_TRANSPORT_DEFAULT (&hid_transport_win)
+#elif defined(__linux__)
+extern const hid_transport hid_transport_hidraw;
+#  define HID_TRANSPORT_DEFAULT (&hid_transport_hidraw)
+// Redirect /sys/class/hidraw and /dev (NULL restores the default), for fake trees.
+void hidraw_set_roots(const char *sysfs_dir, const char *dev_dir);
+// Number of device opens issued by the backend so far.
+unsigned long hidraw_open_count(void);
+#endif
+
+#endif // HID_TRANSPORT_H
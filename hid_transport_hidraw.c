@@ -0,0 +1,402 @@
+// hid_transport_hidraw.c — Linux /dev/hidraw* backend for hid_transport.h.
+
+#include <dirent.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/hidraw.h>
+
+#include "hid_report_desc.h"
+#include "hid_transport.h"
+
+static _Thread_local int last_err;
+static _Atomic unsigned long open_calls;
+static _Atomic unsigned timeout_ms; // per get/set, 0 = wait forever
+
+static const char *sysfs_root = "/sys/class/hidraw";
+static const char *dev_root   = "/dev";
+
+void hidraw_set_roots(const char *sysfs_dir, const char *dev_dir) {
+    sysfs_root = sysfs_dir ? sysfs_dir : "/sys/class/hidraw";
+    dev_root   = dev_dir   ? dev_dir   : "/dev";
+}
+
+unsigned long hidraw_open_count(void) {
+    return open_calls;
+}
+
+static int open_path(const char *path) {
+    open_calls++;
+    // O_NONBLOCK: open never waits on the device, only the feature ioctls do.
+    int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) fd = open(path, O_WRONLY | O_NONBLOCK | O_CLOEXEC); // mirror the Windows write-only retry
+    if (fd < 0) last_err = errno;
+    return fd;
+}
+
+// Reads VID/PID, name and serial from <sysfs>/hidrawN/device/uevent, e.g.
+//   HID_ID=0003:0000054C:000005C4
+//   HID_NAME=Sony Computer Entertainment Wireless Controller
+//   HID_UNIQ=1c:a0:b8:12:34:56
+static int read_uevent(const char *node, hid_device_info *info) {
+    char path[HID_PATH_MAX], text[1024];
+    snprintf(path, sizeof(path), "%s/%s/device/uevent", sysfs_root, node);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    ssize_t n = read(fd, text, sizeof(text) - 1);
+    close(fd);
+    if (n <= 0) return 0;
+    text[n] = 0;
+
+    int have_id = 0;
+    for (char *line = text, *next; line && *line; line = next) {
+        next = strchr(line, '\n');
+        if (next) *next++ = 0;
+
+        unsigned bus, vid, pid;
+        if (sscanf(line, "HID_ID=%x:%x:%x", &bus, &vid, &pid) == 3) {
+            info->vid = (uint16_t)vid;
+            info->pid = (uint16_t)pid;
+            have_id = 1;
+        } else if (strncmp(line, "HID_NAME=", 9) == 0) {
+            snprintf(info->product, sizeof(info->product), "%s", line + 9);
+        } else if (strncmp(line, "HID_UNIQ=", 9) == 0) {
+            snprintf(info->serial, sizeof(info->serial), "%s", line + 9);
+        }
+    }
+    return have_id;
+}
+
+// The USB port is the last all-numeric "bus-port[.port...]" component of the
+// resolved device link, e.g. .../usb1/1-1/1-1.2/1-1.2:1.3/0003:054C:05C4.0007
+// gives "1-1.2". Bluetooth and virtual devices have none.
+static void read_port(const char *node, hid_device_info *info) {
+    char path[HID_PATH_MAX], real[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s/device", sysfs_root, node);
+    if (!realpath(path, real)) return;
+    char *save = NULL;
+    for (char *c = strtok_r(real, "/", &save); c; c = strtok_r(NULL, "/", &save)) {
+        size_t n = strlen(c);
+        if (strchr(c, '-') && strspn(c, "0123456789-.") == n && n < sizeof(info->port))
+            memcpy(info->port, c, n + 1);
+    }
+}
+
+// Filters on the sysfs uevent, so interfaces of other vendors are never opened.
+static int hidraw_enumerate(uint16_t vid, hid_enum_cb cb, void *user) {
+    DIR *d = opendir(sysfs_root);
+    if (!d) { last_err = errno; return -1; }
+
+    struct dirent *e;
+    int found = 0, stop = 0;
+    while (!stop && (e = readdir(d)) != NULL) {
+        if (strncmp(e->d_name, "hidraw", 6) != 0) continue;
+
+        hid_device_info info;
+        memset(&info, 0, sizeof(info));
+        if (!read_uevent(e->d_name, &info)) continue;
+        if (vid != 0 && info.vid != vid) continue;
+
+        read_port(e->d_name, &info);
+        snprintf(info.path, sizeof(info.path), "%s/%s", dev_root, e->d_name);
+        found++;
+        stop = cb(&info, user);
+    }
+    closedir(d);
+    return found;
+}
+
+static int hidraw_lookup(const char *path, hid_device_info *out) {
+    const char *node = strrchr(path, '/');
+    node = node ? node + 1 : path;
+    memset(out, 0, sizeof(*out));
+    if (strncmp(node, "hidraw", 6) != 0 || !read_uevent(node, out)) { last_err = ENOENT; return 0; }
+    read_port(node, out);
+    snprintf(out->path, sizeof(out->path), "%s/%s", dev_root, node);
+    return 1;
+}
+
+// ---------- report lengths ----------
+// hidraw has no HidP_GetCaps; feature reports are sized from the report
+// descriptor. Both length queries of a handle are answered from one fetch:
+// the parsed lengths are kept in a slot picked by fd until the handle is
+// closed. A slot taken over by another fd only costs a second fetch.
+#define DESC_SLOTS 64
+
+typedef struct {
+    int      key;         // fd + 1, 0 = empty
+    uint16_t max_len;
+    uint16_t lens[256];
+} desc_slot;
+
+static desc_slot       desc_slots[DESC_SLOTS];
+static pthread_mutex_t desc_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void desc_forget(int fd) {
+    desc_slot *d = &desc_slots[(unsigned)fd % DESC_SLOTS];
+    pthread_mutex_lock(&desc_lock);
+    if (d->key == fd + 1) d->key = 0;
+    pthread_mutex_unlock(&desc_lock);
+}
+
+static hid_handle hidraw_open(const char *path) {
+    int fd = open_path(path);
+    return fd < 0 ? HID_INVALID_HANDLE : (hid_handle)fd;
+}
+
+// Forgets the lengths before the fd number can be handed out again.
+static void hidraw_close(hid_handle h) {
+    desc_forget((int)h);
+    close((int)h);
+}
+
+static int read_lengths(hid_handle h, uint16_t lens[256], uint16_t *max_len) {
+    int fd = (int)h;
+    desc_slot *d = &desc_slots[(unsigned)fd % DESC_SLOTS];
+    pthread_mutex_lock(&desc_lock);
+    int hit = d->key == fd + 1;
+    if (hit) {
+        memcpy(lens, d->lens, sizeof(d->lens));
+        *max_len = d->max_len;
+    }
+    pthread_mutex_unlock(&desc_lock);
+    if (hit) return 1;
+
+    struct hidraw_report_descriptor rd;
+    int size = 0;
+    if (ioctl(fd, HIDIOCGRDESCSIZE, &size) < 0) { last_err = errno; return 0; }
+    rd.size = (uint32_t)size;
+    if (ioctl(fd, HIDIOCGRDESC, &rd) < 0) { last_err = errno; return 0; }
+    *max_len = hid_desc_feature_lengths(rd.value, rd.size, lens);
+    if (*max_len == 0) { last_err = ENOENT; return 0; }
+
+    pthread_mutex_lock(&desc_lock);
+    d->key = fd + 1;
+    d->max_len = *max_len;
+    memcpy(d->lens, lens, sizeof(d->lens));
+    pthread_mutex_unlock(&desc_lock);
+    return 1;
+}
+
+static int hidraw_feature_length(hid_handle h, uint16_t *out_len) {
+    uint16_t lens[256], max_len;
+    if (!read_lengths(h, lens, &max_len)) return 0;
+    if (out_len) *out_len = max_len;
+    return 1;
+}
+
+static int hidraw_report_length(hid_handle h, uint8_t report_id, uint16_t *out_len) {
+    uint16_t lens[256], max_len;
+    if (!read_lengths(h, lens, &max_len)) return 0;
+    if (!lens[report_id]) { last_err = ENOENT; return 0; }
+    if (out_len) *out_len = lens[report_id];
+    return 1;
+}
+
+// ---------- deadlines ----------
+// HIDIOC[GS]FEATURE sleep in the USB control transfer: they ignore O_NONBLOCK,
+// cannot be polled and are not interruptible. With a deadline set the ioctl
+// runs on a helper thread against a dup of the fd and the helper's own copy of
+// the buffer. Past the deadline the caller gets ETIMEDOUT and abandons the
+// helper, which finishes on its own (the kernel bounds control transfers).
+//
+// Helpers are long-lived: one that finishes goes back on an idle list and the
+// next transfer hands it the job, so steady-state transfers neither create
+// threads nor allocate. A new helper is only started when none is idle, i.e.
+// on first use, past the number already running at once, or after one was
+// abandoned. At most HELPER_IDLE_MAX idle helpers are kept; extras exit.
+#define HELPER_IDLE_MAX 32
+#define HELPER_BUF      512
+
+typedef struct helper {
+    pthread_mutex_t m;
+    pthread_cond_t  work;     // caller -> helper: has_job or quit
+    pthread_cond_t  finished; // helper -> caller, waited on CLOCK_MONOTONIC
+    struct helper  *next;     // idle list
+    int             has_job, done, abandoned, quit; // under m
+    int             fd;       // dup for this job; the helper closes it
+    unsigned long   req;
+    int             rc, err;
+    uint8_t        *buf;      // small, or big for oversized reports
+    uint8_t        *big;
+    size_t          big_len;
+    uint8_t         small[HELPER_BUF];
+} helper;
+
+static pthread_mutex_t idle_m = PTHREAD_MUTEX_INITIALIZER;
+static helper         *idle_list;
+static unsigned        idle_count;
+
+static void helper_free(helper *h) {
+    pthread_cond_destroy(&h->finished);
+    pthread_cond_destroy(&h->work);
+    pthread_mutex_destroy(&h->m);
+    free(h->big);
+    free(h);
+}
+
+// Puts an idle helper back on the list; 0 when the list is full.
+static int helper_park(helper *h) {
+    pthread_mutex_lock(&idle_m);
+    int kept = idle_count < HELPER_IDLE_MAX;
+    if (kept) { h->next = idle_list; idle_list = h; idle_count++; }
+    pthread_mutex_unlock(&idle_m);
+    return kept;
+}
+
+// Called by the caller once it is done with a helper (not abandoned).
+static void helper_retire(helper *h) {
+    if (helper_park(h)) return;
+    pthread_mutex_lock(&h->m);
+    h->quit = 1;
+    pthread_cond_signal(&h->work);
+    pthread_mutex_unlock(&h->m);
+}
+
+static void *helper_thread(void *p) {
+    helper *h = (helper *)p;
+    for (;;) {
+        pthread_mutex_lock(&h->m);
+        while (!h->has_job && !h->quit) pthread_cond_wait(&h->work, &h->m);
+        if (h->quit) { pthread_mutex_unlock(&h->m); break; }
+        h->has_job = 0;
+        pthread_mutex_unlock(&h->m);
+
+        int rc = ioctl(h->fd, h->req, h->buf);
+        int err = errno;
+        close(h->fd);
+
+        pthread_mutex_lock(&h->m);
+        h->rc = rc;
+        h->err = err;
+        h->done = 1;
+        int abandoned = h->abandoned;
+        if (abandoned) h->done = h->abandoned = 0; // nobody will collect it
+        else pthread_cond_signal(&h->finished);
+        pthread_mutex_unlock(&h->m);
+        // Finished late: the caller has gone, so the helper returns itself.
+        if (abandoned && !helper_park(h)) break;
+    }
+    helper_free(h);
+    return NULL;
+}
+
+static helper *helper_start(void) {
+    helper *h = (helper *)calloc(1, sizeof(*h));
+    if (!h) { last_err = ENOMEM; return NULL; }
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_mutex_init(&h->m, NULL);
+    pthread_cond_init(&h->work, NULL);
+    pthread_cond_init(&h->finished, &ca);
+    pthread_condattr_destroy(&ca);
+
+    pthread_t t;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int started = pthread_create(&t, &attr, helper_thread, h) == 0;
+    pthread_attr_destroy(&attr);
+    if (!started) { last_err = EAGAIN; helper_free(h); return NULL; }
+    return h;
+}
+
+static helper *helper_get(void) {
+    pthread_mutex_lock(&idle_m);
+    helper *h = idle_list;
+    if (h) { idle_list = h->next; idle_count--; }
+    pthread_mutex_unlock(&idle_m);
+    return h ? h : helper_start();
+}
+
+// out is NULL for a set (in is not written back), in == out for a get.
+static int feature_ioctl(int fd, unsigned long req, const uint8_t *in, uint8_t *out, size_t len) {
+    unsigned ms = timeout_ms;
+    if (!ms) {
+        if (ioctl(fd, req, out ? out : (void *)in) < 0) { last_err = errno; return 0; }
+        return 1;
+    }
+
+    helper *h = helper_get();
+    if (!h) return 0;
+    h->buf = h->small;
+    if (len > HELPER_BUF) {
+        if (len > h->big_len) {
+            uint8_t *big = (uint8_t *)realloc(h->big, len);
+            if (!big) { last_err = ENOMEM; helper_retire(h); return 0; }
+            h->big = big;
+            h->big_len = len;
+        }
+        h->buf = h->big;
+    }
+    int dfd = dup(fd);
+    if (dfd < 0) { last_err = errno; helper_retire(h); return 0; }
+
+    struct timespec until;
+    clock_gettime(CLOCK_MONOTONIC, &until);
+    until.tv_sec  += ms / 1000;
+    until.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) { until.tv_sec++; until.tv_nsec -= 1000000000L; }
+
+    memcpy(h->buf, in, len);
+    pthread_mutex_lock(&h->m);
+    h->fd = dfd;
+    h->req = req;
+    h->has_job = 1;
+    pthread_cond_signal(&h->work);
+    while (!h->done && pthread_cond_timedwait(&h->finished, &h->m, &until) != ETIMEDOUT) {}
+    int ok = 0;
+    if (!h->done) {
+        h->abandoned = 1;
+        last_err = ETIMEDOUT;
+    } else {
+        if (h->rc < 0) last_err = h->err;
+        else           { ok = 1; if (out) memcpy(out, h->buf, len); }
+        h->done = 0;
+    }
+    int abandoned = h->abandoned;
+    pthread_mutex_unlock(&h->m);
+    if (!abandoned) helper_retire(h);
+    return ok;
+}
+
+static int hidraw_get_feature(hid_handle h, uint8_t *buf, size_t len) {
+    return feature_ioctl((int)h, HIDIOCGFEATURE(len), buf, buf, len);
+}
+
+static int hidraw_set_feature(hid_handle h, const uint8_t *buf, size_t len) {
+    return feature_ioctl((int)h, HIDIOCSFEATURE(len), buf, NULL, len);
+}
+
+static void hidraw_set_timeout(unsigned ms) {
+    timeout_ms = ms;
+}
+
+static unsigned long hidraw_last_error(void) {
+    return (unsigned long)last_err;
+}
+
+const hid_transport hid_transport_hidraw = {
+    "hidraw",
+    0,
+    hidraw_enumerate,
+    hidraw_lookup,
+    hidraw_open,
+    hidraw_close,
+    hidraw_feature_length,
+    hidraw_report_length,
+    hidraw_get_feature,
+    hidraw_set_feature,
+    hidraw_last_error,
+    hidraw_set_timeout,
+    NULL,
+};
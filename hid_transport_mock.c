@@ -0,0 +1,393 @@
+// hid_transport_mock.c — see hid_transport_mock.h.
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <time.h>
+#endif
+#ifdef _MSC_VER
+#  define MOCK_TLS __declspec(thread)
+#else
+#  define MOCK_TLS _Thread_local
+#endif
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hid_probe.h"
+#include "hid_report_desc.h"
+#include "hid_transport_mock.h"
+#include "sixaxis_profile.h"
+
+typedef struct {
+    uint16_t vid, pid;
+    const sixaxis_profile *prof; // NULL for decoys
+    uint8_t  host[6];   // display order
+    int      broken;
+    unsigned stale;     // gets left that still read zeros after a set
+} mock_dev;
+
+static mock_dev        devs[MOCK_MAX_DEVICES];
+static int             ndevs;
+static mock_hid_config cfg;
+static mock_hid_stats  stats;
+static unsigned long   io_ops;   // get+set calls, drives fail_every
+static unsigned        timeout_ms;
+static unsigned        hub_busy[MOCK_MAX_DEVICES / 7 + 1]; // transfers in flight per hub
+static MOCK_TLS int    last_err;
+
+#ifdef _WIN32
+static SRWLOCK lock = SRWLOCK_INIT;
+static void lock_state(void)   { AcquireSRWLockExclusive(&lock); }
+static void unlock_state(void) { ReleaseSRWLockExclusive(&lock); }
+static void sleep_us(unsigned us) { if (us) Sleep((us + 999) / 1000); }
+#else
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static void lock_state(void)   { pthread_mutex_lock(&lock); }
+static void unlock_state(void) { pthread_mutex_unlock(&lock); }
+static void sleep_us(unsigned us) {
+    if (!us) return;
+    struct timespec ts = { (time_t)(us / 1000000u), (long)(us % 1000000u) * 1000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+#endif
+
+// ---------- simulated report descriptors ----------
+// Feature reports declared by the simulated parts as {report ID, payload bytes};
+// the largest ones match the HidP caps of the real devices (49 and 64 bytes).
+enum { CLASS_DECOY, CLASS_DS3, CLASS_DS4, CLASS_COUNT };
+static const uint8_t ds3_features[][2] = { {0x01, 48}, {0xEF, 48}, {0xF2, 17}, {0xF5, 7} };
+static const uint8_t ds4_features[][2] = { {0x02, 36}, {0x12, 15}, {0x13, 22}, {0xA3, 48}, {0xF1, 63} };
+
+static uint16_t class_lens[CLASS_COUNT][256];
+static uint16_t class_max[CLASS_COUNT];
+static int      lens_ready;
+
+static size_t build_desc(const uint8_t (*f)[2], size_t n, uint8_t *out) {
+    size_t k = 0;
+    out[k++] = 0x06; out[k++] = 0x00; out[k++] = 0xFF;   // Usage Page (vendor)
+    out[k++] = 0x09; out[k++] = 0x01;                    // Usage
+    out[k++] = 0xA1; out[k++] = 0x01;                    // Collection (Application)
+    for (size_t i = 0; i < n; i++) {
+        out[k++] = 0x85; out[k++] = f[i][0];             // Report ID
+        out[k++] = 0x75; out[k++] = 0x08;                // Report Size 8
+        out[k++] = 0x95; out[k++] = f[i][1];             // Report Count
+        out[k++] = 0x09; out[k++] = f[i][0];             // Usage
+        out[k++] = 0xB1; out[k++] = 0x02;                // Feature (Data,Var,Abs)
+    }
+    out[k++] = 0xC0;                                     // End Collection
+    return k;
+}
+
+static void init_lens(void) {
+    uint8_t desc[128];
+    size_t n;
+    if (lens_ready) return;
+    n = build_desc(ds3_features, sizeof(ds3_features) / sizeof(ds3_features[0]), desc);
+    class_max[CLASS_DS3] = hid_desc_feature_lengths(desc, n, class_lens[CLASS_DS3]);
+    n = build_desc(ds4_features, sizeof(ds4_features) / sizeof(ds4_features[0]), desc);
+    class_max[CLASS_DS4] = hid_desc_feature_lengths(desc, n, class_lens[CLASS_DS4]);
+    lens_ready = 1;
+}
+
+// Report layout (ID, MAC offset, byte order) comes from the shared profile
+// table; decoys have none.
+static int class_of(const mock_dev *d) {
+    if (!d->prof) return CLASS_DECOY;
+    return d->prof->kind == SIXAXIS_KIND_DS3 ? CLASS_DS3 : CLASS_DS4;
+}
+
+static uint8_t report_of(const mock_dev *d) {
+    return d->prof ? d->prof->report_id : 0;
+}
+
+static const char *product_of(const mock_dev *d) {
+    if (!d->prof) return "Mock decoy HID";
+    switch (d->prof->kind) {
+        case SIXAXIS_KIND_DS3:    return "Mock PLAYSTATION(R)3 Controller";
+        case SIXAXIS_KIND_DONGLE: return "Mock DUALSHOCK 4 USB Wireless Adaptor";
+        default:                  return "Mock Wireless Controller";
+    }
+}
+
+static mock_dev *dev_of(hid_handle h) {
+    if (h < 0 || h >= ndevs) { last_err = ENODEV; return NULL; }
+    return &devs[h];
+}
+
+// Counts an I/O and decides whether it fails; called with the lock held.
+static int io_fails(const mock_dev *d, uint8_t report_id, size_t len) {
+    io_ops++;
+    if (d->broken || (cfg.fail_every && io_ops % cfg.fail_every == 0)) {
+        last_err = EIO;
+    } else if (report_id == 0 || report_id != report_of(d) || len < class_lens[class_of(d)][report_id]) {
+        last_err = EPIPE; // real devices STALL unknown or short reports
+    } else {
+        return 0;
+    }
+    stats.failures++;
+    return 1;
+}
+
+// ---------- transport ----------
+static void describe(int i, hid_device_info *info) {
+    memset(info, 0, sizeof(*info));
+    snprintf(info->path, sizeof(info->path), "mock://%d", i);
+    info->vid = devs[i].vid;
+    info->pid = devs[i].pid;
+    snprintf(info->product, sizeof(info->product), "%s", product_of(&devs[i]));
+    // Controllers report their own Bluetooth address as the serial, like a DS4.
+    if (devs[i].prof)
+        snprintf(info->serial, sizeof(info->serial), "a0:5a:00:%02x:%02x:%02x",
+                 (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF);
+    snprintf(info->port, sizeof(info->port), "1-%d.%d", i / 7 + 1, i % 7 + 1);
+}
+
+// The listing pass costs enum_us per interface, the probe pass probe_us per
+// Sony (or, for vid 0, every) interface on hid_probe_run's pool.
+static int mock_probe(const char *path, uint16_t vid, hid_device_info *out) {
+    int i;
+    if (sscanf(path, "mock://%d", &i) != 1 || i < 0 || i >= ndevs) return 0;
+    sleep_us(cfg.probe_us);
+    if (vid != 0 && devs[i].vid != vid) return 0;
+    describe(i, out);
+    return 1;
+}
+
+static int mock_enumerate(uint16_t vid, hid_enum_cb cb, void *user) {
+    lock_state(); stats.enumerations++; unlock_state();
+
+    hid_probe_list list;
+    memset(&list, 0, sizeof(list));
+    for (int i = 0; i < ndevs; i++) {
+        char path[32];
+        sleep_us(cfg.enum_us);
+        if (vid != 0 && devs[i].vid != vid) continue;
+        snprintf(path, sizeof(path), "mock://%d", i);
+        if (!hid_probe_add(&list, path)) break;
+    }
+    return hid_probe_run(&list, vid, mock_probe, cb, user);
+}
+
+static int mock_lookup(const char *path, hid_device_info *out) {
+    int i;
+    if (sscanf(path, "mock://%d", &i) != 1 || i < 0 || i >= ndevs) { last_err = ENOENT; return 0; }
+    sleep_us(cfg.enum_us + cfg.probe_us);
+    describe(i, out);
+    return 1;
+}
+
+static hid_handle mock_open(const char *path) {
+    int i;
+    if (sscanf(path, "mock://%d", &i) != 1 || i < 0 || i >= ndevs) { last_err = ENOENT; return HID_INVALID_HANDLE; }
+    sleep_us(cfg.open_us);
+    lock_state(); stats.opens++; stats.open_handles++; unlock_state();
+    return (hid_handle)i;
+}
+
+static void mock_close(hid_handle h) {
+    if (!dev_of(h)) return;
+    lock_state(); stats.open_handles--; unlock_state();
+}
+
+static int mock_feature_length(hid_handle h, uint16_t *out_len) {
+    const mock_dev *d = dev_of(h);
+    if (!d) return 0;
+    if (!class_max[class_of(d)]) { last_err = ENOENT; return 0; }
+    if (out_len) *out_len = class_max[class_of(d)];
+    return 1;
+}
+
+static int mock_report_length(hid_handle h, uint8_t report_id, uint16_t *out_len) {
+    const mock_dev *d = dev_of(h);
+    if (!d) return 0;
+    if (!class_lens[class_of(d)][report_id]) { last_err = ENOENT; return 0; }
+    if (out_len) *out_len = class_lens[class_of(d)][report_id];
+    return 1;
+}
+
+// Every stall_every-th device hangs each transfer for stall_ms; with a
+// deadline shorter than that the call gives up at the deadline instead.
+static int stalls(const mock_dev *d) {
+    if (!cfg.stall_every || ((d - devs) + 1) % cfg.stall_every != 0) return 0;
+    unsigned ms = timeout_ms && timeout_ms < cfg.stall_ms ? timeout_ms : cfg.stall_ms;
+    sleep_us(ms * 1000u);
+    if (ms == cfg.stall_ms) return 0;
+    lock_state(); stats.timeouts++; unlock_state();
+    last_err = (int)HID_ERR_TIMEOUT;
+    return 1;
+}
+
+// Devices 7k..7k+6 share hub 1-(k+1). A transfer that starts while hub_max
+// others are running on the same hub loses the contended control pipe and
+// fails busy once its time is up, like a request NAKed past its deadline.
+static int hub_enter(const mock_dev *d) {
+    if (!cfg.hub_max) return 0;
+    lock_state();
+    int contended = ++hub_busy[(d - devs) / 7] > cfg.hub_max;
+    unlock_state();
+    return contended;
+}
+
+// Called with the lock held; counts the failure of a contended transfer.
+static int hub_leave(const mock_dev *d, int contended) {
+    if (!cfg.hub_max) return 0;
+    hub_busy[(d - devs) / 7]--;
+    if (!contended) return 0;
+    stats.hub_contention++;
+    stats.failures++;
+    last_err = (int)HID_ERR_BUSY;
+    return 1;
+}
+
+static int mock_get_feature(hid_handle h, uint8_t *buf, size_t len) {
+    mock_dev *d = dev_of(h);
+    if (!d) return 0;
+    if (stalls(d)) return 0;
+    int contended = hub_enter(d);
+    sleep_us(cfg.get_us + (unsigned)(cfg.byte_ns * len / 1000));
+
+    lock_state();
+    stats.gets++;
+    stats.bytes += len;
+    if (hub_leave(d, contended) || io_fails(d, buf[0], len)) { unlock_state(); return 0; }
+    memset(buf + 1, 0, len - 1);
+    if (d->stale) d->stale--;
+    else sixaxis_profile_put_mac(d->prof, buf, d->host);
+    unlock_state();
+    return 1;
+}
+
+static int mock_set_feature(hid_handle h, const uint8_t *buf, size_t len) {
+    mock_dev *d = dev_of(h);
+    if (!d) return 0;
+    if (stalls(d)) return 0;
+    int contended = hub_enter(d);
+    sleep_us(cfg.set_us + (unsigned)(cfg.byte_ns * len / 1000));
+
+    lock_state();
+    stats.sets++;
+    stats.bytes += len;
+    if (hub_leave(d, contended) || io_fails(d, buf[0], len)) { unlock_state(); return 0; }
+    sixaxis_profile_get_mac(d->prof, buf, d->host);
+    d->stale = cfg.settle_reads;
+    unlock_state();
+    return 1;
+}
+
+static unsigned long mock_last_error(void) {
+    return (unsigned long)last_err;
+}
+
+static void mock_set_timeout(unsigned ms) {
+    lock_state(); timeout_ms = ms; unlock_state();
+}
+
+const hid_transport hid_transport_mock = {
+    "mock",
+    0,
+    mock_enumerate,
+    mock_lookup,
+    mock_open,
+    mock_close,
+    mock_feature_length,
+    mock_report_length,
+    mock_get_feature,
+    mock_set_feature,
+    mock_last_error,
+    mock_set_timeout,
+    NULL,
+};
+
+// ---------- configuration ----------
+void mock_hid_reset(const mock_hid_config *c) {
+    lock_state();
+    init_lens();
+    memset(devs, 0, sizeof(devs));
+    ndevs = 0;
+    io_ops = 0;
+    memset(hub_busy, 0, sizeof(hub_busy));
+    memset(&stats, 0, sizeof(stats));
+    if (c) cfg = *c; else memset(&cfg, 0, sizeof(cfg));
+    unlock_state();
+}
+
+int mock_hid_add(uint16_t vid, uint16_t pid) {
+    lock_state();
+    init_lens();
+    int i = ndevs < MOCK_MAX_DEVICES ? ndevs++ : -1;
+    if (i >= 0) {
+        memset(&devs[i], 0, sizeof(devs[i]));
+        devs[i].vid = vid;
+        devs[i].pid = pid;
+        devs[i].prof = sixaxis_profile_for(vid, pid);
+    }
+    unlock_state();
+    return i;
+}
+
+void mock_hid_populate(unsigned ds4, unsigned ds3, unsigned dongles, unsigned decoys) {
+    static const uint16_t ds4_pids[] = { 0x05C4, 0x09CC, 0x0CE6, 0x0CDA };
+    static const uint16_t ds3_pids[] = { 0x0268, 0x042F };
+    for (unsigned i = 0; i < decoys; i++)  mock_hid_add(0x046D, (uint16_t)(0xC000 + i));
+    for (unsigned i = 0; i < ds4; i++)     mock_hid_add(SONY_VID, ds4_pids[i % 4]);
+    for (unsigned i = 0; i < ds3; i++)     mock_hid_add(SONY_VID, ds3_pids[i % 2]);
+    for (unsigned i = 0; i < dongles; i++) mock_hid_add(SONY_VID, 0x0BA0);
+}
+
+void mock_hid_set_broken(int index, int broken) {
+    lock_state();
+    if (index >= 0 && index < ndevs) devs[index].broken = broken;
+    unlock_state();
+}
+
+int mock_hid_stored_mac(int index, uint8_t mac6[6]) {
+    if (index < 0 || index >= ndevs) return 0;
+    lock_state(); memcpy(mac6, devs[index].host, 6); unlock_state();
+    return 1;
+}
+
+void mock_hid_get_stats(mock_hid_stats *out) {
+    lock_state(); *out = stats; unlock_state();
+}
+
+int mock_hid_configure(const char *spec) {
+    mock_hid_config c;
+    unsigned ds4 = 0, ds3 = 0, dongles = 0, decoys = 0;
+    memset(&c, 0, sizeof(c));
+    if (!spec || !*spec) spec = "ds4=1";
+
+    for (const char *p = spec; *p; ) {
+        char key[32];
+        unsigned long v;
+        int n = 0;
+        if (sscanf(p, "%31[^=]=%lu%n", key, &v, &n) != 2) return 0;
+        if      (!strcmp(key, "ds4"))        ds4 = (unsigned)v;
+        else if (!strcmp(key, "ds3"))        ds3 = (unsigned)v;
+        else if (!strcmp(key, "dongle"))     dongles = (unsigned)v;
+        else if (!strcmp(key, "decoy"))      decoys = (unsigned)v;
+        else if (!strcmp(key, "enum_us"))    c.enum_us = (unsigned)v;
+        else if (!strcmp(key, "probe_us"))   c.probe_us = (unsigned)v;
+        else if (!strcmp(key, "open_us"))    c.open_us = (unsigned)v;
+        else if (!strcmp(key, "get_us"))     c.get_us = (unsigned)v;
+        else if (!strcmp(key, "set_us"))     c.set_us = (unsigned)v;
+        else if (!strcmp(key, "byte_ns"))    c.byte_ns = (unsigned)v;
+        else if (!strcmp(key, "settle_reads")) c.settle_reads = (unsigned)v;
+        else if (!strcmp(key, "stall_every")) c.stall_every = (unsigned)v;
+        else if (!strcmp(key, "stall_ms"))   c.stall_ms = (unsigned)v;
+        else if (!strcmp(key, "hub_max"))    c.hub_max = (unsigned)v;
+        else if (!strcmp(key, "fail_every")) c.fail_every = (unsigned)v;
+        else return 0;
+        p += n;
+        if (*p == ',') p++;
+        else if (*p) return 0;
+    }
+    mock_hid_reset(&c);
+    mock_hid_populate(ds4, ds3, dongles, decoys);
+    return 1;
+}
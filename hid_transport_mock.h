@@ -0,0 +1,68 @@
+// hid_transport_mock.h — in-process simulated DS3/DS4 devices for hid_transport.h.
+//
+// Emulates exactly the feature reports the pairing tools use:
+//   DS3/Move (0x0268, 0x042F): report 0xF5, host MAC forward at [2..7]
+//   DS4 family and dongle:     report 0x12, host MAC reversed at [2..7]
+// plus non-Sony decoy interfaces. Devices expose a report descriptor shaped
+// like the real parts, so per-report lengths differ from the caps maximum.
+// Device i is "mock://i" on USB port "1-<i/7+1>.<i%7+1>"; controllers report
+// serial a0:5a:00:xx:xx:xx with i in the low three bytes.
+// Latency and failures are injectable, and every call is counted, so
+// enumeration/get/set/batch paths can be measured without a controller.
+
+#ifndef HID_TRANSPORT_MOCK_H
+#define HID_TRANSPORT_MOCK_H
+
+#include "hid_transport.h"
+
+#define MOCK_MAX_DEVICES 1024
+
+typedef struct {
+    unsigned enum_us;     // per interface listed by enumerate (decoys included)
+    unsigned probe_us;    // per interface enumerate then probes (see hid_probe.h)
+    unsigned open_us;     // per open
+    unsigned get_us;      // per GetFeature
+    unsigned set_us;      // per SetFeature
+    unsigned byte_ns;     // per byte of feature payload moved (control transfer cost)
+    unsigned fail_every;  // fail every Nth get/set across all devices (0 = never)
+    unsigned settle_reads; // gets after a set that still read zeros, like firmware
+                           // that only reports the new MAC after a while
+    unsigned stall_every; // every Nth device (by index) hangs each get/set ...
+    unsigned stall_ms;    // ... this long, or until the set_timeout deadline
+    unsigned hub_max;     // transfers a hub (7 devices) carries at once; more are refused busy (0 = any)
+} mock_hid_config;
+
+typedef struct {
+    unsigned long enumerations;
+    unsigned long opens;
+    unsigned long open_handles;  // currently open; nonzero after a run = leak
+    unsigned long gets;
+    unsigned long sets;
+    unsigned long failures;      // injected or unsupported-report failures
+    unsigned long timeouts;      // stalled transfers cut off by the deadline
+    unsigned long hub_contention; // transfers failed past hub_max (in failures too)
+    unsigned long long bytes;    // feature payload moved by get+set, report ID included
+} mock_hid_stats;
+
+extern const hid_transport hid_transport_mock;
+
+// Removes all devices, zeroes counters and applies cfg (NULL = no latency/failures).
+void mock_hid_reset(const mock_hid_config *cfg);
+// Adds a device and returns its index, or -1 when full. Stored host MAC starts zeroed.
+int  mock_hid_add(uint16_t vid, uint16_t pid);
+// Adds non-Sony decoys, then ds4 DS4s, ds3 DS3s and DS4 dongles, one block
+// after another in that order. Indexes follow, and so do hubs (7 per hub).
+void mock_hid_populate(unsigned ds4, unsigned ds3, unsigned dongles, unsigned decoys);
+// Makes every get/set on device `index` fail (broken = 1) or work again.
+void mock_hid_set_broken(int index, int broken);
+// Host MAC the device currently stores, in display order. Returns 0 for bad index.
+int  mock_hid_stored_mac(int index, uint8_t mac6[6]);
+void mock_hid_get_stats(mock_hid_stats *out);
+
+// Configures from a spec string such as
+//   "ds4=3,ds3=2,dongle=1,decoy=50,get_us=2000,set_us=2000,byte_ns=800,fail_every=7,settle_reads=2,
+//    stall_every=4,stall_ms=10000,hub_max=2"
+// (the SIXAXIS_MOCK environment variable of the CLI). Returns 0 on a bad key.
+int  mock_hid_configure(const char *spec);
+
+#endif // HID_TRANSPORT_MOCK_H
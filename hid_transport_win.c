@@ -0,0 +1,352 @@
+// hid_transport_win.c — SetupAPI + hid.dll backend for hid_transport.h.
+
+#ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <setupapi.h>
+#include <cfgmgr32.h>
+#include <hidsdi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hid_probe.h"
+#include "hid_transport.h"
+
+#ifdef _MSC_VER
+#  pragma comment(lib, "setupapi.lib")
+#  pragma comment(lib, "hid.lib")
+#  pragma comment(lib, "cfgmgr32.lib")
+#endif
+
+#ifndef IOCTL_HID_GET_FEATURE // hidclass.h (WDK)
+#  define IOCTL_HID_GET_FEATURE 0xB0192
+#  define IOCTL_HID_SET_FEATURE 0xB0191
+#endif
+
+static volatile LONG timeout_ms; // per open/get/set, 0 = wait forever
+
+// Overlapped so feature transfers can be abandoned (see feature_ioctl).
+static HANDLE open_path(const char *path) {
+    HANDLE h = CreateFileA(path, GENERIC_READ|GENERIC_WRITE,
+                           FILE_SHARE_READ|FILE_SHARE_WRITE, NULL,
+                           OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+    if (h == INVALID_HANDLE_VALUE) {
+        // retry with write-only (some collections don't allow read)
+        h = CreateFileA(path, GENERIC_WRITE,
+                        FILE_SHARE_READ|FILE_SHARE_WRITE, NULL,
+                        OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+    }
+    return h;
+}
+
+// ---------- deadlines ----------
+// Jobs come from a fixed pool; the heap is only used while more opens than
+// slots are abandoned to their helpers.
+#define OPEN_SLOTS 16
+
+typedef struct {
+    char   path[HID_PATH_MAX];
+    HANDLE h;
+    DWORD  err;
+    LONG   refs; // caller + opener thread; the last one out owns h
+    int    slot; // index into open_pool, -1 = heap
+} open_job;
+
+static open_job      open_pool[OPEN_SLOTS];
+static volatile LONG open_busy[OPEN_SLOTS];
+
+static open_job *job_new(void) {
+    for (int i = 0; i < OPEN_SLOTS; i++) {
+        if (open_busy[i] || InterlockedExchange(&open_busy[i], 1)) continue;
+        open_pool[i].slot = i;
+        return &open_pool[i];
+    }
+    open_job *j = (open_job *)calloc(1, sizeof(*j));
+    if (j) j->slot = -1;
+    return j;
+}
+
+static void job_free(open_job *j) {
+    if (j->slot < 0) free(j);
+    else InterlockedExchange(&open_busy[j->slot], 0);
+}
+
+static DWORD WINAPI open_thread(LPVOID p) {
+    open_job *j = (open_job *)p;
+    j->h = open_path(j->path);
+    j->err = GetLastError();
+    if (InterlockedDecrement(&j->refs) == 0) { // caller already gave up
+        if (j->h != INVALID_HANDLE_VALUE) CloseHandle(j->h);
+        job_free(j);
+    }
+    return 0;
+}
+
+// CreateFile has no timeout of its own: run it on a helper thread and, past
+// the deadline, cancel it and leave a late handle to the helper to close.
+static HANDLE open_deadline(const char *path) {
+    DWORD ms = (DWORD)timeout_ms;
+    if (!ms) return open_path(path);
+
+    open_job *j = job_new();
+    if (!j) return open_path(path);
+    lstrcpynA(j->path, path, (int)sizeof(j->path));
+    j->h = INVALID_HANDLE_VALUE;
+    j->err = 0;
+    j->refs = 2;
+    HANDLE t = CreateThread(NULL, 0, open_thread, j, 0, NULL);
+    if (!t) { job_free(j); return open_path(path); }
+    if (WaitForSingleObject(t, ms) != WAIT_OBJECT_0) CancelSynchronousIo(t);
+    CloseHandle(t);
+
+    if (InterlockedDecrement(&j->refs) != 0) {
+        SetLastError(ERROR_TIMEOUT);
+        return INVALID_HANDLE_VALUE;
+    }
+    HANDLE h = j->h;
+    DWORD err = j->err;
+    job_free(j);
+    if (h == INVALID_HANDLE_VALUE) SetLastError(err);
+    return h;
+}
+
+// One feature IOCTL on an overlapped handle, cancelled at the deadline. The
+// cancelled request is waited out because it still owns buf.
+static int feature_ioctl(HANDLE h, DWORD code, void *in, DWORD in_len, void *out, DWORD out_len) {
+    DWORD ms = (DWORD)timeout_ms, n = 0, err;
+    OVERLAPPED ol;
+    memset(&ol, 0, sizeof(ol));
+    ol.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (!ol.hEvent) return 0;
+
+    BOOL ok = DeviceIoControl(h, code, in, in_len, out, out_len, &n, &ol);
+    if (!ok && GetLastError() == ERROR_IO_PENDING) {
+        if (WaitForSingleObject(ol.hEvent, ms ? ms : INFINITE) == WAIT_OBJECT_0) {
+            ok = GetOverlappedResult(h, &ol, &n, FALSE);
+        } else {
+            CancelIoEx(h, &ol);
+            ok = GetOverlappedResult(h, &ol, &n, TRUE); // may have completed meanwhile
+            if (!ok) SetLastError(ERROR_TIMEOUT);
+        }
+    }
+    err = GetLastError();
+    CloseHandle(ol.hEvent);
+    SetLastError(err);
+    return ok ? 1 : 0;
+}
+
+static int hex_field(const char *s, int digits, unsigned *out) {
+    unsigned v = 0;
+    for (int i = 0; i < digits; i++) {
+        char c = s[i];
+        if      (c >= '0' && c <= '9') v = (v << 4) | (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') v = (v << 4) | (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') v = (v << 4) | (unsigned)(c - 'A' + 10);
+        else return 0;
+    }
+    *out = v;
+    return 1;
+}
+
+// Pulls VID/PID out of an interface path without opening it:
+//   USB: \\?\hid#vid_054c&pid_05c4&mi_03#...
+//   BT:  \\?\hid#{00001124-...}_vid&0002054c_pid&05c4#...
+static int vidpid_from_path(const char *path, uint16_t *vid, uint16_t *pid) {
+    unsigned v = 0, p = 0;
+    int have_v = 0, have_p = 0;
+    for (const char *s = path; *s && !(have_v && have_p); s++) {
+        if (_strnicmp(s, "vid_", 4) == 0)      have_v = hex_field(s + 4, 4, &v);
+        else if (_strnicmp(s, "vid&", 4) == 0) have_v = hex_field(s + 4, 8, &v);
+        else if (_strnicmp(s, "pid_", 4) == 0 || _strnicmp(s, "pid&", 4) == 0)
+            have_p = hex_field(s + 4, 4, &p);
+    }
+    if (!have_v || !have_p) return 0;
+    *vid = (uint16_t)(v & 0xFFFF);
+    *pid = (uint16_t)p;
+    return 1;
+}
+
+// USB port of an interface: the device instance is the path between "\\?\"
+// and "#{class guid}" with '#' for '\'; its HID node sits below the USB
+// interface and device nodes, and the first ancestor whose location reads
+// "Port_#xxxx.Hub_#yyyy" is the physical port.
+static void port_location(const char *path, char *out, size_t outlen) {
+    char id[HID_PATH_MAX];
+    const char *start = strncmp(path, "\\\\?\\", 4) == 0 ? path + 4 : path;
+    const char *end = strstr(start, "#{");
+    size_t n = end ? (size_t)(end - start) : strlen(start);
+    if (n >= sizeof(id)) return;
+    for (size_t i = 0; i < n; i++) id[i] = start[i] == '#' ? '\\' : start[i];
+    id[n] = 0;
+
+    DEVINST dn;
+    if (CM_Locate_DevNodeA(&dn, id, CM_LOCATE_DEVNODE_NORMAL) != CR_SUCCESS) return;
+    for (int depth = 0; depth < 4 && CM_Get_Parent(&dn, dn, 0) == CR_SUCCESS; depth++) {
+        char loc[HID_PORT_MAX];
+        ULONG len = sizeof(loc);
+        if (CM_Get_DevNode_Registry_PropertyA(dn, CM_DRP_LOCATION_INFORMATION, NULL, loc, &len, 0) == CR_SUCCESS
+            && strncmp(loc, "Port_#", 6) == 0) {
+            lstrcpynA(out, loc, (int)outlen);
+            return;
+        }
+    }
+}
+
+// Opens one interface for its attributes, product and serial strings and
+// resolves its USB port; 0 if it is gone or belongs to another vendor (vid 0 = any).
+static int describe(const char *path, uint16_t vid, hid_device_info *info) {
+    int ok = 0;
+    HANDLE h = open_deadline(path);
+    if (h == INVALID_HANDLE_VALUE) return 0;
+    HIDD_ATTRIBUTES a; a.Size = sizeof(a);
+    if (HidD_GetAttributes(h, &a) && (vid == 0 || a.VendorID == vid)) {
+        WCHAR prod[HID_STR_MAX] = {0};
+        memset(info, 0, sizeof(*info));
+        lstrcpynA(info->path, path, (int)sizeof(info->path));
+        info->vid = a.VendorID;
+        info->pid = a.ProductID;
+        if (HidD_GetProductString(h, prod, sizeof(prod) - sizeof(WCHAR)))
+            WideCharToMultiByte(CP_UTF8, 0, prod, -1, info->product, (int)sizeof(info->product), NULL, NULL);
+        memset(prod, 0, sizeof(prod));
+        if (HidD_GetSerialNumberString(h, prod, sizeof(prod) - sizeof(WCHAR)))
+            WideCharToMultiByte(CP_UTF8, 0, prod, -1, info->serial, (int)sizeof(info->serial), NULL, NULL);
+        port_location(path, info->port, sizeof(info->port));
+        ok = 1;
+    }
+    CloseHandle(h);
+    return ok;
+}
+
+// Listing pass: interfaces whose path already names another vendor are
+// skipped before CreateFile; only unparseable paths fall back to open +
+// HidD_GetAttributes. The opens then run on hid_probe_run's pool.
+static int win_enumerate(uint16_t vid, hid_enum_cb cb, void *user) {
+    GUID g; HidD_GetHidGuid(&g);
+    HDEVINFO devs = SetupDiGetClassDevsA(&g, NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+    if (devs == INVALID_HANDLE_VALUE) return -1;
+
+    SP_DEVICE_INTERFACE_DATA ifd; ifd.cbSize = sizeof(ifd);
+    DWORD idx = 0;
+    hid_probe_list list;
+    memset(&list, 0, sizeof(list));
+
+    // One detail buffer for the whole walk: the path is bounded by HID_PATH_MAX
+    // (longer ones could not be stored in hid_device_info anyway).
+    union {
+        SP_DEVICE_INTERFACE_DETAIL_DATA_A d;
+        char raw[sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA_A) + HID_PATH_MAX];
+    } det;
+
+    while (SetupDiEnumDeviceInterfaces(devs, NULL, &g, idx++, &ifd)) {
+        det.d.cbSize = sizeof(det.d);
+        if (!SetupDiGetDeviceInterfaceDetailA(devs, &ifd, &det.d, (DWORD)sizeof(det), NULL, NULL))
+            continue;
+
+        uint16_t pv = 0, pp = 0;
+        if (vid != 0 && vidpid_from_path(det.d.DevicePath, &pv, &pp) && pv != vid) continue;
+        if (!hid_probe_add(&list, det.d.DevicePath)) break;
+    }
+    SetupDiDestroyDeviceInfoList(devs);
+    return hid_probe_run(&list, vid, describe, cb, user);
+}
+
+static int win_lookup(const char *path, hid_device_info *out) {
+    return describe(path, 0, out);
+}
+
+static hid_handle win_open(const char *path) {
+    HANDLE h = open_deadline(path);
+    return h == INVALID_HANDLE_VALUE ? HID_INVALID_HANDLE : (hid_handle)h;
+}
+
+static void win_close(hid_handle h) {
+    CloseHandle((HANDLE)h);
+}
+
+static int win_feature_length(hid_handle h, uint16_t *out_len) {
+    PHIDP_PREPARSED_DATA pp = NULL;
+    HIDP_CAPS caps;
+    if (!HidD_GetPreparsedData((HANDLE)h, &pp)) return 0;
+    NTSTATUS st = HidP_GetCaps(pp, &caps);
+    HidD_FreePreparsedData(pp);
+    if (st != HIDP_STATUS_SUCCESS) return 0;
+    if (out_len) *out_len = caps.FeatureReportByteLength;
+    return 1;
+}
+
+// hid.dll has no per-report length; add up the feature value and button caps
+// of the ID. The pairing core does not call this while the transport sets
+// HID_TF_FULL_LENGTH, so opens cost one caps query. Constant (padding) fields have no caps, so this can come out
+// short; callers fall back to the full length when a transfer is refused.
+static int win_report_length(hid_handle h, uint8_t report_id, uint16_t *out_len) {
+    PHIDP_PREPARSED_DATA pp = NULL;
+    HIDP_CAPS caps;
+    unsigned long bits = 0;
+    int ok = 0;
+
+    if (!HidD_GetPreparsedData((HANDLE)h, &pp)) return 0;
+    if (HidP_GetCaps(pp, &caps) != HIDP_STATUS_SUCCESS) goto done;
+
+    // Caps arrays on the stack; the DS3/DS4 descriptors need a few dozen.
+    HIDP_VALUE_CAPS  vc[64];
+    HIDP_BUTTON_CAPS bc[64];
+    USHORT n = caps.NumberFeatureValueCaps;
+    if (n > 64) n = 64;
+    if (n && HidP_GetValueCaps(HidP_Feature, vc, &n, pp) == HIDP_STATUS_SUCCESS) {
+        for (USHORT i = 0; i < n; i++)
+            if (vc[i].ReportID == report_id) bits += (unsigned long)vc[i].BitSize * vc[i].ReportCount;
+    }
+    n = caps.NumberFeatureButtonCaps;
+    if (n > 64) n = 64;
+    if (n && HidP_GetButtonCaps(HidP_Feature, bc, &n, pp) == HIDP_STATUS_SUCCESS) {
+        for (USHORT i = 0; i < n; i++) {
+            if (bc[i].ReportID != report_id) continue;
+            bits += bc[i].IsRange ? (unsigned long)(bc[i].Range.UsageMax - bc[i].Range.UsageMin + 1) : 1;
+        }
+    }
+    if (bits) {
+        unsigned long len = 1 + (bits + 7) / 8;
+        if (len > caps.FeatureReportByteLength) len = caps.FeatureReportByteLength;
+        if (out_len) *out_len = (uint16_t)len;
+        ok = 1;
+    } else {
+        SetLastError(ERROR_NOT_FOUND);
+    }
+done:
+    HidD_FreePreparsedData(pp);
+    return ok;
+}
+
+// Same IOCTLs HidD_GetFeature/HidD_SetFeature issue, but overlapped.
+static int win_get_feature(hid_handle h, uint8_t *buf, size_t len) {
+    return feature_ioctl((HANDLE)h, IOCTL_HID_GET_FEATURE, buf, (DWORD)len, buf, (DWORD)len);
+}
+
+static int win_set_feature(hid_handle h, const uint8_t *buf, size_t len) {
+    return feature_ioctl((HANDLE)h, IOCTL_HID_SET_FEATURE, (void *)buf, (DWORD)len, NULL, 0);
+}
+
+static unsigned long win_last_error(void) {
+    return GetLastError();
+}
+
+static void win_set_timeout(unsigned ms) {
+    InterlockedExchange(&timeout_ms, (LONG)ms);
+}
+
+const hid_transport hid_transport_win = {
+    "hid.dll",
+    HID_TF_FULL_LENGTH, // hidclass rejects get and set buffers shorter than the caps length
+    win_enumerate,
+    win_lookup,
+    win_open,
+    win_close,
+    win_feature_length,
+    win_report_length,
+    win_get_feature,
+    win_set_feature,
+    win_last_error,
+    win_set_timeout,
+    NULL,
+};
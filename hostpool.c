@@ -0,0 +1,272 @@
+// hostpool.c — see hostpool.h.
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hostpool.h"
+#include "sixaxis_pair.h"
+
+#define KEY_MAX (HID_PATH_MAX + 8)
+
+typedef struct {
+    uint8_t  mac[6];
+    unsigned capacity;
+    unsigned load;
+} host;
+
+// One per known controller. Bounded by the total capacity, so lookups are a
+// plain scan.
+typedef struct {
+    char key[KEY_MAX];
+    int  host;
+    int  saved;   // 0 = reserved by hostpool_assign, not yet in the state file
+} entry;
+
+struct hostpool {
+    host    hosts[HOSTPOOL_MAX_HOSTS];
+    size_t  nhosts;
+    entry  *entries;
+    size_t  n, cap;
+    FILE   *state;
+#ifdef _WIN32
+    SRWLOCK lock;
+#else
+    pthread_mutex_t lock;
+#endif
+};
+
+#ifdef _WIN32
+static void lock_pool(hostpool *p)   { AcquireSRWLockExclusive(&p->lock); }
+static void unlock_pool(hostpool *p) { ReleaseSRWLockExclusive(&p->lock); }
+#else
+static void lock_pool(hostpool *p)   { pthread_mutex_lock(&p->lock); }
+static void unlock_pool(hostpool *p) { pthread_mutex_unlock(&p->lock); }
+#endif
+
+static void key_of(const hid_device_info *info, char key[KEY_MAX]) {
+    if (info->serial[0])    snprintf(key, KEY_MAX, "serial:%s", info->serial);
+    else if (info->port[0]) snprintf(key, KEY_MAX, "port:%s", info->port);
+    else                    snprintf(key, KEY_MAX, "path:%s", info->path);
+    for (char *c = key; *c; c++) *c = (char)tolower((unsigned char)*c);
+}
+
+static entry *find(hostpool *p, const char *key) {
+    for (size_t i = 0; i < p->n; i++)
+        if (strcmp(p->entries[i].key, key) == 0) return &p->entries[i];
+    return NULL;
+}
+
+static int host_of(const hostpool *p, const uint8_t mac6[6]) {
+    for (size_t i = 0; i < p->nhosts; i++)
+        if (memcmp(p->hosts[i].mac, mac6, 6) == 0) return (int)i;
+    return -1;
+}
+
+static entry *add(hostpool *p, const char *key, int h, int saved) {
+    if (p->n == p->cap) {
+        size_t cap = p->cap ? p->cap * 2 : 64;
+        entry *e = (entry *)realloc(p->entries, cap * sizeof(*e));
+        if (!e) return NULL;
+        p->entries = e;
+        p->cap = cap;
+    }
+    entry *e = &p->entries[p->n++];
+    snprintf(e->key, sizeof(e->key), "%s", key);
+    e->host = h;
+    e->saved = saved;
+    p->hosts[h].load++;
+    return e;
+}
+
+// ---------- setup ----------
+static char *read_text(const char *file) {
+    FILE *f = fopen(file, "rb");
+    if (!f) return NULL;
+    char *text = NULL;
+    long size;
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0
+        && (text = (char *)malloc((size_t)size + 1)) != NULL) {
+        size_t got = fread(text, 1, (size_t)size, f);
+        text[got] = 0;
+    }
+    fclose(f);
+    return text;
+}
+
+static int parse_hosts(hostpool *p, char *list, char *err, size_t errlen) {
+    for (char *tok = list, *next; tok && *tok; tok = next) {
+        next = tok + strcspn(tok, ",\n");
+        if (*next) *next++ = 0;
+        while (isspace((unsigned char)*tok)) tok++;
+        char *end = tok + strlen(tok);
+        while (end > tok && isspace((unsigned char)end[-1])) *--end = 0;
+        if (!*tok || *tok == '#') continue;
+
+        unsigned capacity = HOSTPOOL_DEFAULT_CAPACITY;
+        char *eq = strchr(tok, '=');
+        if (eq) {
+            *eq = 0;
+            capacity = (unsigned)strtoul(eq + 1, NULL, 10);
+        }
+        uint8_t mac6[6];
+        if (!parse_mac(tok, mac6) || capacity == 0) {
+            snprintf(err, errlen, "bad host '%s' (use aa:bb:cc:dd:ee:ff[=capacity])", tok);
+            return 0;
+        }
+        if (host_of(p, mac6) >= 0 || p->nhosts == HOSTPOOL_MAX_HOSTS) {
+            snprintf(err, errlen, "host '%s' listed twice or more than %d hosts", tok, HOSTPOOL_MAX_HOSTS);
+            return 0;
+        }
+        memcpy(p->hosts[p->nhosts].mac, mac6, 6);
+        p->hosts[p->nhosts++].capacity = capacity;
+    }
+    if (!p->nhosts) {
+        snprintf(err, errlen, "no host adapters given");
+        return 0;
+    }
+    return 1;
+}
+
+// "<host mac> <controller key>" per line, appended as controllers pair; the
+// last line for a key wins. Rows for hosts no longer listed are dropped, so
+// those controllers are placed again.
+static int load_state(hostpool *p, const char *file, char *err, size_t errlen) {
+    char *text = read_text(file);
+    if (!text) return 1; // first run
+    for (char *line = text, *next; line && *line; line = next) {
+        next = strchr(line, '\n');
+        if (next) *next++ = 0;
+        line[strcspn(line, "\r")] = 0;
+        char *key = strchr(line, ' ');
+        uint8_t mac6[6];
+        if (*line == '#' || !key) continue;
+        *key++ = 0;
+        int h = parse_mac(line, mac6) ? host_of(p, mac6) : -1;
+        if (h < 0 || !*key) continue;
+
+        entry *e = find(p, key);
+        if (e) {
+            p->hosts[e->host].load--;
+            p->hosts[h].load++;
+            e->host = h;
+        } else if (!add(p, key, h, 1)) {
+            free(text);
+            snprintf(err, errlen, "out of memory reading '%s'", file);
+            return 0;
+        }
+    }
+    free(text);
+    return 1;
+}
+
+hostpool *hostpool_open(const char *hosts, const char *state_file, char *err, size_t errlen) {
+    hostpool *p = (hostpool *)calloc(1, sizeof(*p));
+    char *list = hosts[0] == '@' ? read_text(hosts + 1) : (char *)malloc(strlen(hosts) + 1);
+    if (!p || !list) {
+        if (p && hosts[0] == '@') snprintf(err, errlen, "cannot read host list '%s'", hosts + 1);
+        else snprintf(err, errlen, "out of memory");
+        free(list);
+        free(p);
+        return NULL;
+    }
+    if (hosts[0] != '@') strcpy(list, hosts);
+    int ok = parse_hosts(p, list, err, errlen);
+    free(list);
+
+    if (ok && state_file) ok = load_state(p, state_file, err, errlen);
+    if (ok && state_file && !(p->state = fopen(state_file, "a"))) {
+        snprintf(err, errlen, "cannot write '%s'", state_file);
+        ok = 0;
+    }
+    if (!ok) {
+        free(p->entries);
+        free(p);
+        return NULL;
+    }
+#ifdef _WIN32
+    InitializeSRWLock(&p->lock);
+#else
+    pthread_mutex_init(&p->lock, NULL);
+#endif
+    return p;
+}
+
+void hostpool_close(hostpool *p) {
+    if (!p) return;
+    if (p->state) fclose(p->state);
+#ifndef _WIN32
+    pthread_mutex_destroy(&p->lock);
+#endif
+    free(p->entries);
+    free(p);
+}
+
+// ---------- assignment ----------
+// Least loaded relative to capacity, so hosts of different sizes fill up at
+// the same pace; ties go to the host listed first.
+static int pick_host(const hostpool *p) {
+    int best = -1;
+    for (size_t i = 0; i < p->nhosts; i++) {
+        const host *h = &p->hosts[i];
+        if (h->load >= h->capacity) continue;
+        if (best < 0 || (unsigned long long)h->load * p->hosts[best].capacity <
+                        (unsigned long long)p->hosts[best].load * h->capacity)
+            best = (int)i;
+    }
+    return best;
+}
+
+int hostpool_assign(hostpool *p, const hid_device_info *info, uint8_t mac6[6]) {
+    char key[KEY_MAX];
+    key_of(info, key);
+    lock_pool(p);
+    entry *e = find(p, key);
+    if (!e) {
+        int h = pick_host(p);
+        e = h < 0 ? NULL : add(p, key, h, 0);
+    }
+    if (e) memcpy(mac6, p->hosts[e->host].mac, 6);
+    unlock_pool(p);
+    return e != NULL;
+}
+
+void hostpool_commit(hostpool *p, const hid_device_info *info, int paired) {
+    char key[KEY_MAX], mac[18];
+    key_of(info, key);
+    lock_pool(p);
+    entry *e = find(p, key);
+    if (e && !e->saved) {
+        if (paired) {
+            e->saved = 1;
+            if (p->state) {
+                format_mac(p->hosts[e->host].mac, mac);
+                fprintf(p->state, "%s %s\n", mac, key);
+                fflush(p->state);
+            }
+        } else {
+            p->hosts[e->host].load--;
+            *e = p->entries[--p->n];
+        }
+    }
+    unlock_pool(p);
+}
+
+size_t hostpool_hosts(const hostpool *p) {
+    return p->nhosts;
+}
+
+void hostpool_host(const hostpool *p, size_t i, uint8_t mac6[6], unsigned *load, unsigned *capacity) {
+    memcpy(mac6, p->hosts[i].mac, 6);
+    if (load) *load = p->hosts[i].load;
+    if (capacity) *capacity = p->hosts[i].capacity;
+}
@@ -0,0 +1,42 @@
+// hostpool.h — spread controllers over several Bluetooth host adapters.
+//
+// An adapter holds only about seven controllers, so large batches are split
+// over a list of hosts. Each new controller goes to the least-loaded host
+// that still has room; the choice is appended to a state file and reused on
+// every later run, so rerunning a batch neither moves controllers nor
+// rewrites them (the compare-then-write path sees them unchanged).
+//
+// Controllers are identified by USB serial, else USB port, else device path.
+
+#ifndef HOSTPOOL_H
+#define HOSTPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hid_transport.h"
+
+#define HOSTPOOL_DEFAULT_CAPACITY 7
+#define HOSTPOOL_MAX_HOSTS        64
+
+typedef struct hostpool hostpool;
+
+// hosts: "aa:bb:cc:dd:ee:ff[=capacity],..." (commas or newlines), or
+// "@file" to read the same list from a file. state_file (may be NULL: nothing
+// persisted) is created if missing. Returns NULL with a reason in err.
+hostpool *hostpool_open(const char *hosts, const char *state_file, char *err, size_t errlen);
+void      hostpool_close(hostpool *p);
+
+// Host for a controller: the one recorded for it earlier if that host is
+// still listed, else the least-loaded host with room (reserved until
+// hostpool_commit). Returns 0 when every host is full.
+int  hostpool_assign(hostpool *p, const hid_device_info *info, uint8_t mac6[6]);
+// Outcome of the pairing that followed hostpool_assign: a paired controller
+// is persisted, a failed new one gives its slot back.
+void hostpool_commit(hostpool *p, const hid_device_info *info, int paired);
+
+size_t hostpool_hosts(const hostpool *p);
+// Host i with its current load (committed + reserved) and capacity.
+void   hostpool_host(const hostpool *p, size_t i, uint8_t mac6[6], unsigned *load, unsigned *capacity);
+
+#endif // HOSTPOOL_H
@@ -0,0 +1,28 @@
+// hotplug.c — event replay shared by both platforms; see hotplug.h.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hid_transport.h"
+#include "hotplug.h"
+#include "sixaxis_stats.h"
+
+int hotplug_replay(const char *file, hotplug_cb cb, void *user, char *err, size_t errlen) {
+    FILE *f = strcmp(file, "-") == 0 ? stdin : fopen(file, "r");
+    if (!f) {
+        snprintf(err, errlen, "cannot open event file '%s'", file);
+        return 0;
+    }
+
+    char line[HID_PATH_MAX + 32];
+    while (fgets(line, sizeof(line), f)) {
+        uint64_t arrived = sixaxis_clock_ns();
+        line[strcspn(line, "\r\n")] = 0;
+        if (strncmp(line, "add ", 4) != 0) continue;
+        const char *path = line + 4;
+        while (*path == ' ') path++;
+        if (*path && cb(path, arrived, user)) break;
+    }
+    if (f != stdin) fclose(f);
+    return 1;
+}
@@ -0,0 +1,29 @@
+// hotplug.h — HID interface arrival events for the resident pairing mode.
+//
+// The native source is the kernel uevent netlink socket on Linux
+// (hotplug_linux.c) and CM_Register_Notification on Windows (hotplug_win.c).
+// hotplug_replay() delivers the same events from a text file, so the daemon
+// can be driven by a recorded or hand-written stream instead of real devices.
+
+#ifndef HOTPLUG_H
+#define HOTPLUG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Called once per arriving HID interface with a path hid_transport can open
+// and the sixaxis_clock_ns() time the event came in, before any wait for the
+// device node; return nonzero to stop listening.
+typedef int (*hotplug_cb)(const char *path, uint64_t arrived_ns, void *user);
+
+// Blocks and reports arrivals until cb returns nonzero. Returns 1 when
+// stopped by cb, 0 if the event source failed (reason in err).
+int hotplug_run(hotplug_cb cb, void *user, char *err, size_t errlen);
+
+// Reads one event per line from file ("-" = stdin):
+//   add <path>       arrival, e.g. "add /dev/hidraw3" or "add mock://2"
+//   remove <path>    ignored, like other actions, blank lines and # comments
+// Returns 1 at end of file or when cb stops, 0 if the file cannot be read.
+int hotplug_replay(const char *file, hotplug_cb cb, void *user, char *err, size_t errlen);
+
+#endif // HOTPLUG_H
@@ -0,0 +1,70 @@
+// hotplug_linux.c — hidraw arrivals from the kernel uevent netlink socket.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "hid_transport.h"
+#include "hotplug.h"
+#include "sixaxis_stats.h"
+
+#define NODE_WAIT_MS 1000
+
+// The kernel announces hidrawN before udev has created /dev/hidrawN and
+// applied its permissions; give udev a moment rather than failing the open.
+static void wait_for_node(const char *path) {
+    struct timespec step = { 0, 10 * 1000000L };
+    for (int waited = 0; waited < NODE_WAIT_MS && access(path, R_OK | W_OK) != 0; waited += 10)
+        nanosleep(&step, NULL);
+}
+
+int hotplug_run(hotplug_cb cb, void *user, char *err, size_t errlen) {
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) {
+        snprintf(err, errlen, "netlink socket failed (err=%d)", errno);
+        return 0;
+    }
+    struct sockaddr_nl sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = 1; // kernel uevents (udev re-broadcasts on group 2 in its own format)
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        snprintf(err, errlen, "netlink bind failed (err=%d)", errno);
+        close(fd);
+        return 0;
+    }
+
+    // "add@/devices/...\0ACTION=add\0DEVPATH=...\0SUBSYSTEM=hidraw\0DEVNAME=hidraw3\0..."
+    char msg[8192];
+    for (;;) {
+        ssize_t n = recv(fd, msg, sizeof(msg) - 1, 0);
+        uint64_t arrived = sixaxis_clock_ns();
+        if (n < 0) {
+            if (errno == EINTR || errno == ENOBUFS) continue; // ENOBUFS: burst overflowed the queue
+            snprintf(err, errlen, "netlink recv failed (err=%d)", errno);
+            close(fd);
+            return 0;
+        }
+        msg[n] = 0;
+
+        const char *action = NULL, *subsystem = NULL, *devname = NULL;
+        for (char *p = msg; p < msg + n; p += strlen(p) + 1) {
+            if      (strncmp(p, "ACTION=", 7) == 0)    action = p + 7;
+            else if (strncmp(p, "SUBSYSTEM=", 10) == 0) subsystem = p + 10;
+            else if (strncmp(p, "DEVNAME=", 8) == 0)   devname = p + 8;
+        }
+        if (!action || !subsystem || !devname) continue;
+        if (strcmp(action, "add") != 0 || strcmp(subsystem, "hidraw") != 0) continue;
+
+        char path[HID_PATH_MAX];
+        snprintf(path, sizeof(path), "/dev/%s", devname);
+        wait_for_node(path);
+        if (cb(path, arrived, user)) break;
+    }
+    close(fd);
+    return 1;
+}
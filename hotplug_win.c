@@ -0,0 +1,109 @@
+// hotplug_win.c — HID interface arrivals from CM_Register_Notification.
+
+#ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <cfgmgr32.h>
+#include <hidsdi.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hid_transport.h"
+#include "hotplug.h"
+#include "sixaxis_stats.h"
+
+#ifdef _MSC_VER
+#  pragma comment(lib, "cfgmgr32.lib")
+#endif
+
+#define QUEUE_LEN 64
+
+// The notification callback runs on a thread-pool thread and must return
+// quickly, so it only queues the path; pairing happens on the caller's thread.
+typedef struct {
+    CRITICAL_SECTION lock;
+    HANDLE           ready;  // auto-reset, set when the queue becomes non-empty
+    char             paths[QUEUE_LEN][HID_PATH_MAX];
+    uint64_t         arrived[QUEUE_LEN]; // sixaxis_clock_ns() in on_notify
+    unsigned         head, count;
+    unsigned long    dropped;
+} arrival_queue;
+
+static DWORD CALLBACK on_notify(HCMNOTIFICATION hn, PVOID ctx, CM_NOTIFY_ACTION action,
+                                PCM_NOTIFY_EVENT_DATA data, DWORD size) {
+    arrival_queue *q = (arrival_queue *)ctx;
+    (void)hn; (void)size;
+    if (action != CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL) return ERROR_SUCCESS;
+    uint64_t arrived = sixaxis_clock_ns();
+
+    EnterCriticalSection(&q->lock);
+    if (q->count == QUEUE_LEN) {
+        q->dropped++;
+    } else {
+        unsigned i = (q->head + q->count) % QUEUE_LEN;
+        if (WideCharToMultiByte(CP_UTF8, 0, data->u.DeviceInterface.SymbolicLink, -1,
+                                q->paths[i], HID_PATH_MAX, NULL, NULL) > 0) {
+            q->arrived[i] = arrived;
+            q->count++;
+        }
+    }
+    LeaveCriticalSection(&q->lock);
+    SetEvent(q->ready);
+    return ERROR_SUCCESS;
+}
+
+static int pop(arrival_queue *q, char *path, uint64_t *arrived) {
+    int ok = 0;
+    EnterCriticalSection(&q->lock);
+    if (q->dropped) {
+        fprintf(stderr, "hotplug: %lu arrivals dropped (queue full)\n", q->dropped);
+        q->dropped = 0;
+    }
+    if (q->count) {
+        lstrcpynA(path, q->paths[q->head], HID_PATH_MAX);
+        *arrived = q->arrived[q->head];
+        q->head = (q->head + 1) % QUEUE_LEN;
+        q->count--;
+        ok = 1;
+    }
+    LeaveCriticalSection(&q->lock);
+    return ok;
+}
+
+int hotplug_run(hotplug_cb cb, void *user, char *err, size_t errlen) {
+    static arrival_queue q; // too large for the stack
+    InitializeCriticalSection(&q.lock);
+    q.ready = CreateEventA(NULL, FALSE, FALSE, NULL);
+    if (!q.ready) {
+        snprintf(err, errlen, "CreateEvent failed (err=%lu)", GetLastError());
+        DeleteCriticalSection(&q.lock);
+        return 0;
+    }
+
+    CM_NOTIFY_FILTER f;
+    HCMNOTIFICATION hn = NULL;
+    memset(&f, 0, sizeof(f));
+    f.cbSize = sizeof(f);
+    f.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+    HidD_GetHidGuid(&f.u.DeviceInterface.ClassGuid);
+    CONFIGRET cr = CM_Register_Notification(&f, &q, on_notify, &hn);
+    if (cr != CR_SUCCESS) {
+        snprintf(err, errlen, "CM_Register_Notification failed (cr=%lu)", (unsigned long)cr);
+        CloseHandle(q.ready);
+        DeleteCriticalSection(&q.lock);
+        return 0;
+    }
+
+    char path[HID_PATH_MAX];
+    uint64_t arrived;
+    int stop = 0;
+    while (!stop && WaitForSingleObject(q.ready, INFINITE) == WAIT_OBJECT_0) {
+        while (!stop && pop(&q, path, &arrived)) stop = cb(path, arrived, user);
+    }
+
+    CM_Unregister_Notification(hn);
+    CloseHandle(q.ready);
+    DeleteCriticalSection(&q.lock);
+    return 1;
+}
@@ -0,0 +1,165 @@
+// hubsched.c — see hubsched.h.
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+#include "hubsched.h"
+
+typedef struct {
+    char     key[HID_PORT_MAX];
+    unsigned busy;     // transfers in flight
+    unsigned devices;
+    unsigned limit;    // transfers allowed at once, 1..per_hub
+    unsigned streak;   // successes since the last change of limit
+} hub;
+
+// One lock for all hubs: a transfer takes milliseconds, the bookkeeping a
+// few instructions.
+struct hubsched {
+    hub     *hubs;
+    size_t   n, cap;
+    unsigned per_hub;
+#ifdef _WIN32
+    SRWLOCK            lock;
+    CONDITION_VARIABLE freed;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t  freed;
+#endif
+};
+
+hubsched *hubsched_new(unsigned per_hub) {
+    hubsched *h = (hubsched *)calloc(1, sizeof(*h));
+    if (!h) return NULL;
+    h->per_hub = per_hub ? per_hub : 1;
+#ifdef _WIN32
+    InitializeSRWLock(&h->lock);
+    InitializeConditionVariable(&h->freed);
+#else
+    pthread_mutex_init(&h->lock, NULL);
+    pthread_cond_init(&h->freed, NULL);
+#endif
+    return h;
+}
+
+void hubsched_free(hubsched *h) {
+    if (!h) return;
+#ifndef _WIN32
+    pthread_cond_destroy(&h->freed);
+    pthread_mutex_destroy(&h->lock);
+#endif
+    free(h->hubs);
+    free(h);
+}
+
+// "Port_#0002.Hub_#0001" -> "Hub_#0001"; "1-1.2" -> "1-1"; "1-3" -> "1".
+int hubsched_key(const char *port, char key[HID_PORT_MAX]) {
+    const char *win = strstr(port, "Hub_#");
+    size_t n;
+    if (win) {
+        port = win;
+        n = strcspn(port, ".");
+    } else {
+        const char *cut = strrchr(port, '.');
+        if (!cut) cut = strrchr(port, '-');
+        if (!cut) return 0;
+        n = (size_t)(cut - port);
+    }
+    if (n == 0 || n >= HID_PORT_MAX) return 0;
+    memcpy(key, port, n);
+    key[n] = 0;
+    return 1;
+}
+
+int hubsched_add(hubsched *h, const char *port) {
+    char key[HID_PORT_MAX];
+    if (!port || !hubsched_key(port, key)) return -1;
+    for (size_t i = 0; i < h->n; i++) {
+        if (strcmp(h->hubs[i].key, key) != 0) continue;
+        h->hubs[i].devices++;
+        return (int)i;
+    }
+    if (h->n == h->cap) {
+        size_t cap = h->cap ? h->cap * 2 : 8;
+        hub *hubs = (hub *)realloc(h->hubs, cap * sizeof(*hubs));
+        if (!hubs) return -1;
+        h->hubs = hubs;
+        h->cap = cap;
+    }
+    hub *b = &h->hubs[h->n];
+    memset(b, 0, sizeof(*b));
+    memcpy(b->key, key, sizeof(key));
+    b->devices = 1;
+    b->limit = h->per_hub;
+    return (int)h->n++;
+}
+
+unsigned hubsched_devices(const hubsched *h, int hub) {
+    return hub >= 0 && (size_t)hub < h->n ? h->hubs[hub].devices : 0;
+}
+
+size_t hubsched_hubs(const hubsched *h) {
+    return h->n;
+}
+
+unsigned hubsched_limit(const hubsched *h, int hub) {
+    return hub >= 0 && (size_t)hub < h->n ? h->hubs[hub].limit : 0;
+}
+
+// Caller holds the lock; beside is what ran when the transfer started.
+static void adapt(hubsched *h, hub *b, unsigned beside, int congested) {
+    if (congested) {
+        // The hub could not carry this one next to the others. One that
+        // started under an older, higher limit is already accounted for.
+        unsigned fit = beside ? beside : 1;
+        if (fit < b->limit) b->limit = fit;
+        b->streak = 0;
+    } else if (b->limit < h->per_hub && ++b->streak >= HUBSCHED_RAISE_AFTER) {
+        b->limit++;
+        b->streak = 0;
+    }
+}
+
+unsigned hubsched_enter(hubsched *h, int hub) {
+    if (hub < 0) return 0;
+    unsigned beside;
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&h->lock);
+    while (h->hubs[hub].busy >= h->hubs[hub].limit)
+        SleepConditionVariableSRW(&h->freed, &h->lock, INFINITE, 0);
+    beside = h->hubs[hub].busy++;
+    ReleaseSRWLockExclusive(&h->lock);
+#else
+    pthread_mutex_lock(&h->lock);
+    while (h->hubs[hub].busy >= h->hubs[hub].limit) pthread_cond_wait(&h->freed, &h->lock);
+    beside = h->hubs[hub].busy++;
+    pthread_mutex_unlock(&h->lock);
+#endif
+    return beside;
+}
+
+// Waiters of every hub share one condition, so all of them are woken.
+void hubsched_leave(hubsched *h, int hub, unsigned beside, int congested) {
+    if (hub < 0) return;
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&h->lock);
+    h->hubs[hub].busy--;
+    adapt(h, &h->hubs[hub], beside, congested);
+    ReleaseSRWLockExclusive(&h->lock);
+    WakeAllConditionVariable(&h->freed);
+#else
+    pthread_mutex_lock(&h->lock);
+    h->hubs[hub].busy--;
+    adapt(h, &h->hubs[hub], beside, congested);
+    pthread_mutex_unlock(&h->lock);
+    pthread_cond_broadcast(&h->freed);
+#endif
+}
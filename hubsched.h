@@ -0,0 +1,58 @@
+// hubsched.h — cap on feature transfers in flight per USB hub.
+//
+// Controllers are full-speed devices: behind one hub they share its
+// transaction translator and upstream port, so a station that sends feature
+// reports to every controller at once mostly queues them there and collects
+// timeouts. The batch API therefore lets only a few transfers per hub run at
+// a time while other hubs go on in parallel.
+//
+// How many a hub carries depends on the hub (single or multi TT, what else
+// hangs off it), so the cap is found per hub at run time: every hub starts at
+// per_hub, a congested transfer (timed out or refused busy) lowers its limit
+// to the transfers that were running beside it when it started (at least
+// one), and HUBSCHED_RAISE_AFTER uncongested transfers in a row raise it by
+// one again, up to per_hub.
+// A device's own errors say nothing about the hub and leave the limit alone,
+// so one broken controller does not serialize its neighbours.
+//
+// The hub is read from hid_device_info.port: "1-1.2" (sysfs) is port 2 of
+// hub "1-1", "1-3" port 3 of the root hub of bus 1, and on Windows
+// "Port_#0002.Hub_#0001" (the location of the controller's USB device node,
+// found from the interface through its parent device instances) names hub
+// "Hub_#0001". Interfaces without a port (Bluetooth) are not limited.
+
+#ifndef HUBSCHED_H
+#define HUBSCHED_H
+
+#include <stddef.h>
+
+#include "hid_transport.h"
+
+#define HUBSCHED_RAISE_AFTER 32
+
+typedef struct hubsched hubsched;
+
+// per_hub: most transfers in flight per hub, at least 1; every hub starts
+// there. NULL when out of memory.
+hubsched *hubsched_new(unsigned per_hub);
+void      hubsched_free(hubsched *h);
+
+// Hub part of a port string into key; 0 when the port names none.
+int      hubsched_key(const char *port, char key[HID_PORT_MAX]);
+// Registers a device on port and returns its hub, or -1 when the port names
+// none. Not thread-safe: add every device before the workers start.
+int      hubsched_add(hubsched *h, const char *port);
+// Devices added on hub so far.
+unsigned hubsched_devices(const hubsched *h, int hub);
+size_t   hubsched_hubs(const hubsched *h);
+
+// Around each transfer: enter waits while the hub's current limit of
+// transfers is running and returns how many were running beside it; leave
+// passes that back with whether the transfer was congested (HID_ERR_TIMEOUT
+// or HID_ERR_BUSY) and adapts the limit. hub -1 never waits.
+unsigned hubsched_enter(hubsched *h, int hub);
+void     hubsched_leave(hubsched *h, int hub, unsigned beside, int congested);
+// Current limit of hub.
+unsigned hubsched_limit(const hubsched *h, int hub);
+
+#endif // HUBSCHED_H
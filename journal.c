@@ -0,0 +1,489 @@
+// journal.c — see journal.h.
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <pthread.h>
+#  include <time.h>
+#  include <unistd.h>
+#  include <sys/file.h>
+#  include <sys/stat.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "journal.h"
+
+#define HEADER_SIZE 16
+#define VERSION     1
+#define PENDING_MAX (JOURNAL_BATCH * 4) // appends wait for the writer beyond this
+
+// ---------- encoding ----------
+static void put16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put32(uint8_t *p, uint32_t v) { put16(p, (uint16_t)v); put16(p + 2, (uint16_t)(v >> 16)); }
+static void put64(uint8_t *p, uint64_t v) { put32(p, (uint32_t)v); put32(p + 4, (uint32_t)(v >> 32)); }
+static uint16_t get16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t get32(const uint8_t *p) { return get16(p) | (uint32_t)get16(p + 2) << 16; }
+static uint64_t get64(const uint8_t *p) { return get32(p) | (uint64_t)get32(p + 4) << 32; }
+
+// CRC-32 (IEEE), a nibble at a time.
+static uint32_t crc32(const uint8_t *p, size_t n) {
+    static const uint32_t t[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    uint32_t c = 0xFFFFFFFFu;
+    while (n--) {
+        c ^= *p++;
+        c = (c >> 4) ^ t[c & 15];
+        c = (c >> 4) ^ t[c & 15];
+    }
+    return ~c;
+}
+
+static void encode(uint8_t *b, const journal_record *r) {
+    memset(b, 0, JOURNAL_RECORD_SIZE);
+    put32(b + 4, r->latency_us);
+    put64(b + 8, r->time_us);
+    put16(b + 16, r->vid);
+    put16(b + 18, r->pid);
+    b[20] = r->op;
+    b[21] = r->result;
+    b[22] = r->flags;
+    memcpy(b + 24, r->old_mac, 6);
+    memcpy(b + 30, r->new_mac, 6);
+    memcpy(b + 36, r->serial, sizeof(r->serial));
+    memcpy(b + 96, r->path, sizeof(r->path));
+    put32(b, crc32(b + 4, JOURNAL_RECORD_SIZE - 4));
+}
+
+static int decode(const uint8_t *b, journal_record *r) {
+    if (get32(b) != crc32(b + 4, JOURNAL_RECORD_SIZE - 4)) return 0;
+    r->latency_us = get32(b + 4);
+    r->time_us = get64(b + 8);
+    r->vid = get16(b + 16);
+    r->pid = get16(b + 18);
+    r->op = b[20];
+    r->result = b[21];
+    r->flags = b[22];
+    memcpy(r->old_mac, b + 24, 6);
+    memcpy(r->new_mac, b + 30, 6);
+    memcpy(r->serial, b + 36, sizeof(r->serial));
+    memcpy(r->path, b + 96, sizeof(r->path));
+    r->serial[sizeof(r->serial) - 1] = 0;
+    r->path[sizeof(r->path) - 1] = 0;
+    return 1;
+}
+
+static void make_header(uint8_t h[HEADER_SIZE]) {
+    memset(h, 0, HEADER_SIZE);
+    memcpy(h, "SXJ1", 4);
+    put32(h + 4, VERSION);
+    put32(h + 8, JOURNAL_RECORD_SIZE);
+}
+
+// ---------- file ----------
+// Several processes may share one journal (the GUI and CLI runs default to
+// the same per-user file). Each opens it shared; a repair at open and every
+// commit's append run under an exclusive lock, so batches from different
+// processes land whole, one after the other. On Windows the lock is one
+// byte far past any real end, so it never blocks readers.
+#ifdef _WIN32
+typedef HANDLE file_t;
+#define NO_FILE INVALID_HANDLE_VALUE
+
+static file_t file_open(const char *path) {
+    return CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                       OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+}
+static void lock_region(OVERLAPPED *ol) {
+    memset(ol, 0, sizeof(*ol));
+    ol->Offset = 0xFFFFFFFFu;
+    ol->OffsetHigh = 0x7FFFFFFFu;
+}
+static int file_lock(file_t f) {
+    OVERLAPPED ol;
+    lock_region(&ol);
+    return LockFileEx(f, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ol) != 0;
+}
+static void file_unlock(file_t f) {
+    OVERLAPPED ol;
+    lock_region(&ol);
+    UnlockFileEx(f, 0, 1, 0, &ol);
+}
+static void file_close(file_t f) { CloseHandle(f); }
+static long long file_size(file_t f) {
+    LARGE_INTEGER n;
+    return GetFileSizeEx(f, &n) ? n.QuadPart : -1;
+}
+static int file_read_at(file_t f, long long off, void *buf, size_t len) {
+    OVERLAPPED ol;
+    DWORD got = 0;
+    memset(&ol, 0, sizeof(ol));
+    ol.Offset = (DWORD)off;
+    ol.OffsetHigh = (DWORD)(off >> 32);
+    return ReadFile(f, buf, (DWORD)len, &got, &ol) && got == len;
+}
+static int file_truncate(file_t f, long long size) {
+    LARGE_INTEGER n;
+    n.QuadPart = size;
+    return SetFilePointerEx(f, n, NULL, FILE_BEGIN) && SetEndOfFile(f);
+}
+static int file_append(file_t f, const void *buf, size_t len) {
+    LARGE_INTEGER zero;
+    DWORD put = 0;
+    zero.QuadPart = 0;
+    return SetFilePointerEx(f, zero, NULL, FILE_END) && WriteFile(f, buf, (DWORD)len, &put, NULL) && put == len;
+}
+static int file_sync(file_t f) { return FlushFileBuffers(f) != 0; }
+#else
+typedef int file_t;
+#define NO_FILE (-1)
+
+static file_t file_open(const char *path) {
+    return open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+}
+// flock, not fcntl: fcntl locks drop when any fd of the file closes, and
+// journal_read opens the same file in this process.
+static int file_lock(file_t f) {
+    int rc;
+    while ((rc = flock(f, LOCK_EX)) != 0 && errno == EINTR) {}
+    return rc == 0;
+}
+static void file_unlock(file_t f) { flock(f, LOCK_UN); }
+static void file_close(file_t f) { close(f); }
+static long long file_size(file_t f) {
+    struct stat st;
+    return fstat(f, &st) == 0 ? (long long)st.st_size : -1;
+}
+static int file_read_at(file_t f, long long off, void *buf, size_t len) {
+    return pread(f, buf, len, (off_t)off) == (ssize_t)len;
+}
+static int file_truncate(file_t f, long long size) {
+    return ftruncate(f, (off_t)size) == 0;
+}
+static int file_append(file_t f, const void *buf, size_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    while (len) {
+        ssize_t n = write(f, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+static int file_sync(file_t f) { return fdatasync(f) == 0; }
+#endif
+
+// New file: write the header. Existing one: check it and cut a torn tail
+// (a partial record, or whole-size ones whose CRC fails) back off. Caller
+// holds the file lock.
+static int prepare_locked(file_t f, const char *path, char *err, size_t errlen) {
+    uint8_t h[HEADER_SIZE], want[HEADER_SIZE], rec[JOURNAL_RECORD_SIZE];
+    make_header(want);
+    long long size = file_size(f);
+    if (size < HEADER_SIZE) {
+        if (!file_truncate(f, 0) || !file_append(f, want, HEADER_SIZE) || !file_sync(f)) {
+            snprintf(err, errlen, "cannot write journal '%s'", path);
+            return 0;
+        }
+        return 1;
+    }
+    if (!file_read_at(f, 0, h, HEADER_SIZE) || memcmp(h, want, HEADER_SIZE) != 0) {
+        snprintf(err, errlen, "'%s' is not a pairing journal", path);
+        return 0;
+    }
+    long long end = HEADER_SIZE + (size - HEADER_SIZE) / JOURNAL_RECORD_SIZE * JOURNAL_RECORD_SIZE;
+    journal_record r;
+    while (end > HEADER_SIZE && !(file_read_at(f, end - JOURNAL_RECORD_SIZE, rec, sizeof(rec)) && decode(rec, &r)))
+        end -= JOURNAL_RECORD_SIZE;
+    if (end != size && !file_truncate(f, end)) {
+        snprintf(err, errlen, "cannot repair journal '%s'", path);
+        return 0;
+    }
+    return 1;
+}
+
+static int prepare(file_t f, const char *path, char *err, size_t errlen) {
+    if (!file_lock(f)) {
+        snprintf(err, errlen, "cannot lock journal '%s'", path);
+        return 0;
+    }
+    int ok = prepare_locked(f, path, err, errlen);
+    file_unlock(f);
+    return ok;
+}
+
+// ---------- writer ----------
+struct journal {
+    file_t    f;
+    uint8_t  *pending, *writing;  // PENDING_MAX records each, swapped per commit
+    size_t    npending;
+    uint64_t  appended, committed;
+    int       syncing;            // journal_sync callers waiting
+    int       stop, io_error;
+#ifdef _WIN32
+    SRWLOCK            lock;
+    CONDITION_VARIABLE work, done;
+    HANDLE             thread;
+#else
+    pthread_mutex_t    lock;
+    pthread_cond_t     work, done;
+    pthread_t          thread;
+#endif
+};
+
+#ifdef _WIN32
+static void lock_j(journal *j)   { AcquireSRWLockExclusive(&j->lock); }
+static void unlock_j(journal *j) { ReleaseSRWLockExclusive(&j->lock); }
+static void wait_work(journal *j, unsigned ms) {
+    SleepConditionVariableSRW(&j->work, &j->lock, ms ? ms : INFINITE, 0);
+}
+static void wait_done(journal *j) { SleepConditionVariableSRW(&j->done, &j->lock, INFINITE, 0); }
+static void wake_work(journal *j) { WakeConditionVariable(&j->work); }
+static void wake_done(journal *j) { WakeAllConditionVariable(&j->done); }
+#else
+static void lock_j(journal *j)   { pthread_mutex_lock(&j->lock); }
+static void unlock_j(journal *j) { pthread_mutex_unlock(&j->lock); }
+static void wait_work(journal *j, unsigned ms) {
+    if (!ms) { pthread_cond_wait(&j->work, &j->lock); return; }
+    struct timespec until;
+    clock_gettime(CLOCK_MONOTONIC, &until); // work is a CLOCK_MONOTONIC condvar
+    until.tv_nsec += (long)ms * 1000000L;
+    while (until.tv_nsec >= 1000000000L) { until.tv_sec++; until.tv_nsec -= 1000000000L; }
+    pthread_cond_timedwait(&j->work, &j->lock, &until);
+}
+static void wait_done(journal *j) { pthread_cond_wait(&j->done, &j->lock); }
+static void wake_work(journal *j) { pthread_cond_signal(&j->work); }
+static void wake_done(journal *j) { pthread_cond_broadcast(&j->done); }
+#endif
+
+// Sleeps until something is pending, gives it JOURNAL_COMMIT_MS to collect
+// company (unless a batch is full, a sync waits or the journal closes), then
+// writes and fsyncs the lot outside the lock.
+static void writer(journal *j) {
+    lock_j(j);
+    for (;;) {
+        while (!j->npending && !j->stop) wait_work(j, 0);
+        if (!j->npending) break;
+        if (!j->stop && !j->syncing && j->npending < JOURNAL_BATCH) wait_work(j, JOURNAL_COMMIT_MS);
+
+        uint8_t *buf = j->pending;
+        size_t n = j->npending;
+        uint64_t upto = j->appended;
+        j->pending = j->writing;
+        j->writing = buf;
+        j->npending = 0;
+        wake_done(j); // room again for blocked appends
+        unlock_j(j);
+
+        int ok = file_lock(j->f);
+        if (ok) {
+            ok = file_append(j->f, buf, n * JOURNAL_RECORD_SIZE);
+            file_unlock(j->f);
+        }
+        ok = ok && file_sync(j->f);
+
+        lock_j(j);
+        if (!ok) j->io_error = 1;
+        j->committed = upto;
+        wake_done(j);
+    }
+    unlock_j(j);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI writer_main(LPVOID p) { writer((journal *)p); return 0; }
+#else
+static void *writer_main(void *p) { writer((journal *)p); return NULL; }
+#endif
+
+journal *journal_open(const char *file, char *err, size_t errlen) {
+    journal *j = (journal *)calloc(1, sizeof(*j));
+    if (!j) {
+        snprintf(err, errlen, "out of memory");
+        return NULL;
+    }
+    j->pending = (uint8_t *)malloc((size_t)PENDING_MAX * JOURNAL_RECORD_SIZE);
+    j->writing = (uint8_t *)malloc((size_t)PENDING_MAX * JOURNAL_RECORD_SIZE);
+    j->f = file_open(file);
+    if (j->f == NO_FILE) snprintf(err, errlen, "cannot open journal '%s'", file);
+    else if (!j->pending || !j->writing) snprintf(err, errlen, "out of memory");
+    if (j->f == NO_FILE || !j->pending || !j->writing || !prepare(j->f, file, err, errlen)) {
+        if (j->f != NO_FILE) file_close(j->f);
+        free(j->pending);
+        free(j->writing);
+        free(j);
+        return NULL;
+    }
+
+#ifdef _WIN32
+    InitializeSRWLock(&j->lock);
+    InitializeConditionVariable(&j->work);
+    InitializeConditionVariable(&j->done);
+    j->thread = CreateThread(NULL, 0, writer_main, j, 0, NULL);
+    int started = j->thread != NULL;
+#else
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_mutex_init(&j->lock, NULL);
+    pthread_cond_init(&j->work, &ca);
+    pthread_condattr_destroy(&ca);
+    pthread_cond_init(&j->done, NULL);
+    int started = pthread_create(&j->thread, NULL, writer_main, j) == 0;
+#endif
+    if (!started) {
+        snprintf(err, errlen, "cannot start journal writer");
+        j->stop = 1;
+        journal_close(j);
+        return NULL;
+    }
+    return j;
+}
+
+void journal_close(journal *j) {
+    if (!j) return;
+    lock_j(j);
+    int running = !j->stop;
+    j->stop = 1;
+    wake_work(j);
+    unlock_j(j);
+    if (running) {
+#ifdef _WIN32
+        WaitForSingleObject(j->thread, INFINITE);
+        CloseHandle(j->thread);
+#else
+        pthread_join(j->thread, NULL);
+#endif
+    }
+#ifndef _WIN32
+    pthread_cond_destroy(&j->done);
+    pthread_cond_destroy(&j->work);
+    pthread_mutex_destroy(&j->lock);
+#endif
+    file_close(j->f);
+    free(j->pending);
+    free(j->writing);
+    free(j);
+}
+
+void journal_append(journal *j, const journal_record *r) {
+    lock_j(j);
+    while (j->npending == PENDING_MAX) wait_done(j);
+    encode(j->pending + j->npending * JOURNAL_RECORD_SIZE, r);
+    j->npending++;
+    j->appended++;
+    if (j->npending == 1 || j->npending == JOURNAL_BATCH) wake_work(j);
+    unlock_j(j);
+}
+
+int journal_sync(journal *j) {
+    lock_j(j);
+    uint64_t upto = j->appended;
+    j->syncing++;
+    wake_work(j);
+    while (j->committed < upto) wait_done(j);
+    j->syncing--;
+    int ok = !j->io_error;
+    unlock_j(j);
+    return ok;
+}
+
+// ---------- records ----------
+uint64_t journal_now_us(void) {
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    uint64_t t = (uint64_t)ft.dwHighDateTime << 32 | ft.dwLowDateTime;
+    return (t - 116444736000000000ull) / 10; // 100 ns since 1601 -> us since 1970
+#else
+    // Wall clock on purpose: records carry UTC time (journal.h), not intervals.
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+#endif
+}
+
+static void copy_field(char *dst, size_t n, const char *src) {
+    memset(dst, 0, n);
+    size_t len = strlen(src);
+    memcpy(dst, src, len < n - 1 ? len : n - 1);
+}
+
+void journal_record_device(journal_record *r, const sixaxis_device *dev, int set) {
+    memset(r, 0, sizeof(*r));
+    r->time_us = journal_now_us();
+    r->latency_us = dev->latency_us;
+    r->vid = dev->info.vid;
+    r->pid = dev->info.pid;
+    r->op = set ? JOURNAL_OP_SET : JOURNAL_OP_READ;
+    r->result = (uint8_t)dev->result;
+    if (dev->has_old_mac) {
+        r->flags |= JOURNAL_F_OLD_MAC;
+        memcpy(r->old_mac, dev->old_mac, 6);
+    }
+    memcpy(r->new_mac, dev->mac, 6);
+    copy_field(r->serial, sizeof(r->serial), dev->info.serial);
+    copy_field(r->path, sizeof(r->path), dev->info.path);
+}
+
+// ---------- reading ----------
+long journal_read(const char *file, journal_cb cb, void *user, int *torn, char *err, size_t errlen) {
+    uint8_t h[HEADER_SIZE], want[HEADER_SIZE], rec[JOURNAL_RECORD_SIZE];
+    FILE *f = fopen(file, "rb");
+    if (torn) *torn = 0;
+    if (!f) {
+        snprintf(err, errlen, "cannot open journal '%s'", file);
+        return -1;
+    }
+    make_header(want);
+    if (fread(h, 1, HEADER_SIZE, f) != HEADER_SIZE || memcmp(h, want, HEADER_SIZE) != 0) {
+        fclose(f);
+        snprintf(err, errlen, "'%s' is not a pairing journal", file);
+        return -1;
+    }
+    long n = 0;
+    size_t got;
+    journal_record r;
+    while ((got = fread(rec, 1, sizeof(rec), f)) > 0) {
+        if (got != sizeof(rec) || !decode(rec, &r)) {
+            if (torn) *torn = 1;
+            break;
+        }
+        n++;
+        if (cb(&r, user)) break;
+    }
+    fclose(f);
+    return n;
+}
+
+static int csv_row(const journal_record *r, void *user) {
+    FILE *out = (FILE *)user;
+    char when[32], old_mac[18] = "", new_mac[18];
+    time_t secs = (time_t)(r->time_us / 1000000u);
+    struct tm *tm = gmtime(&secs);
+    size_t k = tm ? strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", tm) : 0;
+    snprintf(when + k, sizeof(when) - k, ".%03uZ", (unsigned)(r->time_us / 1000u % 1000u));
+    if (r->flags & JOURNAL_F_OLD_MAC) format_mac(r->old_mac, old_mac);
+    format_mac(r->new_mac, new_mac);
+    fprintf(out, "%s,%s,%04x,%04x,%s,%s,%s,%s,%s,%.3f\n", when, r->path, r->vid, r->pid, r->serial,
+            r->op == JOURNAL_OP_SET ? "set" : "read", old_mac, new_mac,
+            sixaxis_set_result_name((sixaxis_set_result)r->result), r->latency_us / 1000.0);
+    return 0;
+}
+
+long journal_export_csv(const char *file, FILE *out, char *err, size_t errlen) {
+    fprintf(out, "time,path,vid,pid,serial,op,old_mac,new_mac,result,latency_ms\n");
+    int torn = 0;
+    long n = journal_read(file, csv_row, out, &torn, err, errlen);
+    if (n >= 0 && torn) snprintf(err, errlen, "'%s': stopped at a torn record after %ld", file, n);
+    return n;
+}
@@ -0,0 +1,74 @@
+// journal.h — append-only binary audit trail of pairings.
+//
+// File layout, all integers little-endian:
+//   header  16 bytes: "SXJ1", u32 version (1), u32 record size (320), u32 0
+//   records 320 bytes each:
+//     0  u32 CRC-32 of bytes 4..319     24  old MAC[6], 30 new MAC[6]
+//     4  u32 latency (us)               36  serial, NUL-padded [60]
+//     8  u64 time (us since 1970 UTC)   96  path, NUL-padded [224]
+//    16  u16 vid, 18 u16 pid
+//    20  u8 op, 21 u8 result (sixaxis_set_result), 22 u8 flags, 23 u8 0
+//
+// Appends only copy the record into memory; a writer thread group-commits
+// whatever is pending with one write and one fsync every JOURNAL_COMMIT_MS
+// (sooner once JOURNAL_BATCH records wait). A crash loses at most the last
+// commit window, and a record torn by it fails its CRC: readers stop there
+// and the next journal_open cuts the file back to the last whole record.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sixaxis_pair.h"
+
+#define JOURNAL_RECORD_SIZE 320
+#define JOURNAL_COMMIT_MS   50
+#define JOURNAL_BATCH       512
+
+#define JOURNAL_OP_READ 0
+#define JOURNAL_OP_SET  1
+
+#define JOURNAL_F_OLD_MAC 0x1   // old_mac holds what the device had before the set
+
+typedef struct {
+    uint64_t time_us;
+    uint32_t latency_us;
+    uint16_t vid, pid;
+    uint8_t  op;
+    uint8_t  result;
+    uint8_t  flags;
+    uint8_t  old_mac[6];
+    uint8_t  new_mac[6];
+    char     serial[60];
+    char     path[224];
+} journal_record;
+
+typedef struct journal journal;
+
+// Opens or creates file for appending. Returns NULL with a reason in err.
+journal *journal_open(const char *file, char *err, size_t errlen);
+// Commits everything still pending, fsyncs and closes.
+void     journal_close(journal *j);
+// Queues one record; thread-safe, never waits for the disk.
+void     journal_append(journal *j, const journal_record *r);
+// Blocks until every record appended so far is on disk. Returns 0 on an I/O error.
+int      journal_sync(journal *j);
+
+// Fills a record for a finished sixaxis_process_one (op SET when set is nonzero).
+void     journal_record_device(journal_record *r, const sixaxis_device *dev, int set);
+uint64_t journal_now_us(void);
+
+// Calls cb for every intact record in order and stops at the first torn or
+// foreign one (*torn set when that happened; may be NULL), or once cb returns
+// nonzero. Returns the number of records read, or -1 if the file is missing
+// or not a journal.
+typedef int (*journal_cb)(const journal_record *r, void *user);
+long journal_read(const char *file, journal_cb cb, void *user, int *torn, char *err, size_t errlen);
+// journal_read as CSV: time,path,vid,pid,serial,op,old_mac,new_mac,result,latency_ms.
+// A torn tail still returns the count, with a note left in err.
+long journal_export_csv(const char *file, FILE *out, char *err, size_t errlen);
+
+#endif // JOURNAL_H
@@ -0,0 +1,279 @@
+// manifest.c — see manifest.h.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "manifest.h"
+#include "sixaxis_pair.h"
+
+// Rows live directly in an open-addressing table kept at most half full;
+// keys point into the file text, normalized in place.
+typedef struct {
+    const char *key;   // NULL = empty slot
+    uint32_t    hash;
+    uint8_t     kind;
+    uint8_t     mac[6];
+} row;
+
+struct manifest {
+    char   *text;
+    row    *slots;
+    size_t  mask;      // slot count - 1
+    size_t  nrows;
+};
+
+static const char *const key_names[] = { "serial", "port", "path" };
+
+const char *manifest_key_name(manifest_key kind) {
+    return (unsigned)kind < 3 ? key_names[kind] : "?";
+}
+
+// Lowercase; serials also drop the separators people put in MAC-like serials.
+static size_t normalize(char *dst, const char *src, size_t n, manifest_key kind) {
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++) {
+        char c = src[i];
+        if (kind == MANIFEST_KEY_SERIAL && (c == ':' || c == '-' || c == ' ')) continue;
+        dst[k++] = (char)tolower((unsigned char)c);
+    }
+    dst[k] = 0;
+    return k;
+}
+
+// FNV-1a over the kind byte and the key.
+static uint32_t hash_key(manifest_key kind, const char *key) {
+    uint32_t h = 2166136261u;
+    h = (h ^ (uint8_t)kind) * 16777619u;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) h = (h ^ *p) * 16777619u;
+    return h;
+}
+
+static row *probe(const manifest *m, manifest_key kind, const char *key, uint32_t h) {
+    for (size_t i = h & m->mask;; i = (i + 1) & m->mask) {
+        row *r = &m->slots[i];
+        if (!r->key || (r->hash == h && r->kind == kind && strcmp(r->key, key) == 0)) return r;
+    }
+}
+
+// ---------- loading ----------
+typedef struct {
+    manifest   *m;
+    const char *file;
+    char       *err;
+    size_t      errlen;
+} loader;
+
+static int fail(loader *ld, int line, const char *what, const char *detail) {
+    snprintf(ld->err, ld->errlen, "%s:%d: %s%s%s", ld->file, line, what,
+             detail ? " " : "", detail ? detail : "");
+    return 0;
+}
+
+// key/mac point into the text and are NUL-terminated, key not yet normalized.
+static int add_row(loader *ld, manifest_key kind, char *key, const char *mac, int at) {
+    uint8_t mac6[6];
+    if (!parse_mac(mac, mac6)) return fail(ld, at, "bad MAC", mac);
+    if (!normalize(key, key, strlen(key), kind)) return fail(ld, at, "empty", key_names[kind]);
+
+    uint32_t h = hash_key(kind, key);
+    row *r = probe(ld->m, kind, key, h);
+    if (r->key) return fail(ld, at, "duplicate", key_names[kind]);
+    r->key = key;
+    r->hash = h;
+    r->kind = (uint8_t)kind;
+    memcpy(r->mac, mac6, 6);
+    ld->m->nrows++;
+    return 1;
+}
+
+static int key_kind(const char *name, manifest_key *kind) {
+    for (int k = 0; k < 3; k++) {
+        if (strcmp(name, key_names[k]) == 0) { *kind = (manifest_key)k; return 1; }
+    }
+    return 0;
+}
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1])) *--e = 0;
+    if (e - s >= 2 && *s == '"' && e[-1] == '"') { e[-1] = 0; s++; }
+    return s;
+}
+
+// key,mac[,ignored...] per line; blank lines and # comments skipped.
+static int parse_csv(loader *ld) {
+    manifest_key kind = MANIFEST_KEY_SERIAL;
+    int first = 1, at = 0;
+    for (char *line = ld->m->text, *next; line && *line; line = next) {
+        next = strchr(line, '\n');
+        if (next) *next++ = 0;
+        at++;
+        line = trim(line);
+        if (!*line || *line == '#') continue;
+
+        char *comma = strchr(line, ',');
+        if (!comma) return fail(ld, at, "expected key,mac", NULL);
+        *comma = 0;
+        char *mac = comma + 1, *extra = strchr(mac, ',');
+        if (extra) *extra = 0;
+        char *key = trim(line);
+        mac = trim(mac);
+
+        if (first) {
+            first = 0;
+            manifest_key k;
+            for (char *c = key; *c; c++) *c = (char)tolower((unsigned char)*c);
+            if (key_kind(key, &k) && strcmp(mac, "mac") == 0) { kind = k; continue; }
+        }
+        if (!add_row(ld, kind, key, mac, at)) return 0;
+    }
+    return 1;
+}
+
+// ---------- JSON ----------
+// Just enough for an array of flat objects with string values. Newlines are
+// left in place, so error lines are counted from the start of the text.
+static int line_of(const loader *ld, const char *at) {
+    int line = 1;
+    for (const char *p = ld->m->text; p < at; p++) line += *p == '\n';
+    return line;
+}
+
+static char *skip_ws(char *p) {
+    while (isspace((unsigned char)*p)) p++;
+    return p;
+}
+
+// Unescapes the string starting after the opening quote in place and
+// terminates it; returns the position after the closing quote, NULL if unterminated.
+static char *json_string(char *p, char **out) {
+    char *w = p;
+    *out = p;
+    for (; *p && *p != '"'; p++) {
+        if (*p == '\\' && p[1]) p++;
+        *w++ = *p;
+    }
+    if (*p != '"') return NULL;
+    *w = 0;
+    return p + 1;
+}
+
+static int parse_json(loader *ld) {
+    char *p = skip_ws(ld->m->text);
+    if (*p++ != '[') return fail(ld, line_of(ld, p - 1), "expected [", NULL);
+    p = skip_ws(p);
+    if (*p == ']') return 1;
+
+    for (;;) {
+        char *obj = p;
+        if (*p++ != '{') return fail(ld, line_of(ld, obj), "expected {", NULL);
+        char *key = NULL, *mac = NULL;
+        manifest_key kind = MANIFEST_KEY_SERIAL;
+        p = skip_ws(p);
+        while (*p != '}') {
+            char *name, *value, *at = p;
+            if (*p != '"' || !(p = json_string(p + 1, &name)))
+                return fail(ld, line_of(ld, at), "expected \"name\"", NULL);
+            p = skip_ws(p);
+            if (*p++ != ':') return fail(ld, line_of(ld, p - 1), "expected :", NULL);
+            p = skip_ws(p);
+            if (*p != '"' || !(p = json_string(p + 1, &value)))
+                return fail(ld, line_of(ld, at), "expected string value for", name);
+
+            manifest_key k;
+            if (strcmp(name, "mac") == 0) mac = value;
+            else if (key_kind(name, &k)) {
+                if (key) return fail(ld, line_of(ld, at), "more than one key in object", NULL);
+                key = value;
+                kind = k;
+            }
+            p = skip_ws(p);
+            if (*p == ',') p = skip_ws(p + 1);
+            else if (*p != '}') return fail(ld, line_of(ld, p), "expected , or }", NULL);
+        }
+        if (!key || !mac) return fail(ld, line_of(ld, obj), "object needs mac and serial, port or path", NULL);
+        if (!add_row(ld, kind, key, mac, line_of(ld, obj))) return 0;
+
+        p = skip_ws(p + 1);
+        if (*p == ']') return 1;
+        if (*p++ != ',') return fail(ld, line_of(ld, p - 1), "expected , or ]", NULL);
+        p = skip_ws(p);
+    }
+}
+
+manifest *manifest_load(const char *file, char *err, size_t errlen) {
+    FILE *f = fopen(file, "rb");
+    if (!f) {
+        snprintf(err, errlen, "cannot open manifest '%s'", file);
+        return NULL;
+    }
+    manifest *m = (manifest *)calloc(1, sizeof(*m));
+    long size = -1;
+    if (m && fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0)
+        m->text = (char *)malloc((size_t)size + 1);
+    if (!m || !m->text || fread(m->text, 1, (size_t)size, f) != (size_t)size) {
+        fclose(f);
+        snprintf(err, errlen, "cannot read manifest '%s'", file);
+        manifest_free(m);
+        return NULL;
+    }
+    fclose(f);
+    m->text[size] = 0;
+
+    // Size the table from an upper bound on rows: lines, or objects for JSON.
+    char *start = skip_ws(m->text);
+    int json = *start == '[';
+    size_t est = 1, slots = 16;
+    for (const char *p = m->text; *p; p++) est += json ? *p == '{' : *p == '\n';
+    while (slots < est * 2) slots <<= 1;
+    m->slots = (row *)calloc(slots, sizeof(row));
+    if (!m->slots) {
+        snprintf(err, errlen, "manifest '%s' too large", file);
+        manifest_free(m);
+        return NULL;
+    }
+    m->mask = slots - 1;
+
+    loader ld = { m, file, err, errlen };
+    if (!(json ? parse_json(&ld) : parse_csv(&ld))) {
+        manifest_free(m);
+        return NULL;
+    }
+    return m;
+}
+
+void manifest_free(manifest *m) {
+    if (!m) return;
+    free(m->slots);
+    free(m->text);
+    free(m);
+}
+
+size_t manifest_rows(const manifest *m) {
+    return m->nrows;
+}
+
+// ---------- lookup ----------
+const uint8_t *manifest_find(const manifest *m, manifest_key kind, const char *key) {
+    char norm[HID_PATH_MAX];
+    size_t n = strlen(key);
+    if (n == 0 || n >= sizeof(norm)) return NULL;
+    normalize(norm, key, n, kind);
+    const row *r = probe(m, kind, norm, hash_key(kind, norm));
+    return r->key ? r->mac : NULL;
+}
+
+const uint8_t *manifest_match(const manifest *m, const hid_device_info *info, manifest_key *how) {
+    const char *keys[3] = { info->serial, info->port, info->path };
+    for (int k = 0; k < 3; k++) {
+        const uint8_t *mac = manifest_find(m, (manifest_key)k, keys[k]);
+        if (mac) {
+            if (how) *how = (manifest_key)k;
+            return mac;
+        }
+    }
+    return NULL;
+}
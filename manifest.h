@@ -0,0 +1,47 @@
+// manifest.h — station job manifest: controller identity -> target host MAC.
+//
+// A manifest says which host each controller must be paired to. Rows are
+// keyed by USB serial number (HidD_GetSerialNumberString / HID_UNIQ; a DS4
+// reports its own Bluetooth address), by USB port, or by interface path:
+//
+//   CSV   serial,mac                 (header optional; "port,mac" or
+//         1c:a0:b8:12:34:56,00:1a:7d:da:71:13    "path,mac" switches the key)
+//   JSON  [ {"serial": "1c:a0:b8:12:34:56", "mac": "00:1a:7d:da:71:13"},
+//           {"port": "1-1.2", "mac": "00:1a:7d:da:71:14"} ]
+//
+// Keys compare case-insensitively and serials ignore ':' and '-', so a DS4
+// serial matches whether it is written 1C-A0-B8-... or 1ca0b8.... The file is
+// indexed once in an open-addressing hash, so a lookup costs the same with
+// ten rows or a few hundred thousand.
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hid_transport.h"
+
+typedef enum {
+    MANIFEST_KEY_SERIAL,
+    MANIFEST_KEY_PORT,
+    MANIFEST_KEY_PATH,
+} manifest_key;
+
+typedef struct manifest manifest;
+
+// Loads and indexes a CSV or JSON manifest (told apart by the first
+// character). Returns NULL with a reason ("file:line: ...") in err on a
+// missing file, a bad MAC or a key listed twice.
+manifest *manifest_load(const char *file, char *err, size_t errlen);
+void      manifest_free(manifest *m);
+size_t    manifest_rows(const manifest *m);
+
+// Target MAC for one key, or NULL.
+const uint8_t *manifest_find(const manifest *m, manifest_key kind, const char *key);
+// Target for a device: its serial first, then its port, then its path.
+// *how (may be NULL) tells which key matched.
+const uint8_t *manifest_match(const manifest *m, const hid_device_info *info, manifest_key *how);
+const char    *manifest_key_name(manifest_key kind);
+
+#endif // MANIFEST_H
@@ -1,16 +1,15 @@
-// build: clang -framework IOKit -framework CoreFoundation pair_sixaxis_mac.c -o pair_sixaxis
+// build: clang -framework IOKit -framework CoreFoundation pair_osx.c sixaxis_pair.c sixaxis_profile.c workpool.c hubsched.c sixaxis_stats.c sixaxis_trace.c -o pair_sixaxis
+// (or link libsixaxis). Report IDs, lengths and MAC layout come from the profile
+// table (sixaxis_profile.h); MAC parsing from sixaxis_pair.h.
 #include <CoreFoundation/CoreFoundation.h>
 #include <IOKit/hid/IOHIDManager.h>
 #include <stdio.h>
-#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
 
-static const int VENDOR = 0x054c;
-static const int PRODUCTS[] = { 0x0268, 0x042f };
-static const uint8_t MAC_REPORT_ID = 0xf5;
+#include "sixaxis_pair.h"
 
-// … (helper: char_to_nibble, mac_to_bytes) same as above …
-
-static IOHIDDeviceRef open_device() {
+static IOHIDDeviceRef open_device(const sixaxis_profile **out_prof) {
 	IOHIDManagerRef mgr = IOHIDManagerCreate(kCFAllocatorDefault, kIOHIDOptionsTypeNone);
 	IOHIDManagerSetDeviceMatching(mgr, NULL);
 	IOHIDManagerOpen(mgr, kIOHIDOptionsTypeNone);
@@ -26,14 +25,13 @@ static IOHIDDeviceRef open_device() {
 		CFTypeRef v = IOHIDDeviceGetProperty(devs[i], CFSTR(kIOHIDVendorIDKey));
 		CFTypeRef p = IOHIDDeviceGetProperty(devs[i], CFSTR(kIOHIDProductIDKey));
 		if (!v || !p) continue;
-		int vid = (int)CFNumberGetValue((CFNumberRef)v, kCFNumberIntType, &vid);
+		int vid = 0; CFNumberGetValue((CFNumberRef)v, kCFNumberIntType, &vid);
 		int pid = 0; CFNumberGetValue((CFNumberRef)p, kCFNumberIntType, &pid);
-		if (vid == VENDOR) {
-			for (size_t k=0;k<sizeof(PRODUCTS)/sizeof(PRODUCTS[0]);++k) {
-				if (pid == PRODUCTS[k]) { match = devs[i]; break; }
-			}
+		if (vid == SONY_VID && sony_rank((uint16_t)pid) <= 1) { // controllers, not dongles
+			match = devs[i];
+			*out_prof = sixaxis_profile_for(SONY_VID, (uint16_t)pid);
+			break;
 		}
-		if (match) break;
 	}
 	CFRelease(devset);
 	if (!match) { CFRelease(mgr); free(devs); return NULL; }
@@ -44,29 +42,34 @@ static IOHIDDeviceRef open_device() {
 	return match;
 }
 
-static int set_mac(IOHIDDeviceRef dev, const char* mac) {
-	uint8_t buf[8] = {0}, m[6] = {0};
-	size_t L = strlen(mac);
-	if (!((L==12)||(L==17)) || !mac_to_bytes(mac, L, m)) { fprintf(stderr,"Invalid MAC\n"); return 0; }
-	buf[0]=MAC_REPORT_ID; buf[1]=0x00; memcpy(buf+2, m, 6);
-	IOReturn r = IOHIDDeviceSetReport(dev, kIOHIDReportTypeFeature, MAC_REPORT_ID, buf, sizeof(buf));
+static int set_mac(IOHIDDeviceRef dev, const sixaxis_profile *prof, const char* mac) {
+	uint8_t buf[SIXAXIS_REPORT_MAX] = {0}, m[6] = {0};
+	if (!parse_mac(mac, m)) { fprintf(stderr,"Invalid MAC\n"); return 0; }
+	buf[0] = prof->report_id;
+	sixaxis_profile_put_mac(prof, buf, m);
+	IOReturn r = IOHIDDeviceSetReport(dev, kIOHIDReportTypeFeature, prof->report_id, buf, prof->report_len);
 	if (r) { fprintf(stderr,"IOHIDDeviceSetReport err=0x%x\n", r); return 0; }
 	return 1;
 }
-static int get_mac(IOHIDDeviceRef dev) {
-	uint8_t buf[8] = {0}; CFIndex len = sizeof(buf);
-	buf[0]=MAC_REPORT_ID; buf[1]=0x00;
-	IOReturn r = IOHIDDeviceGetReport(dev, kIOHIDReportTypeFeature, MAC_REPORT_ID, buf, &len);
-	if (r || len < 8) { fprintf(stderr,"IOHIDDeviceGetReport err=0x%x, len=%ld\n", r, (long)len); return 0; }
-	printf("%02x:%02x:%02x:%02x:%02x:%02x\n", buf[2], buf[3], buf[4], buf[5], buf[6], buf[7]);
+static int get_mac(IOHIDDeviceRef dev, const sixaxis_profile *prof) {
+	uint8_t buf[SIXAXIS_REPORT_MAX] = {0}, m[6];
+	CFIndex len = prof->report_len;
+	char out[18];
+	buf[0] = prof->report_id;
+	IOReturn r = IOHIDDeviceGetReport(dev, kIOHIDReportTypeFeature, prof->report_id, buf, &len);
+	if (r || len < prof->mac_offset + 6) { fprintf(stderr,"IOHIDDeviceGetReport err=0x%x, len=%ld\n", r, (long)len); return 0; }
+	sixaxis_profile_get_mac(prof, buf, m);
+	format_mac(m, out);
+	puts(out);
 	return 1;
 }
 
 int main(int argc, char** argv) {
 	if (argc != 1 && argc != 2) { fprintf(stderr, "usage: %s [mac]\n", argv[0]); return 1; }
-	IOHIDDeviceRef dev = open_device();
+	const sixaxis_profile *prof = NULL;
+	IOHIDDeviceRef dev = open_device(&prof);
 	if (!dev) { fprintf(stderr, "controller not found\n"); return 2; }
-	int ok = (argc==2) ? set_mac(dev, argv[1]) : get_mac(dev);
+	int ok = (argc==2) ? set_mac(dev, prof, argv[1]) : get_mac(dev, prof);
 	CFRelease(dev);
 	return ok ? 0 : 3;
 }
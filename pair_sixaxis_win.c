@@ -1,230 +1,651 @@
-// pair_sixaxis_win.c  — Windows native HID (no hidapi), DS3/DS4 pairing MAC tool.
+// pair_sixaxis_win.c  — DS3/DS4 pairing MAC tool. Windows native HID (no hidapi)
+// or Linux hidraw, selected through hid_transport.h.
 
-#ifndef WIN32_LEAN_AND_MEAN
-#  define WIN32_LEAN_AND_MEAN
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <sys/stat.h>
 #endif
-#include <windows.h>
-#include <setupapi.h>
-#include <hidsdi.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <time.h>
 
-#ifdef _MSC_VER
-#  pragma comment(lib, "setupapi.lib")
-#  pragma comment(lib, "hid.lib")
-#endif
+#include "devcache.h"
+#include "hid_capture.h"
+#include "hid_probe.h"
+#include "hid_transport.h"
+#include "hid_transport_mock.h"
+#include "hostpool.h"
+#include "hotplug.h"
+#include "journal.h"
+#include "manifest.h"
+#include "presets.h"
+#include "sixaxis_pair.h"
+#include "sixaxis_stats.h"
+#include "sixaxis_trace.h"
+
+// SIXAXIS_TRANSPORT=mock swaps in simulated devices described by SIXAXIS_MOCK.
+static const hid_transport *tp = HID_TRANSPORT_DEFAULT;
 
-// ---------- PID classification ----------
-static int is_ds3_pid(USHORT pid) {
-    return (pid == 0x0268 || pid == 0x042F); // Sixaxis/Move
+// --stats=json (to stderr at exit) and --stats-prom FILE (at exit, and after
+// every controller in --daemon).
+static int         stats_json;
+static const char *stats_prom;
+// --trace FILE: Chrome trace of every phase, written at exit.
+static const char *trace_file;
+// --record FILE wraps the transport in a capture; --replay FILE replaces it.
+static const char *record_file, *replay_file;
+static double      replay_speed = 1.0;
+
+static void write_prom(void) {
+    char err[256];
+    if (stats_prom && !sixaxis_stats_write_prometheus(stats_prom, err, sizeof(err)))
+        fprintf(stderr, "%s\n", err);
 }
-static int is_ds4_controller_pid(USHORT pid) {
-    switch (pid) {
-        case 0x05C4: // DS4 (old)
-        case 0x09CC: // DS4 (new)
-        case 0x0CE6: // DS4 Slim (some fw)
-        case 0x0CDA: // variant seen in wild
-            return 1;
-        default: return 0;
-    }
-}
-static int is_ds4_dongle_pid(USHORT pid) {
-    return (pid == 0x0BA0); // DUALSHOCK4 USB Wireless Adaptor
-}
-static UCHAR pick_report_id(USHORT pid) {
-    return is_ds3_pid(pid) ? 0xF5 : 0x12; // DS3 uses 0xF5, DS4 family uses 0x12
-}
-
-// ---------- small utils ----------
-static int char_to_nibble(char c) {
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-    return -1;
-}
-static int mac_to_bytes(const char* in, size_t in_len, UCHAR out6[6]) {
-    size_t i = 0;
-    for (size_t p = 0; p + 1 < in_len && i < 6; ) {
-        if (in[p] == ':') { p++; continue; }
-        int hi = char_to_nibble(in[p]);
-        int lo = char_to_nibble(in[p+1]);
-        if (hi < 0 || lo < 0) return 0;
-        out6[i++] = (UCHAR)((hi << 4) | lo);
-        p += 2;
-    }
-    return i == 6;
-}
-static void print_mac_forward(const UCHAR *b) {
-    printf("%02x:%02x:%02x:%02x:%02x:%02x\n", b[0], b[1], b[2], b[3], b[4], b[5]);
-}
-static void print_mac_reverse(const UCHAR *b) { // for DS4 report 0x12 over USB
-    printf("%02x:%02x:%02x:%02x:%02x:%02x\n", b[5], b[4], b[3], b[2], b[1], b[0]);
-}
-
-// ---------- device open (prefer controller) ----------
-static HANDLE open_sony_hid(USHORT *out_pid) {
-    GUID g; HidD_GetHidGuid(&g);
-    HDEVINFO devs = SetupDiGetClassDevs(&g, NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
-    if (devs == INVALID_HANDLE_VALUE) return INVALID_HANDLE_VALUE;
-
-    SP_DEVICE_INTERFACE_DATA ifd; ifd.cbSize = sizeof(ifd);
-    DWORD idx = 0;
-
-    HANDLE best_ds4 = INVALID_HANDLE_VALUE;  USHORT best_ds4_pid = 0;
-    HANDLE best_ds3 = INVALID_HANDLE_VALUE;  USHORT best_ds3_pid = 0;
-    HANDLE best_dgl = INVALID_HANDLE_VALUE;  USHORT best_dgl_pid = 0;
-    HANDLE any_sony = INVALID_HANDLE_VALUE;  USHORT any_pid     = 0;
-
-    while (SetupDiEnumDeviceInterfaces(devs, NULL, &g, idx++, &ifd)) {
-        DWORD need = 0;
-        SetupDiGetDeviceInterfaceDetail(devs, &ifd, NULL, 0, &need, NULL);
-        PSP_DEVICE_INTERFACE_DETAIL_DATA det = (PSP_DEVICE_INTERFACE_DETAIL_DATA)malloc(need);
-        if (!det) continue;
-        det->cbSize = sizeof(*det);
-
-        if (SetupDiGetDeviceInterfaceDetail(devs, &ifd, det, need, NULL, NULL)) {
-            HANDLE h = CreateFile(det->DevicePath, GENERIC_READ|GENERIC_WRITE,
-                                  FILE_SHARE_READ|FILE_SHARE_WRITE, NULL,
-                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-            if (h == INVALID_HANDLE_VALUE) {
-                h = CreateFile(det->DevicePath, GENERIC_WRITE,
-                               FILE_SHARE_READ|FILE_SHARE_WRITE, NULL,
-                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-            }
-            if (h != INVALID_HANDLE_VALUE) {
-                HIDD_ATTRIBUTES a; a.Size = sizeof(a);
-                if (HidD_GetAttributes(h, &a) && a.VendorID == 0x054c) {
-                    if (is_ds4_controller_pid(a.ProductID)) {
-                        if (best_ds4 == INVALID_HANDLE_VALUE) { best_ds4 = h; best_ds4_pid = a.ProductID; h = INVALID_HANDLE_VALUE; }
-                    } else if (is_ds3_pid(a.ProductID)) {
-                        if (best_ds3 == INVALID_HANDLE_VALUE) { best_ds3 = h; best_ds3_pid = a.ProductID; h = INVALID_HANDLE_VALUE; }
-                    } else if (is_ds4_dongle_pid(a.ProductID)) {
-                        if (best_dgl == INVALID_HANDLE_VALUE) { best_dgl = h; best_dgl_pid = a.ProductID; h = INVALID_HANDLE_VALUE; }
-                    } else if (any_sony == INVALID_HANDLE_VALUE) {
-                        any_sony = h; any_pid = a.ProductID; h = INVALID_HANDLE_VALUE;
-                    }
-                }
-                if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
+
+// Audit trail of every set (--journal); NULL when disabled or only reading.
+static journal *jr;
+
+// ---------- results ----------
+// Thread-safe and non-blocking: the journal commits in the background.
+static void journal_device(const sixaxis_device *d) {
+    journal_record r;
+    if (!jr) return;
+    journal_record_device(&r, d, 1);
+    journal_append(jr, &r);
+}
+
+// One line per device; a single printf keeps lines from interleaving.
+static void print_result(const char *prefix, const sixaxis_device *d, int set) {
+    char mac[18];
+    format_mac(d->mac, mac);
+    if (d->result == SIXAXIS_SET_FAILED || d->result == SIXAXIS_SET_TIMEOUT)
+        printf("%s%s [%04x] %s %s\n", prefix, d->info.path, d->info.pid,
+               d->result == SIXAXIS_SET_FAILED ? "FAILED" : "TIMEOUT", d->err);
+    else if (!set)
+        printf("%s%s [%04x] %s\n", prefix, d->info.path, d->info.pid, mac);
+    else if (d->result == SIXAXIS_SET_UNVERIFIED)
+        printf("%s%s [%04x] set %s UNVERIFIED %s\n", prefix, d->info.path, d->info.pid, mac, d->err);
+    else
+        printf("%s%s [%04x] set %s %s\n", prefix, d->info.path, d->info.pid, mac,
+               sixaxis_set_result_name(d->result));
+}
+
+// ---------- batch mode (--all) ----------
+#define BATCH_MAX_DEVICES 256
+
+static int paired(sixaxis_set_result r) {
+    return r == SIXAXIS_SET_VERIFIED || r == SIXAXIS_SET_UNCHANGED || r == SIXAXIS_SET_UNVERIFIED;
+}
+
+// Per-host load after a --hosts run, on stderr next to the summary.
+static void print_hosts(const hostpool *pool) {
+    for (size_t i = 0; i < hostpool_hosts(pool); i++) {
+        uint8_t mac6[6];
+        unsigned load, capacity;
+        char mac[18];
+        hostpool_host(pool, i, mac6, &load, &capacity);
+        format_mac(mac6, mac);
+        fprintf(stderr, "host %s: %u/%u\n", mac, load, capacity);
+    }
+}
+
+// With a pool every controller gets a host of its own (sixaxis_assign_many);
+// one that finds every host full is reported failed and left alone.
+static int run_batch(const uint8_t *mac6, hostpool *pool, const sixaxis_batch_opts *opts) {
+    static sixaxis_device devs[BATCH_MAX_DEVICES]; // too large for the stack
+    size_t n = sixaxis_enumerate(tp, devs, BATCH_MAX_DEVICES);
+    if (n == 0) {
+        fprintf(stderr, "No Sony controllers found on USB.\n");
+        return 2;
+    }
+    if (n > BATCH_MAX_DEVICES) n = BATCH_MAX_DEVICES;
+
+    size_t placed = n;
+    if (pool) {
+        // Controllers that got a host first, the rest after them.
+        placed = 0;
+        for (size_t i = 0; i < n; i++) {
+            sixaxis_device d = devs[i];
+            if (hostpool_assign(pool, &d.info, d.mac)) {
+                devs[i] = devs[placed];
+                devs[placed++] = d;
+            } else {
+                devs[i].result = SIXAXIS_SET_FAILED;
+                snprintf(devs[i].err, sizeof(devs[i].err), "every host adapter is full");
             }
         }
-        free(det);
-    }
-    SetupDiDestroyDeviceInfoList(devs);
-
-    HANDLE pick = INVALID_HANDLE_VALUE; USHORT pid = 0;
-    if (best_ds4 != INVALID_HANDLE_VALUE) { pick = best_ds4; pid = best_ds4_pid; }
-    else if (best_ds3 != INVALID_HANDLE_VALUE) { pick = best_ds3; pid = best_ds3_pid; }
-    else if (any_sony != INVALID_HANDLE_VALUE) { pick = any_sony; pid = any_pid; }
-    else if (best_dgl != INVALID_HANDLE_VALUE) { pick = best_dgl; pid = best_dgl_pid; }
-
-    // Close unpicked
-    if (best_ds4 != INVALID_HANDLE_VALUE && best_ds4 != pick) CloseHandle(best_ds4);
-    if (best_ds3 != INVALID_HANDLE_VALUE && best_ds3 != pick) CloseHandle(best_ds3);
-    if (best_dgl != INVALID_HANDLE_VALUE && best_dgl != pick) CloseHandle(best_dgl);
-    if (any_sony != INVALID_HANDLE_VALUE && any_sony != pick) CloseHandle(any_sony);
-
-    if (out_pid) *out_pid = pid;
-    return pick;
-}
-
-// ---------- feature I/O ----------
-static int feature_lengths(HANDLE h, USHORT *out_feat_len) {
-    PHIDP_PREPARSED_DATA pp = NULL;
-    HIDP_CAPS caps;
-    if (!HidD_GetPreparsedData(h, &pp)) return 0;
-    NTSTATUS st = HidP_GetCaps(pp, &caps);
-    HidD_FreePreparsedData(pp);
-    if (st != HIDP_STATUS_SUCCESS) return 0;
-    if (out_feat_len) *out_feat_len = caps.FeatureReportByteLength;
-    return 1;
+        sixaxis_assign_many(tp, devs, placed, opts);
+        for (size_t i = 0; i < placed; i++) hostpool_commit(pool, &devs[i].info, paired(devs[i].result));
+    } else if (mac6) {
+        sixaxis_set_many(tp, mac6, devs, n, opts);
+    } else {
+        sixaxis_read_many(tp, devs, n, opts);
+    }
+
+    int rc = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (mac6 || pool) journal_device(&devs[i]);
+        print_result("", &devs[i], mac6 != NULL || pool != NULL);
+        if (devs[i].result == SIXAXIS_SET_FAILED || devs[i].result == SIXAXIS_SET_TIMEOUT) rc = 3;
+        else if (devs[i].result == SIXAXIS_SET_UNVERIFIED && rc == 0) rc = 4;
+    }
+    if (pool) print_hosts(pool);
+    return rc;
 }
 
-static int do_set_mac(HANDLE h, USHORT pid, UCHAR report_id, const char* mac_str) {
-    UCHAR mac6[6];
-    size_t L = strlen(mac_str);
-    if (!((L==12)||(L==17)) || !mac_to_bytes(mac_str, L, mac6)) {
-        fprintf(stderr, "Invalid MAC. Use 112233445566 or 11:22:33:44:55:66\n");
-        return 0;
+// ---------- station mode (--manifest) ----------
+static void csv_field(char *dst, size_t n, const char *s) {
+    size_t k = 0;
+    for (; *s && k + 1 < n; s++) if (*s != ',' && *s != '\n') dst[k++] = *s;
+    dst[k] = 0;
+}
+
+// serial,port,path,pid,mac,result,reason — one fprintf per row, flushed, so
+// rows stream out in completion order without interleaving.
+static void manifest_row(FILE *out, const sixaxis_device *d, const char *result, int has_mac) {
+    char mac[18] = "", serial[HID_STR_MAX], reason[sizeof(d->err)];
+    if (has_mac) format_mac(d->mac, mac);
+    csv_field(serial, sizeof(serial), d->info.serial);
+    csv_field(reason, sizeof(reason), d->err);
+    fprintf(out, "%s,%s,%s,%04x,%s,%s,%s\n", serial, d->info.port, d->info.path, d->info.pid,
+            mac, result, reason);
+    fflush(out);
+}
+
+static void manifest_done(const sixaxis_device *d, void *user) {
+    journal_device(d);
+    manifest_row((FILE *)user, d, sixaxis_set_result_name(d->result), 1);
+}
+
+static int run_manifest(const char *file, const char *out_file, sixaxis_batch_opts *opts) {
+    static sixaxis_device found[BATCH_MAX_DEVICES], todo[BATCH_MAX_DEVICES];
+    char err[256];
+    manifest *m = manifest_load(file, err, sizeof(err));
+    if (!m) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+    FILE *out = out_file ? fopen(out_file, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "cannot write '%s'\n", out_file);
+        manifest_free(m);
+        return 1;
     }
+    fprintf(out, "serial,port,path,pid,mac,result,reason\n");
 
-    USHORT feat_len = 0;
-    if (!feature_lengths(h, &feat_len) || feat_len < 8) {
-        fprintf(stderr, "Could not query FeatureReportByteLength\n");
-        return 0;
+    size_t n = sixaxis_enumerate(tp, found, BATCH_MAX_DEVICES), ntodo = 0, skipped = 0;
+    if (n > BATCH_MAX_DEVICES) n = BATCH_MAX_DEVICES;
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t *mac6 = manifest_match(m, &found[i].info, NULL);
+        if (!mac6) {
+            snprintf(found[i].err, sizeof(found[i].err), "not in manifest");
+            manifest_row(out, &found[i], "skipped", 0);
+            skipped++;
+            continue;
+        }
+        todo[ntodo] = found[i];
+        memcpy(todo[ntodo++].mac, mac6, 6);
     }
 
-    UCHAR *buf = (UCHAR*)calloc(feat_len, 1);
-    if (!buf) { fprintf(stderr, "OOM\n"); return 0; }
-    buf[0] = report_id;
-    buf[1] = 0x00;
+    opts->on_done = manifest_done;
+    opts->user = out;
+    sixaxis_assign_many(tp, todo, ntodo, opts);
 
-    if (is_ds3_pid(pid)) {
-        // DS3/Move: forward order at buf[2..7]
-        memcpy(buf + 2, mac6, 6);
+    int rc = 0;
+    size_t failed = 0, unverified = 0;
+    for (size_t i = 0; i < ntodo; i++) {
+        if (todo[i].result == SIXAXIS_SET_FAILED || todo[i].result == SIXAXIS_SET_TIMEOUT) failed++;
+        else if (todo[i].result == SIXAXIS_SET_UNVERIFIED) unverified++;
+    }
+    if (failed) rc = 3;
+    else if (unverified) rc = 4;
+    else if (n == 0) rc = 2;
+    fprintf(stderr, "%zu rows, %zu controllers: %zu paired, %zu failed, %zu unverified, %zu not in manifest\n",
+            manifest_rows(m), n, ntodo - failed - unverified, failed, unverified, skipped);
+    if (out != stdout) fclose(out);
+    manifest_free(m);
+    return rc;
+}
+
+// ---------- resident mode (--daemon) ----------
+typedef struct {
+    const uint8_t            *mac6;
+    hostpool                 *pool;  // replaces mac6 when set
+    const sixaxis_batch_opts *opts;
+    unsigned long             paired, failed;
+} daemon_ctx;
+
+// Arrival of one interface: look only at that path, pair it if it is a
+// controller, log one line with the latency from the event (t0, taken by
+// hotplug before it waits for the node) to the result.
+static int daemon_arrival(const char *path, uint64_t t0, void *user) {
+    daemon_ctx *c = (daemon_ctx *)user;
+    sixaxis_device d;
+    memset(&d, 0, sizeof(d));
+    if (!tp->lookup(path, &d.info) || d.info.vid != SONY_VID || sony_rank(d.info.pid) > 1) return 0;
+
+    uint8_t host[6];
+    if (c->pool && !hostpool_assign(c->pool, &d.info, host)) {
+        d.result = SIXAXIS_SET_FAILED;
+        snprintf(d.err, sizeof(d.err), "every host adapter is full");
     } else {
-        // DS4 family: common USB feature 0x12 uses reversed order
-        buf[2] = mac6[5]; buf[3] = mac6[4]; buf[4] = mac6[3];
-        buf[5] = mac6[2]; buf[6] = mac6[1]; buf[7] = mac6[0];
+        sixaxis_process_one(tp, &d, c->pool ? host : c->mac6, c->opts);
+        if (c->pool) hostpool_commit(c->pool, &d.info, paired(d.result));
     }
+    if (d.result == SIXAXIS_SET_VERIFIED || d.result == SIXAXIS_SET_UNCHANGED) c->paired++;
+    else c->failed++;
+
+    char prefix[32];
+    time_t now = time(NULL);
+    size_t k = strftime(prefix, sizeof(prefix), "%H:%M:%S", localtime(&now));
+    snprintf(prefix + k, sizeof(prefix) - k, " %.0fms ", (double)(sixaxis_clock_ns() - t0) / 1e6);
+    journal_device(&d);
+    if (jr) journal_sync(jr); // one controller per event: nothing to group with
+    print_result(prefix, &d, 1);
+    fflush(stdout);
+    write_prom();
+    return 0;
+}
 
-    BOOL ok = HidD_SetFeature(h, buf, feat_len);
-    free(buf);
+// Runs until killed, or to the end of the replayed stream when events is set.
+static int run_daemon(const uint8_t *mac6, hostpool *pool, const char *events,
+                      const sixaxis_batch_opts *opts) {
+    daemon_ctx c = { mac6, pool, opts, 0, 0 };
+    char err[128] = "";
+
+    int ok = events ? hotplug_replay(events, daemon_arrival, &c, err, sizeof(err))
+                    : hotplug_run(daemon_arrival, &c, err, sizeof(err));
     if (!ok) {
-        fprintf(stderr, "HidD_SetFeature failed (err=%lu)\n", GetLastError());
-        return 0;
+        fprintf(stderr, "%s\n", err);
+        return 1;
     }
-    return 1;
+    fprintf(stderr, "%lu paired, %lu failed\n", c.paired, c.failed);
+    if (pool) print_hosts(pool);
+    return c.failed ? 3 : 0;
 }
 
-static int do_get_mac(HANDLE h, USHORT pid, UCHAR report_id) {
-    USHORT feat_len = 0;
-    if (!feature_lengths(h, &feat_len) || feat_len < 8) {
-        fprintf(stderr, "Could not query FeatureReportByteLength\n");
+// ---------- files shared with the GUI ----------
+// %APPDATA%\SixaxisPairer\<name> on Windows (the GUI's folder), else
+// $XDG_DATA_HOME/sixaxispairer/<name> or ~/.local/share/sixaxispairer/<name>.
+// The folder is created on first use. Returns 0 when there is no per-user
+// folder, so nothing lands in whatever directory the tool was started from.
+#define SIXAXIS_PRESETS_FILE     "presets.txt"
+#define SIXAXIS_DEVCACHE_FILE    "devices.cache"
+#define SIXAXIS_JOURNAL_FILE     "journal.bin"
+#define SIXAXIS_ASSIGNMENTS_FILE "assignments.txt" // --hosts controller -> host assignments
+
+static int default_app_file(const char *name, char *out, size_t len) {
+    size_t n;
+#ifdef _WIN32
+    const char *appdata = getenv("APPDATA");
+    if (!appdata || !*appdata) return 0;
+    n = (size_t)snprintf(out, len, "%s\\SixaxisPairer", appdata);
+    if (n >= len) return 0;
+    CreateDirectoryA(out, NULL); // no-op if it exists
+    n += (size_t)snprintf(out + n, len - n, "\\%s", name);
+#else
+    const char *xdg = getenv("XDG_DATA_HOME"), *home = getenv("HOME");
+    if (xdg && *xdg) {
+        n = (size_t)snprintf(out, len, "%s", xdg);
+    } else if (home && *home) {
+        n = (size_t)snprintf(out, len, "%s/.local", home);
+        if (n >= len) return 0;
+        mkdir(out, 0700);
+        n += (size_t)snprintf(out + n, len - n, "/share");
+    } else {
         return 0;
     }
-    UCHAR *buf = (UCHAR*)calloc(feat_len, 1);
-    if (!buf) { fprintf(stderr, "OOM\n"); return 0; }
-    buf[0] = report_id;
-    buf[1] = 0x00;
+    if (n >= len) return 0;
+    mkdir(out, 0700);
+    n += (size_t)snprintf(out + n, len - n, "/sixaxispairer");
+    if (n >= len) return 0;
+    mkdir(out, 0700); // existing directories are fine: the file open reports real failures
+    n += (size_t)snprintf(out + n, len - n, "/%s", name);
+#endif
+    return n < len;
+}
 
-    BOOL ok = HidD_GetFeature(h, buf, feat_len);
-    if (!ok) {
-        fprintf(stderr, "HidD_GetFeature failed (err=%lu)\n", GetLastError());
-        free(buf);
+// ---------- presets (--preset) ----------
+
+// Formats the MAC saved under name into mac (what the command line would have given).
+static int resolve_preset(const char *file, const char *name, char mac[18]) {
+    char err[256], def[512];
+    uint8_t mac6[6];
+    if (!file) {
+        if (!default_app_file(SIXAXIS_PRESETS_FILE, def, sizeof(def)))
+            snprintf(def, sizeof(def), "%s", SIXAXIS_PRESETS_FILE);
+        file = def;
+    }
+    preset_store *ps = presets_open(file, err, sizeof(err));
+    if (!ps) {
+        fprintf(stderr, "%s\n", err);
+        return 0;
+    }
+    int found = presets_find(ps, name, mac6);
+    presets_close(ps);
+    if (!found) {
+        fprintf(stderr, "No preset '%s' in '%s'\n", name, file);
         return 0;
     }
+    format_mac(mac6, mac);
+    return 1;
+}
 
-    // Payload is at [2..7]; DS4 prints reversed, DS3 prints forward
-    if (is_ds3_pid(pid)) print_mac_forward(buf + 2);
-    else                 print_mac_reverse(buf + 2);
+static int usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--all [--jobs N] [--per-hub N]] [--verify-tries N] [--timeout MS] [--force] [mac]\n"
+                    "       %s --daemon [--events FILE] [--verify-tries N] [--timeout MS] [--force] mac\n"
+                    "       %s --manifest FILE [--out FILE] [--jobs N] [--per-hub N] [--verify-tries N] [--timeout MS] [--force]\n"
+                    "       %s --export-journal FILE [--out FILE]\n"
+                    "  --hosts MAC[=N],...|@FILE [--assignments FILE] replaces mac in the first two forms\n"
+                    "  --preset NAME [--presets FILE] replaces mac with a MAC saved in the GUI\n"
+                    "  --path PATH | --serial S | --pid HEX | --index N (from 0) pick the controller\n"
+                    "    of the single-controller form (default: the first DS4, else DS3)\n"
+                    "  --device-cache FILE or --no-device-cache for the single-controller form\n"
+                    "  --journal FILE (default: the GUI's " SIXAXIS_JOURNAL_FILE ") or --no-journal for every set\n"
+                    "  --per-hub N feature transfers at once per USB hub (default 8, lowered per hub\n"
+                    "    while its transfers time out or are refused busy; 0 = no limit)\n"
+                    "  --probe-jobs N interfaces probed at once while enumerating (1 = one by one)\n"
+                    "  --stats=json (stderr) and/or --stats-prom FILE: phase timings at exit\n"
+                    "  --trace FILE: Chrome/Perfetto timeline of every device and phase, at exit\n"
+                    "  --record FILE: capture all HID traffic; --replay FILE [--replay-speed X]\n"
+                    "    serves a capture instead of devices (X: 1 = as recorded, 0 = no waits)\n",
+            argv0, argv0, argv0, argv0);
+    return 1;
+}
 
-    free(buf);
+static int select_backend(void) {
+    const char *name = getenv("SIXAXIS_TRANSPORT");
+    if (!name || !*name || strcmp(name, tp->name) == 0) return 1;
+    if (strcmp(name, "mock") == 0) {
+        if (!mock_hid_configure(getenv("SIXAXIS_MOCK"))) {
+            fprintf(stderr, "Bad SIXAXIS_MOCK spec (e.g. ds4=3,ds3=1,decoy=20,get_us=2000)\n");
+            return 0;
+        }
+        tp = &hid_transport_mock;
+        return 1;
+    }
+    fprintf(stderr, "Unknown SIXAXIS_TRANSPORT '%s'\n", name);
+    return 0;
+}
+
+// The backend (or --replay), then the --record capture around it.
+static int select_transport(void) {
+    char err[256];
+    const hid_transport *t = tp;
+    if (replay_file) t = hid_replay_open(replay_file, replay_speed, err, sizeof(err));
+    else if (!select_backend()) return 0;
+    else t = tp;
+    if (t && record_file) t = hid_capture_start(t, record_file, err, sizeof(err));
+    if (!t) {
+        fprintf(stderr, "%s\n", err);
+        return 0;
+    }
+    tp = t;
     return 1;
 }
 
 // ---------- main ----------
-int main(int argc, char** argv) {
-    if (argc != 1 && argc != 2) {
-        fprintf(stderr, "usage: %s [mac]\n", argv[0]);
-        return 1;
+static int run(int argc, char** argv) {
+    int all = 0, daemon = 0;
+    const char *events = NULL;
+    const char *manifest_file = NULL, *out_file = NULL;
+    const char *hosts = NULL, *assignments = NULL;
+    const char *journal_file = NULL, *export_file = NULL;
+    char journal_def[512];
+    int use_journal = 1;
+    const char *preset = NULL, *presets_file = NULL;
+    const char *devcache_file = NULL;
+    int use_devcache = 1;
+    sixaxis_selector sel = SIXAXIS_SELECT_ANY;
+    int selecting = 0;
+    const char *mac_str = NULL;
+    char preset_mac[18];
+    sixaxis_batch_opts opts = { 0, SIXAXIS_VERIFY_DEFAULT, 0, NULL, NULL, 0 };
+    unsigned timeout = SIXAXIS_DEFAULT_TIMEOUT_MS;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--all") == 0) {
+            all = 1;
+        } else if (strcmp(argv[i], "--daemon") == 0) {
+            daemon = 1;
+        } else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            events = argv[++i];
+        } else if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) {
+            manifest_file = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_file = argv[++i];
+        } else if (strcmp(argv[i], "--hosts") == 0 && i + 1 < argc) {
+            hosts = argv[++i];
+        } else if (strcmp(argv[i], "--assignments") == 0 && i + 1 < argc) {
+            assignments = argv[++i];
+        } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+            journal_file = argv[++i];
+        } else if (strcmp(argv[i], "--no-journal") == 0) {
+            use_journal = 0;
+        } else if (strcmp(argv[i], "--export-journal") == 0 && i + 1 < argc) {
+            export_file = argv[++i];
+        } else if (strcmp(argv[i], "--preset") == 0 && i + 1 < argc) {
+            preset = argv[++i];
+        } else if (strcmp(argv[i], "--presets") == 0 && i + 1 < argc) {
+            presets_file = argv[++i];
+        } else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc) {
+            sel.path = argv[++i];
+            selecting = 1;
+        } else if (strcmp(argv[i], "--serial") == 0 && i + 1 < argc) {
+            sel.serial = argv[++i];
+            selecting = 1;
+        } else if (strcmp(argv[i], "--pid") == 0 && i + 1 < argc) {
+            sel.pid = (uint16_t)strtoul(argv[++i], NULL, 16);
+            if (!sel.pid) return usage(argv[0]);
+            selecting = 1;
+        } else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+            char *end;
+            sel.index = (int)strtol(argv[++i], &end, 10);
+            if (*end || sel.index < 0) return usage(argv[0]);
+            selecting = 1;
+        } else if (strcmp(argv[i], "--device-cache") == 0 && i + 1 < argc) {
+            devcache_file = argv[++i];
+        } else if (strcmp(argv[i], "--no-device-cache") == 0) {
+            use_devcache = 0;
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            opts.jobs = (unsigned)strtoul(argv[++i], NULL, 10);
+            if (opts.jobs == 0) return usage(argv[0]);
+        } else if (strcmp(argv[i], "--per-hub") == 0 && i + 1 < argc) {
+            opts.per_hub = (unsigned)strtoul(argv[++i], NULL, 10);
+            if (opts.per_hub == 0) opts.per_hub = SIXAXIS_PER_HUB_UNLIMITED;
+        } else if (strcmp(argv[i], "--stats=json") == 0) {
+            stats_json = 1;
+            sixaxis_stats_enable(1);
+        } else if (strcmp(argv[i], "--stats-prom") == 0 && i + 1 < argc) {
+            stats_prom = argv[++i];
+            sixaxis_stats_enable(1);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_file = argv[++i];
+            sixaxis_trace_enable();
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_file = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_file = argv[++i];
+        } else if (strcmp(argv[i], "--replay-speed") == 0 && i + 1 < argc) {
+            char *end;
+            replay_speed = strtod(argv[++i], &end);
+            if (*end || replay_speed < 0) return usage(argv[0]);
+        } else if (strcmp(argv[i], "--probe-jobs") == 0 && i + 1 < argc) {
+            unsigned n = (unsigned)strtoul(argv[++i], NULL, 10);
+            if (n == 0) return usage(argv[0]);
+            hid_probe_set_jobs(n);
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            timeout = (unsigned)strtoul(argv[++i], NULL, 10); // 0 = wait forever
+        } else if (strcmp(argv[i], "--force") == 0) {
+            opts.force = 1;
+        } else if (strcmp(argv[i], "--verify-tries") == 0 && i + 1 < argc) {
+            opts.verify.attempts = (unsigned)strtoul(argv[++i], NULL, 10);
+            if (opts.verify.attempts == 0) return usage(argv[0]);
+        } else if (argv[i][0] != '-' && !mac_str) {
+            mac_str = argv[i];
+        } else {
+            return usage(argv[0]);
+        }
     }
+    if (export_file) {
+        char err[256] = "";
+        FILE *out = out_file ? fopen(out_file, "w") : stdout;
+        long n = out ? journal_export_csv(export_file, out, err, sizeof(err)) : -1;
+        if (!out) snprintf(err, sizeof(err), "cannot write '%s'", out_file);
+        if (out && out != stdout) fclose(out);
+        if (err[0]) fprintf(stderr, "%s\n", err);
+        return n < 0 ? 1 : 0;
+    }
+    if (preset) {
+        if (mac_str) return usage(argv[0]);
+        if (!resolve_preset(presets_file, preset, preset_mac)) return 1;
+        mac_str = preset_mac;
+    }
+    if (presets_file && !preset) return usage(argv[0]);
+    if ((opts.jobs || opts.per_hub) && !all && !manifest_file) return usage(argv[0]);
+    if (selecting && (all || daemon || manifest_file || (sel.path && sel.index >= 0))) return usage(argv[0]);
+    if (out_file && !manifest_file) return usage(argv[0]);
+    if (manifest_file && (all || daemon || mac_str)) return usage(argv[0]);
+    if (events && !daemon) return usage(argv[0]);
+    if (daemon && (all || !(mac_str || hosts))) return usage(argv[0]);
+    if (hosts && (mac_str || manifest_file)) return usage(argv[0]);
+    if (assignments && !hosts) return usage(argv[0]);
+    if (replay_speed != 1.0 && !replay_file) return usage(argv[0]);
+    if (!select_transport()) return 1;
+    tp->set_timeout(timeout);
 
-    USHORT pid = 0;
-    HANDLE h = open_sony_hid(&pid);
-    if (h == INVALID_HANDLE_VALUE) {
-        fprintf(stderr, "Sony HID not found on USB. Plug the controller by USB (not BT).\n");
-        return 2;
+    uint8_t mac6[6];
+    if (mac_str) {
+        if (!parse_mac(mac_str, mac6)) {
+            fprintf(stderr, "Invalid MAC. Use 112233445566 or 11:22:33:44:55:66\n");
+            return 3;
+        }
     }
 
-    UCHAR report_id = pick_report_id(pid);
-    int ok = (argc == 2)
-             ? do_set_mac(h, pid, report_id, argv[1])
-             : do_get_mac(h, pid, report_id);
+    // Sets go to the GUI's journal unless told otherwise; without a per-user
+    // folder only an explicit --journal FILE is kept.
+    if (use_journal && !journal_file && (mac_str || hosts || manifest_file)
+        && default_app_file(SIXAXIS_JOURNAL_FILE, journal_def, sizeof(journal_def)))
+        journal_file = journal_def;
+    if (use_journal && journal_file && (mac_str || hosts || manifest_file)) {
+        char err[256];
+        // A journal that cannot be opened costs the audit trail, not the pairing.
+        if (!(jr = journal_open(journal_file, err, sizeof(err))))
+            fprintf(stderr, "warning: %s; pairing without a journal\n", err);
+    }
+    if (manifest_file) {
+        int rc = run_manifest(manifest_file, out_file, &opts);
+        journal_close(jr);
+        return rc;
+    }
 
-    CloseHandle(h);
+    hostpool *pool = NULL;
+    if (hosts) {
+        char err[256], def[512];
+        if (!assignments) {
+            if (!default_app_file(SIXAXIS_ASSIGNMENTS_FILE, def, sizeof(def)))
+                snprintf(def, sizeof(def), "%s", SIXAXIS_ASSIGNMENTS_FILE);
+            assignments = def;
+        }
+        if (!(pool = hostpool_open(hosts, assignments, err, sizeof(err)))) {
+            fprintf(stderr, "%s\n", err);
+            journal_close(jr);
+            return 1;
+        }
+    }
+    if (daemon || all) {
+        int rc = daemon ? run_daemon(mac6, pool, events, &opts)
+                        : run_batch(mac_str ? mac6 : NULL, pool, &opts);
+        hostpool_close(pool);
+        journal_close(jr);
+        return rc;
+    }
+
+    // One controller: try the interfaces found last time before enumerating.
+    static devcache dc;
+    char dc_def[512];
+    if (use_devcache && !devcache_file) {
+        if (default_app_file(SIXAXIS_DEVCACHE_FILE, dc_def, sizeof(dc_def))) devcache_file = dc_def;
+        else use_devcache = 0; // no per-user folder: enumerate every time
+    }
+    if (use_devcache) devcache_load(&dc, devcache_file);
 
-    if (ok && argc == 2) puts("MAC set OK (unplug/replug USB if readback shows zeros).");
-    return ok ? 0 : 3;
+    sixaxis_device d;
+    memset(&d, 0, sizeof(d));
+    const sixaxis_selector *want = selecting ? &sel : NULL;
+    int found = use_devcache ? devcache_select(&dc, tp, want, &d, NULL)
+              : want ? sixaxis_select(tp, want, &d.info) : find_sony_hid(tp, &d.info);
+    if (!found) {
+        if (use_devcache) devcache_save(&dc, devcache_file);
+        if (selecting) fprintf(stderr, "No attached Sony HID matches the selection.\n");
+        else fprintf(stderr, "Sony HID not found on USB. Plug the controller by USB (not BT).\n");
+        hostpool_close(pool);
+        journal_close(jr);
+        return 2;
+    }
+    if (pool && !hostpool_assign(pool, &d.info, mac6)) {
+        fprintf(stderr, "Every host adapter is full.\n");
+        hostpool_close(pool);
+        journal_close(jr);
+        return 3;
+    }
+    int set = mac_str || pool;
+    sixaxis_process_one(tp, &d, set ? mac6 : NULL, &opts);
+    if (use_devcache) {
+        devcache_note(&dc, &d.info, d.feat_len, d.report_len);
+        devcache_save(&dc, devcache_file); // best effort: a stale cache only costs an enumeration
+    }
+    journal_device(&d);
+    journal_close(jr);
+    if (pool) {
+        char mac[18];
+        format_mac(mac6, mac);
+        printf("Host adapter %s\n", mac);
+        hostpool_commit(pool, &d.info, paired(d.result));
+        hostpool_close(pool);
+    }
+
+    if (d.result == SIXAXIS_SET_FAILED || d.result == SIXAXIS_SET_TIMEOUT) {
+        fprintf(stderr, "%s\n", d.err);
+        return 3;
+    }
+    if (!set) {
+        char mac[18];
+        format_mac(d.mac, mac);
+        puts(mac);
+    } else if (d.result == SIXAXIS_SET_UNCHANGED) {
+        puts("MAC unchanged (already set).");
+    } else if (d.result == SIXAXIS_SET_VERIFIED) {
+        puts("MAC set and verified.");
+    } else {
+        printf("MAC set but not verified: %s (unplug/replug USB and read again).\n", d.err);
+        return 4;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int rc = run(argc, argv);
+    if (stats_json) sixaxis_stats_write_json(stderr);
+    write_prom();
+    if (trace_file) {
+        char err[256];
+        if (!sixaxis_trace_write(trace_file, err, sizeof(err))) fprintf(stderr, "%s\n", err);
+    }
+    if (record_file) {
+        char err[256];
+        if (!hid_capture_stop(err, sizeof(err))) fprintf(stderr, "%s\n", err);
+    }
+    if (replay_file && strcmp(tp->name, "replay") == 0) { // loaded
+        hid_replay_stats st;
+        hid_replay_get_stats(&st);
+        fprintf(stderr, "replay: %lu of %lu recorded calls served, %lu divergences\n",
+                st.replayed, st.records, st.divergences);
+    }
+    return rc;
 }
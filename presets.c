@@ -0,0 +1,281 @@
+// presets.c — see presets.h.
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "presets.h"
+#include "sixaxis_pair.h"
+
+// Entries stay in the order first saved; a deleted one is only marked dead
+// (and revived in place if saved again) until compaction drops it.
+typedef struct {
+    char     name[PRESET_NAME_MAX];
+    uint32_t hash;
+    uint8_t  mac[6];
+    uint8_t  live;
+} entry;
+
+struct preset_store {
+    char     *file;
+    FILE     *log;     // opened by the first change
+    entry    *entries;
+    size_t    n, cap;
+    uint32_t *slots;   // entry index + 1, 0 = empty; at most half full
+    size_t    mask;    // slot count - 1
+    size_t    live;
+    size_t    lines;   // preset lines in the file, live or stale
+};
+
+static char lower(char c) { return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c; }
+
+// FNV-1a over the ASCII-lowercased name.
+static uint32_t hash_name(const char *name) {
+    uint32_t h = 2166136261u;
+    for (const char *p = name; *p; p++) h = (h ^ (uint8_t)lower(*p)) * 16777619u;
+    return h;
+}
+
+static int same_name(const char *a, const char *b) {
+    while (*a && lower(*a) == lower(*b)) a++, b++;
+    return lower(*a) == lower(*b);
+}
+
+static uint32_t *probe(const preset_store *s, const char *name, uint32_t h) {
+    for (size_t i = h & s->mask;; i = (i + 1) & s->mask) {
+        uint32_t *slot = &s->slots[i];
+        if (!*slot) return slot;
+        const entry *e = &s->entries[*slot - 1];
+        if (e->hash == h && same_name(e->name, name)) return slot;
+    }
+}
+
+static entry *find(const preset_store *s, const char *name) {
+    uint32_t *slot = probe(s, name, hash_name(name));
+    return *slot && s->entries[*slot - 1].live ? &s->entries[*slot - 1] : NULL;
+}
+
+static int rehash(preset_store *s, size_t slots) {
+    uint32_t *t = (uint32_t *)calloc(slots, sizeof(*t));
+    if (!t) return 0;
+    free(s->slots);
+    s->slots = t;
+    s->mask = slots - 1;
+    for (size_t i = 0; i < s->n; i++) *probe(s, s->entries[i].name, s->entries[i].hash) = (uint32_t)(i + 1);
+    return 1;
+}
+
+// In memory only. Returns 1 if name is new, 0 if it replaced one, -1 out of memory.
+static int set_entry(preset_store *s, const char *name, const uint8_t mac6[6]) {
+    uint32_t h = hash_name(name);
+    uint32_t *slot = probe(s, name, h);
+    if (*slot) {
+        entry *e = &s->entries[*slot - 1];
+        int added = !e->live;
+        memcpy(e->mac, mac6, 6);
+        e->live = 1;
+        s->live += (size_t)added;
+        return added;
+    }
+    if (s->n == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 32;
+        entry *e = (entry *)realloc(s->entries, cap * sizeof(*e));
+        if (!e) return -1;
+        s->entries = e;
+        s->cap = cap;
+    }
+    if ((s->n + 1) * 2 > s->mask + 1) {
+        if (!rehash(s, (s->mask + 1) * 2)) return -1;
+        slot = probe(s, name, h);
+    }
+    entry *e = &s->entries[s->n];
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    e->hash = h;
+    memcpy(e->mac, mac6, 6);
+    e->live = 1;
+    *slot = (uint32_t)++s->n;
+    s->live++;
+    return 1;
+}
+
+static int drop_entry(preset_store *s, const char *name) {
+    entry *e = find(s, name);
+    if (!e) return 0;
+    e->live = 0;
+    s->live--;
+    return 1;
+}
+
+static int valid_name(const char *name) {
+    size_t n = strlen(name);
+    return n > 0 && n < PRESET_NAME_MAX && !strpbrk(name, "=\r\n");
+}
+
+// ---------- file ----------
+static char *read_text(const char *file) {
+    FILE *f = fopen(file, "rb");
+    if (!f) return NULL;
+    char *text = NULL;
+    long size;
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0
+        && (text = (char *)malloc((size_t)size + 1)) != NULL) {
+        size_t got = fread(text, 1, (size_t)size, f);
+        text[got] = 0;
+    }
+    fclose(f);
+    return text;
+}
+
+// Lines with a name that is too long or a MAC that does not parse are
+// ignored, as the old loader did with lines lacking '='.
+static int load(preset_store *s, char *text) {
+    char *line = text;
+    if (strncmp(line, "\xEF\xBB\xBF", 3) == 0) line += 3; // BOM from the old _wfopen(ccs=UTF-8) writer
+    for (char *next; line && *line; line = next) {
+        next = strchr(line, '\n');
+        if (next) *next++ = 0;
+        line[strcspn(line, "\r")] = 0;
+        char *eq = strchr(line, '=');
+        if (!eq) continue;
+        *eq = 0;
+        uint8_t mac6[6];
+        if (!valid_name(line)) continue;
+        if (!eq[1]) drop_entry(s, line);
+        else if (!parse_mac(eq + 1, mac6)) continue;
+        else if (set_entry(s, line, mac6) < 0) return 0;
+        s->lines++;
+    }
+    return 1;
+}
+
+static int replace_file(const char *tmp, const char *file) {
+#ifdef _WIN32
+    return MoveFileExA(tmp, file, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(tmp, file) == 0;
+#endif
+}
+
+// Writes the live presets to <file>.tmp, renames it over the file and drops
+// dead entries from memory. On failure the log stays as it was.
+static int compact(preset_store *s, char *err, size_t errlen) {
+    size_t len = strlen(s->file);
+    char *tmp = (char *)malloc(len + 5);
+    FILE *f = NULL;
+    if (tmp) {
+        memcpy(tmp, s->file, len);
+        memcpy(tmp + len, ".tmp", 5);
+        f = fopen(tmp, "wb");
+    }
+    int ok = f != NULL;
+    for (size_t i = 0; ok && i < s->n; i++) {
+        char mac[18];
+        if (!s->entries[i].live) continue;
+        format_mac(s->entries[i].mac, mac);
+        ok = fprintf(f, "%s=%s\n", s->entries[i].name, mac) > 0;
+    }
+    if (f && fclose(f) != 0) ok = 0;
+    if (ok) {
+        if (s->log) fclose(s->log);
+        ok = replace_file(tmp, s->file);
+        s->log = fopen(s->file, "ab");
+    }
+    if (!ok || !s->log) {
+        if (tmp) remove(tmp);
+        free(tmp);
+        snprintf(err, errlen, "cannot compact presets '%s'", s->file);
+        return 0;
+    }
+    free(tmp);
+
+    size_t k = 0;
+    for (size_t i = 0; i < s->n; i++)
+        if (s->entries[i].live) s->entries[k++] = s->entries[i];
+    s->n = k;
+    s->lines = k;
+    return rehash(s, s->mask + 1);
+}
+
+static int maybe_compact(preset_store *s, char *err, size_t errlen) {
+    size_t stale = s->lines - s->live;
+    return stale < PRESETS_COMPACT_MIN || stale <= s->live || compact(s, err, errlen);
+}
+
+// mac6 NULL appends a delete.
+static int append(preset_store *s, const char *name, const uint8_t *mac6, char *err, size_t errlen) {
+    char mac[18] = "";
+    if (mac6) format_mac(mac6, mac);
+    if (!s->log) s->log = fopen(s->file, "ab"); // first change: only lookups never create the file
+    if (!s->log || fprintf(s->log, "%s=%s\n", name, mac) < 0 || fflush(s->log) != 0) {
+        snprintf(err, errlen, "cannot write presets '%s'", s->file);
+        return 0;
+    }
+    s->lines++;
+    return maybe_compact(s, err, errlen);
+}
+
+// ---------- API ----------
+preset_store *presets_open(const char *file, char *err, size_t errlen) {
+    preset_store *s = (preset_store *)calloc(1, sizeof(*s));
+    char *text = read_text(file);
+    int ok = s && (s->file = (char *)malloc(strlen(file) + 1)) != NULL && rehash(s, 64);
+    if (ok) strcpy(s->file, file);
+    if (ok && text) ok = load(s, text);
+    free(text);
+    if (!ok) {
+        snprintf(err, errlen, "out of memory loading presets '%s'", file);
+        presets_close(s);
+        return NULL;
+    }
+    return s;
+}
+
+void presets_close(preset_store *s) {
+    if (!s) return;
+    if (s->log) fclose(s->log);
+    free(s->entries);
+    free(s->slots);
+    free(s->file);
+    free(s);
+}
+
+size_t presets_count(const preset_store *s) {
+    return s->live;
+}
+
+int presets_find(const preset_store *s, const char *name, uint8_t mac6[6]) {
+    const entry *e = find(s, name);
+    if (e) memcpy(mac6, e->mac, 6);
+    return e != NULL;
+}
+
+int presets_put(preset_store *s, const char *name, const uint8_t mac6[6], int *added,
+                char *err, size_t errlen) {
+    if (!valid_name(name)) {
+        snprintf(err, errlen, "bad preset name (1-%d bytes of UTF-8, no '=')", PRESET_NAME_MAX - 1);
+        return 0;
+    }
+    int r = set_entry(s, name, mac6);
+    if (r < 0) {
+        snprintf(err, errlen, "out of memory");
+        return 0;
+    }
+    if (added) *added = r;
+    return append(s, name, mac6, err, errlen);
+}
+
+int presets_remove(preset_store *s, const char *name, char *err, size_t errlen) {
+    if (!drop_entry(s, name)) return 0;
+    return append(s, name, NULL, err, errlen);
+}
+
+void presets_each(const preset_store *s, preset_cb cb, void *user) {
+    for (size_t i = 0; i < s->n; i++)
+        if (s->entries[i].live && cb(s->entries[i].name, s->entries[i].mac, user)) return;
+}
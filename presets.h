@@ -0,0 +1,45 @@
+// presets.h — named host MACs, shared by the GUI and --preset.
+//
+// The file keeps the "name=mac" lines earlier versions wrote, but is now a
+// log: the last line for a name wins and "name=" deletes it. It is read once
+// into a hash index on the name (ASCII case-insensitive), and each save or
+// delete appends a single line instead of rewriting the file. Once stale
+// lines outnumber live presets the file is compacted: written out to
+// "<file>.tmp" and renamed over the original.
+//
+// Changes other processes append are seen on the next presets_open.
+
+#ifndef PRESETS_H
+#define PRESETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PRESET_NAME_CHARS   63   // UTF-16 units the GUI's name box takes
+// Bytes including the NUL: a UTF-16 unit takes at most 3 bytes of UTF-8
+// (a surrogate pair 4 for 2), so any name the GUI accepts fits.
+#define PRESET_NAME_MAX     (PRESET_NAME_CHARS * 3 + 1)
+#define PRESETS_COMPACT_MIN 64   // stale lines tolerated whatever the live count
+
+typedef struct preset_store preset_store;
+
+// Loads file (UTF-8, a missing file is an empty store); the first change
+// opens it for appending. Returns NULL with a reason in err.
+preset_store *presets_open(const char *file, char *err, size_t errlen);
+void          presets_close(preset_store *s);
+
+size_t presets_count(const preset_store *s);
+// Copies the MAC saved under name into mac6; 0 if there is none.
+int    presets_find(const preset_store *s, const char *name, uint8_t mac6[6]);
+// Adds or replaces name (no '=' or line breaks, shorter than PRESET_NAME_MAX).
+// *added tells which (may be NULL). Returns 0 with a reason in err.
+int    presets_put(preset_store *s, const char *name, const uint8_t mac6[6], int *added,
+                   char *err, size_t errlen);
+// Returns 1 if name existed and is now gone, 0 otherwise (err set on I/O errors).
+int    presets_remove(preset_store *s, const char *name, char *err, size_t errlen);
+
+// Calls cb for every preset in the order first saved; stops once cb returns nonzero.
+typedef int (*preset_cb)(const char *name, const uint8_t mac6[6], void *user);
+void   presets_each(const preset_store *s, preset_cb cb, void *user);
+
+#endif // PRESETS_H
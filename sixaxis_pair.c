@@ -0,0 +1,545 @@
+// sixaxis_pair.c — DS3/DS4 pairing logic shared by the CLI and the benchmarks.
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <errno.h>
+#  include <time.h>
+#endif
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hubsched.h"
+#include "sixaxis_pair.h"
+#include "sixaxis_stats.h"
+#include "sixaxis_trace.h"
+#include "workpool.h"
+
+// ---------- PID classification ----------
+// Thin views of the profile table (sixaxis_profile.c), Sony VID implied.
+static int kind_is(uint16_t pid, sixaxis_kind kind) {
+    const sixaxis_profile *p = sixaxis_profile_find(SONY_VID, pid);
+    return p && p->kind == kind;
+}
+int is_ds3_pid(uint16_t pid)            { return kind_is(pid, SIXAXIS_KIND_DS3); }
+int is_ds4_controller_pid(uint16_t pid) { return kind_is(pid, SIXAXIS_KIND_DS4); }
+int is_ds4_dongle_pid(uint16_t pid)     { return kind_is(pid, SIXAXIS_KIND_DONGLE); }
+uint8_t pick_report_id(uint16_t pid) {
+    return sixaxis_profile_for(SONY_VID, pid)->report_id;
+}
+
+// ---------- small utils ----------
+static int char_to_nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+int mac_to_bytes(const char* in, size_t in_len, uint8_t out6[6]) {
+    size_t i = 0;
+    for (size_t p = 0; p + 1 < in_len && i < 6; ) {
+        if (in[p] == ':') { p++; continue; }
+        int hi = char_to_nibble(in[p]);
+        int lo = char_to_nibble(in[p+1]);
+        if (hi < 0 || lo < 0) return 0;
+        out6[i++] = (uint8_t)((hi << 4) | lo);
+        p += 2;
+    }
+    return i == 6;
+}
+int parse_mac(const char *s, uint8_t out6[6]) {
+    size_t L = strlen(s);
+    return ((L==12)||(L==17)) && mac_to_bytes(s, L, out6);
+}
+void format_mac(const uint8_t *b, char out[18]) {
+    snprintf(out, 18, "%02x:%02x:%02x:%02x:%02x:%02x", b[0], b[1], b[2], b[3], b[4], b[5]);
+}
+
+// ---------- device open (prefer controller) ----------
+int sony_rank(uint16_t pid) {
+    return sixaxis_profile_for(SONY_VID, pid)->rank;
+}
+
+typedef struct {
+    hid_device_info best;
+    int             rank;
+} sony_pick;
+
+static int pick_cb(const hid_device_info *d, void *user) {
+    sony_pick *p = (sony_pick *)user;
+    int r = sony_rank(d->pid);
+    if (r < p->rank) { p->best = *d; p->rank = r; }
+    return p->rank == 0; // first DS4 controller cannot be beaten
+}
+
+// tp->enumerate and tp->lookup, timed as SIXAXIS_PHASE_ENUMERATE.
+static int enumerate(const hid_transport *tp, hid_enum_cb cb, void *user) {
+    uint64_t t0 = sixaxis_stats_begin();
+    int n = tp->enumerate(SONY_VID, cb, user);
+    sixaxis_stats_end(SIXAXIS_PHASE_ENUMERATE, t0, n >= 0, 0, NULL);
+    return n;
+}
+
+static int lookup(const hid_transport *tp, const char *path, hid_device_info *out) {
+    uint64_t t0 = sixaxis_stats_begin();
+    int ok = tp->lookup(path, out);
+    sixaxis_stats_end(SIXAXIS_PHASE_ENUMERATE, t0, ok, 0, NULL);
+    return ok;
+}
+
+int find_sony_hid(const hid_transport *tp, hid_device_info *out) {
+    sony_pick p;
+    p.rank = 4;
+    if (enumerate(tp, pick_cb, &p) <= 0 || p.rank == 4) return 0;
+    *out = p.best;
+    return 1;
+}
+
+int open_sony_hid(const hid_transport *tp, sixaxis_session *s, char *err, size_t errlen) {
+    hid_device_info d;
+    s->h = HID_INVALID_HANDLE;
+    if (!find_sony_hid(tp, &d)) return 0;
+    return sixaxis_session_open(s, tp, &d, err, errlen) ? 1 : -1;
+}
+
+// Serials compare like manifest keys: case-insensitive, separators ignored.
+static int same_serial(const char *a, const char *b) {
+    for (;; a++, b++) {
+        while (*a == ':' || *a == '-' || *a == ' ') a++;
+        while (*b == ':' || *b == '-' || *b == ' ') b++;
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b)) return 0;
+        if (!*a) return 1;
+    }
+}
+
+int sixaxis_selector_match(const sixaxis_selector *sel, const hid_device_info *d) {
+    return d->vid == SONY_VID && (!sel->pid || d->pid == sel->pid) &&
+           (!sel->serial || same_serial(d->serial, sel->serial));
+}
+
+typedef struct {
+    const sixaxis_selector *sel;
+    int                     seen;   // matching controllers passed over for index
+    hid_device_info        *out;
+    int                     found;
+} select_ctx;
+
+static int select_cb(const hid_device_info *d, void *user) {
+    select_ctx *c = (select_ctx *)user;
+    if (!sixaxis_selector_match(c->sel, d)) return 0;
+    if (c->sel->index >= 0 && (sony_rank(d->pid) > 1 || c->seen++ != c->sel->index)) return 0;
+    *c->out = *d;
+    c->found = 1;
+    return 1;
+}
+
+int sixaxis_select(const hid_transport *tp, const sixaxis_selector *sel, hid_device_info *out) {
+    if (sel->path) return lookup(tp, sel->path, out) && sixaxis_selector_match(sel, out);
+    select_ctx c = { sel, 0, out, 0 };
+    enumerate(tp, select_cb, &c);
+    return c.found;
+}
+
+// ---------- sessions ----------
+static int attach(sixaxis_session *s, const hid_transport *tp, hid_handle h,
+                  const hid_device_info *d, uint16_t feat_len, uint16_t report_len,
+                  char *err, size_t errlen) {
+    memset(s, 0, sizeof(*s));
+    s->tp        = tp;
+    s->h         = h;
+    s->info      = *d;
+    s->hub       = -1;
+    s->profile   = sixaxis_profile_for(d->vid, d->pid);
+    if (!s->profile) {
+        snprintf(err, errlen, "%04x:%04x is not a supported controller", d->vid, d->pid);
+        return 0;
+    }
+    s->report_id = s->profile->report_id;
+    uint16_t need = (uint16_t)(s->profile->mac_offset + 6);
+    if (feat_len >= need && feat_len <= SIXAXIS_REPORT_MAX && report_len >= need && report_len <= feat_len) {
+        s->feat_len = feat_len;
+        s->report_len = report_len;
+        return 1;
+    }
+    uint64_t t0 = sixaxis_stats_begin();
+    if (!feature_lengths(tp, h, &s->feat_len) || s->feat_len < need) {
+        s->last_err = tp->last_error();
+        sixaxis_stats_end(SIXAXIS_PHASE_CAPS, t0, 0, 0, d);
+        snprintf(err, errlen, "Could not query FeatureReportByteLength");
+        return 0;
+    }
+    if (s->feat_len > SIXAXIS_REPORT_MAX) {
+        sixaxis_stats_end(SIXAXIS_PHASE_CAPS, t0, 0, 0, d);
+        snprintf(err, errlen, "feature reports of %u bytes exceed %u",
+                 (unsigned)s->feat_len, (unsigned)SIXAXIS_REPORT_MAX);
+        return 0;
+    }
+    // Transfer only the bytes the pairing report declares: from the device's
+    // descriptor, else the profile, else the caps maximum. Transports that
+    // always move the caps maximum (HID_TF_FULL_LENGTH) are not asked.
+    if (tp->flags & HID_TF_FULL_LENGTH)
+        s->report_len = s->feat_len;
+    else if (!tp->report_length(h, s->report_id, &s->report_len) || s->report_len < need)
+        s->report_len = s->profile->report_len;
+    if (s->report_len < need || s->report_len > s->feat_len)
+        s->report_len = s->feat_len;
+    sixaxis_stats_end(SIXAXIS_PHASE_CAPS, t0, 1, 0, d);
+    return 1;
+}
+
+int sixaxis_session_attach(sixaxis_session *s, const hid_transport *tp, hid_handle h,
+                           const hid_device_info *d, char *err, size_t errlen) {
+    return attach(s, tp, h, d, 0, 0, err, errlen);
+}
+
+int sixaxis_session_open(sixaxis_session *s, const hid_transport *tp,
+                         const hid_device_info *d, char *err, size_t errlen) {
+    return sixaxis_session_open_known(s, tp, d, 0, 0, err, errlen);
+}
+
+int sixaxis_session_open_known(sixaxis_session *s, const hid_transport *tp,
+                               const hid_device_info *d, uint16_t feat_len, uint16_t report_len,
+                               char *err, size_t errlen) {
+    uint64_t t0 = sixaxis_stats_begin();
+    hid_handle h = tp->open(d->path);
+    if (h == HID_INVALID_HANDLE) {
+        s->h = HID_INVALID_HANDLE;
+        s->last_err = tp->last_error();
+        sixaxis_stats_end(SIXAXIS_PHASE_OPEN, t0, 0, s->last_err == HID_ERR_TIMEOUT, d);
+        if (s->last_err == HID_ERR_TIMEOUT) snprintf(err, errlen, "%s: open timed out", tp->name);
+        else snprintf(err, errlen, "%s: open failed (err=%lu)", tp->name, s->last_err);
+        return 0;
+    }
+    sixaxis_stats_end(SIXAXIS_PHASE_OPEN, t0, 1, 0, d);
+    if (!attach(s, tp, h, d, feat_len, report_len, err, errlen)) {
+        tp->close(h);
+        s->h = HID_INVALID_HANDLE;
+        return 0;
+    }
+    return 1;
+}
+
+void sixaxis_session_close(sixaxis_session *s) {
+    if (s->h != HID_INVALID_HANDLE) s->tp->close(s->h);
+    s->h = HID_INVALID_HANDLE;
+}
+
+// ---------- feature I/O ----------
+int feature_lengths(const hid_transport *tp, hid_handle h, uint16_t *out_feat_len) {
+    return tp->feature_length(h, out_feat_len);
+}
+
+// A transfer the hub refused as busy is tried again, this many times, as
+// soon as the lowered hub limit lets it run.
+#define BUSY_RETRIES 3
+
+// A device that rejects the exact length falls back to the caps maximum for
+// the rest of the session; one that timed out is not asked again. Each call
+// holds one of its hub's transfer slots, if the session has a hub limit.
+static int xfer_feature(sixaxis_session *s, uint8_t *buf, uint16_t len, int set) {
+    int ok;
+    for (unsigned tries = 0;; tries++) {
+        unsigned beside = s->hubs ? hubsched_enter(s->hubs, s->hub) : 0;
+        uint64_t t0 = sixaxis_stats_begin();
+        ok = set ? s->tp->set_feature(s->h, buf, len) : s->tp->get_feature(s->h, buf, len);
+        if (!ok) s->last_err = s->tp->last_error();
+        if (!ok && len < s->feat_len && s->last_err != HID_ERR_TIMEOUT && s->last_err != HID_ERR_BUSY) {
+            s->report_len = len = s->feat_len;
+            ok = set ? s->tp->set_feature(s->h, buf, len) : s->tp->get_feature(s->h, buf, len);
+            if (!ok) s->last_err = s->tp->last_error();
+        }
+        sixaxis_stats_end(set ? SIXAXIS_PHASE_SET : SIXAXIS_PHASE_GET, t0, ok,
+                          !ok && s->last_err == HID_ERR_TIMEOUT, &s->info);
+        int busy = !ok && s->last_err == HID_ERR_BUSY;
+        if (s->hubs) hubsched_leave(s->hubs, s->hub, beside, busy || (!ok && s->last_err == HID_ERR_TIMEOUT));
+        if (!busy || !s->hubs || tries == BUSY_RETRIES) return ok;
+    }
+}
+
+// Some stacks (hidclass) insist on the full caps length in both directions.
+static uint16_t xfer_len(const sixaxis_session *s) {
+    return (s->tp->flags & HID_TF_FULL_LENGTH) ? s->feat_len : s->report_len;
+}
+
+static void xfer_error(const sixaxis_session *s, const char *what, char *err, size_t errlen) {
+    if (s->last_err == HID_ERR_TIMEOUT)
+        snprintf(err, errlen, "%s: %s timed out", s->tp->name, what);
+    else
+        snprintf(err, errlen, "%s: %s failed (err=%lu)", s->tp->name, what, s->last_err);
+}
+
+int do_set_mac(sixaxis_session *s, const uint8_t mac6[6], char *err, size_t errlen) {
+    memset(s->buf, 0, s->feat_len);
+    s->buf[0] = s->report_id;
+    sixaxis_profile_put_mac(s->profile, s->buf, mac6);
+
+    if (!xfer_feature(s, s->buf, xfer_len(s), 1)) {
+        xfer_error(s, "SetFeature", err, errlen);
+        return 0;
+    }
+    return 1;
+}
+
+int do_get_mac(sixaxis_session *s, uint8_t mac6[6], char *err, size_t errlen) {
+    memset(s->buf, 0, s->feat_len);
+    s->buf[0] = s->report_id;
+
+    if (!xfer_feature(s, s->buf, xfer_len(s), 0)) {
+        xfer_error(s, "GetFeature", err, errlen);
+        return 0;
+    }
+    sixaxis_profile_get_mac(s->profile, s->buf, mac6);
+    return 1;
+}
+
+// ---------- verified set ----------
+static void sleep_ms(unsigned ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec ts = { (time_t)(ms / 1000u), (long)(ms % 1000u) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+#endif
+}
+
+static sixaxis_set_result set_verified(sixaxis_session *s, const uint8_t mac6[6],
+                                       const sixaxis_verify_policy *pol,
+                                       char *err, size_t errlen) {
+    static const sixaxis_verify_policy defaults = SIXAXIS_VERIFY_DEFAULT;
+    static const uint8_t zeros[6];
+    if (!pol) pol = &defaults;
+    unsigned attempts = pol->attempts ? pol->attempts : 1;
+    unsigned wait = pol->backoff_ms;
+    int written = 0, rewrite = 1;
+
+    for (unsigned a = 0; a < attempts; a++) {
+        if (a > 0) {
+            uint64_t tb = sixaxis_trace_begin();
+            if (s->tp->wait_ms) s->tp->wait_ms(wait);
+            else sleep_ms(wait);
+            if (tb) sixaxis_trace_span("backoff", tb, sixaxis_clock_ns(), &s->info, NULL);
+            wait = wait * 2 > pol->max_backoff_ms ? pol->max_backoff_ms : wait * 2;
+        }
+        if (rewrite) {
+            if (!do_set_mac(s, mac6, err, errlen)) {
+                if (s->last_err == HID_ERR_TIMEOUT) return SIXAXIS_SET_TIMEOUT;
+                continue;
+            }
+            written = 1;
+            rewrite = 0;
+        }
+
+        uint8_t back[6];
+        char m[18];
+        if (!do_get_mac(s, back, err, errlen)) {
+            // a device that stops answering is not worth the remaining backoff
+            if (s->last_err == HID_ERR_TIMEOUT) return SIXAXIS_SET_TIMEOUT;
+            continue;
+        }
+        if (memcmp(back, mac6, 6) == 0) return SIXAXIS_SET_VERIFIED;
+        format_mac(back, m);
+        snprintf(err, errlen, "readback %s after %u tries", m, a + 1);
+        rewrite = memcmp(back, zeros, 6) != 0; // zeros: not applied yet
+    }
+    return written ? SIXAXIS_SET_UNVERIFIED : SIXAXIS_SET_FAILED;
+}
+
+sixaxis_set_result do_set_mac_verified(sixaxis_session *s, const uint8_t mac6[6],
+                                       const sixaxis_verify_policy *pol,
+                                       char *err, size_t errlen) {
+    uint64_t t0 = sixaxis_stats_begin();
+    sixaxis_set_result r = set_verified(s, mac6, pol, err, errlen);
+    sixaxis_stats_end(SIXAXIS_PHASE_VERIFY, t0, r == SIXAXIS_SET_VERIFIED, r == SIXAXIS_SET_TIMEOUT, &s->info);
+    return r;
+}
+
+sixaxis_set_result do_update_mac(sixaxis_session *s, const uint8_t mac6[6],
+                                 const sixaxis_verify_policy *pol,
+                                 char *err, size_t errlen) {
+    s->has_old_mac = do_get_mac(s, s->old_mac, err, errlen);
+    if (s->has_old_mac) {
+        if (memcmp(s->old_mac, mac6, 6) == 0) return SIXAXIS_SET_UNCHANGED;
+    } else if (s->last_err == HID_ERR_TIMEOUT) {
+        return SIXAXIS_SET_TIMEOUT;
+    }
+    return do_set_mac_verified(s, mac6, pol, err, errlen);
+}
+
+const char *sixaxis_set_result_name(sixaxis_set_result r) {
+    switch (r) {
+        case SIXAXIS_SET_UNCHANGED:  return "unchanged";
+        case SIXAXIS_SET_TIMEOUT:    return "timeout";
+        case SIXAXIS_SET_VERIFIED:   return "verified";
+        case SIXAXIS_SET_UNVERIFIED: return "unverified";
+        default:                     return "failed";
+    }
+}
+
+// ---------- batch API ----------
+typedef struct {
+    sixaxis_device *devs;
+    size_t          count, max;
+} enum_ctx;
+
+static int enum_cb(const hid_device_info *d, void *user) {
+    enum_ctx *c = (enum_ctx *)user;
+    if (sony_rank(d->pid) > 1) return 0; // controllers only
+    if (c->count < c->max) {
+        memset(&c->devs[c->count], 0, sizeof(c->devs[c->count]));
+        c->devs[c->count].info = *d;
+    }
+    c->count++;
+    return 0;
+}
+
+size_t sixaxis_enumerate(const hid_transport *tp, sixaxis_device *devs, size_t max) {
+    enum_ctx c = { devs, 0, max };
+    enumerate(tp, enum_cb, &c);
+    return c.count;
+}
+
+static int succeeded(sixaxis_set_result r) {
+    return r == SIXAXIS_SET_VERIFIED || r == SIXAXIS_SET_UNCHANGED;
+}
+
+static void pair_device(const hid_transport *tp, sixaxis_device *dev, const uint8_t *mac6,
+                        const sixaxis_batch_opts *opts, hubsched *hubs, int hub) {
+    static const sixaxis_verify_policy defaults = SIXAXIS_VERIFY_DEFAULT;
+    const sixaxis_verify_policy *pol = opts && opts->verify.attempts ? &opts->verify : &defaults;
+    sixaxis_session s;
+    uint64_t t0 = sixaxis_clock_ns();
+
+    dev->result = SIXAXIS_SET_FAILED;
+    dev->err[0] = 0;
+    dev->has_old_mac = 0;
+    if (mac6) memcpy(dev->mac, mac6, 6);
+    if (!sixaxis_session_open_known(&s, tp, &dev->info, dev->feat_len, dev->report_len,
+                                    dev->err, sizeof(dev->err))) {
+        if (s.last_err == HID_ERR_TIMEOUT) dev->result = SIXAXIS_SET_TIMEOUT;
+        if (mac6) sixaxis_stats_result(dev->result);
+        dev->latency_us = (uint32_t)((sixaxis_clock_ns() - t0) / 1000);
+        return;
+    }
+    s.hubs = hubs;
+    s.hub = hub;
+    if (!mac6) {
+        if (do_get_mac(&s, dev->mac, dev->err, sizeof(dev->err))) dev->result = SIXAXIS_SET_VERIFIED;
+        else if (s.last_err == HID_ERR_TIMEOUT) dev->result = SIXAXIS_SET_TIMEOUT;
+    } else if (opts && opts->force) {
+        dev->result = do_set_mac_verified(&s, mac6, pol, dev->err, sizeof(dev->err));
+    } else {
+        dev->result = do_update_mac(&s, mac6, pol, dev->err, sizeof(dev->err));
+        dev->has_old_mac = (uint8_t)s.has_old_mac;
+        memcpy(dev->old_mac, s.old_mac, 6);
+    }
+    if (mac6) sixaxis_stats_result(dev->result);
+    dev->feat_len = s.feat_len;     // report_len may have fallen back to feat_len
+    dev->report_len = s.report_len;
+    sixaxis_session_close(&s);
+    dev->latency_us = (uint32_t)((sixaxis_clock_ns() - t0) / 1000);
+}
+
+// One trace span per device around its phases.
+static void process(const hid_transport *tp, sixaxis_device *dev, const uint8_t *mac6,
+                    const sixaxis_batch_opts *opts, hubsched *hubs, int hub) {
+    uint64_t t0 = sixaxis_trace_begin();
+    pair_device(tp, dev, mac6, opts, hubs, hub);
+    if (t0) {
+        const char *r = !mac6 && dev->result == SIXAXIS_SET_VERIFIED ? "read" : sixaxis_set_result_name(dev->result);
+        sixaxis_trace_span(mac6 ? "pair" : "read", t0, sixaxis_clock_ns(), &dev->info, r);
+    }
+}
+
+void sixaxis_process_one(const hid_transport *tp, sixaxis_device *dev,
+                         const uint8_t *mac6, const sixaxis_batch_opts *opts) {
+    process(tp, dev, mac6, opts, NULL, -1);
+}
+
+// Work item i of a batch: the device, its hub and its place among the
+// devices of that hub (round).
+typedef struct {
+    size_t   dev;
+    int      hub;
+    unsigned round;
+} batch_item;
+
+typedef struct {
+    const hid_transport      *tp;
+    sixaxis_device           *devs;
+    const uint8_t            *mac6;
+    int                       own_mac; // each device's target is in devs[i].mac
+    const sixaxis_batch_opts *opts;
+    hubsched                 *hubs;    // NULL: no hub limit, items in index order
+    batch_item               *items;
+} batch_ctx;
+
+static void batch_one(size_t i, void *user) {
+    batch_ctx *b = (batch_ctx *)user;
+    const batch_item *it = b->items ? &b->items[i] : NULL;
+    sixaxis_device *d = &b->devs[it ? it->dev : i];
+    uint8_t target[6];
+    if (b->own_mac) memcpy(target, d->mac, 6);
+    process(b->tp, d, b->own_mac ? target : b->mac6, b->opts, b->hubs, it ? it->hub : -1);
+    if (b->opts && b->opts->on_done) b->opts->on_done(d, b->opts->user);
+}
+
+static int by_round(const void *x, const void *y) {
+    const batch_item *a = (const batch_item *)x, *b = (const batch_item *)y;
+    if (a->round != b->round) return a->round < b->round ? -1 : 1;
+    return (a->dev > b->dev) - (a->dev < b->dev);
+}
+
+// First device of every hub, then the second of every hub, and so on, so no
+// worker waits on a full hub while another hub has nothing in flight. Without
+// memory for the schedule the batch runs unlimited, in index order.
+static void schedule(batch_ctx *b, size_t n, unsigned per_hub) {
+    if (per_hub == SIXAXIS_PER_HUB_UNLIMITED || n < 2) return;
+    b->hubs = hubsched_new(per_hub);
+    b->items = (batch_item *)malloc(n * sizeof(*b->items));
+    if (!b->hubs || !b->items) {
+        hubsched_free(b->hubs);
+        free(b->items);
+        b->hubs = NULL;
+        b->items = NULL;
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        batch_item *it = &b->items[i];
+        it->dev = i;
+        it->hub = hubsched_add(b->hubs, b->devs[i].info.port);
+        it->round = it->hub < 0 ? 0 : hubsched_devices(b->hubs, it->hub) - 1;
+    }
+    qsort(b->items, n, sizeof(*b->items), by_round);
+}
+
+static size_t run_many(const hid_transport *tp, const uint8_t *mac6, int own_mac,
+                       sixaxis_device *devs, size_t n, const sixaxis_batch_opts *opts) {
+    batch_ctx b = { tp, devs, mac6, own_mac, opts, NULL, NULL };
+    size_t ok = 0;
+    schedule(&b, n, opts && opts->per_hub ? opts->per_hub : SIXAXIS_DEFAULT_PER_HUB);
+    workpool_run(n, opts && opts->jobs ? opts->jobs : SIXAXIS_DEFAULT_JOBS, batch_one, &b);
+    hubsched_free(b.hubs);
+    free(b.items);
+    for (size_t i = 0; i < n; i++) ok += succeeded(devs[i].result);
+    return ok;
+}
+
+size_t sixaxis_read_many(const hid_transport *tp, sixaxis_device *devs, size_t n,
+                         const sixaxis_batch_opts *opts) {
+    return run_many(tp, NULL, 0, devs, n, opts);
+}
+
+size_t sixaxis_set_many(const hid_transport *tp, const uint8_t mac6[6],
+                        sixaxis_device *devs, size_t n, const sixaxis_batch_opts *opts) {
+    return run_many(tp, mac6, 0, devs, n, opts);
+}
+
+size_t sixaxis_assign_many(const hid_transport *tp, sixaxis_device *devs, size_t n,
+                           const sixaxis_batch_opts *opts) {
+    return run_many(tp, NULL, 1, devs, n, opts);
+}
@@ -0,0 +1,188 @@
+// sixaxis_pair.h — DS3/DS4 pairing logic on top of hid_transport.h.
+//
+// Controllers store the Bluetooth host MAC in a feature report whose ID,
+// layout and byte order come from the profile table (sixaxis_profile.h).
+// MACs passed to and from these functions are always in display order
+// (aa:bb:cc:dd:ee:ff -> {aa,...,ff}).
+
+#ifndef SIXAXIS_PAIR_H
+#define SIXAXIS_PAIR_H
+
+#include "hid_transport.h"
+#include "sixaxis_profile.h"
+
+// ---------- PID classification (Sony VID, from the profile table) ----------
+int     is_ds3_pid(uint16_t pid);
+int     is_ds4_controller_pid(uint16_t pid);
+int     is_ds4_dongle_pid(uint16_t pid);
+uint8_t pick_report_id(uint16_t pid);
+// Preference: 0 DS4 controller, 1 DS3/Move, 2 other Sony, 3 DS4 dongle.
+int     sony_rank(uint16_t pid);
+
+// ---------- MAC strings ----------
+int  mac_to_bytes(const char* in, size_t in_len, uint8_t out6[6]);
+// Accepts 112233445566 or 11:22:33:44:55:66.
+int  parse_mac(const char *s, uint8_t out6[6]);
+void format_mac(const uint8_t *b, char out[18]);
+
+// Per-operation deadline the tools give the transport (hid_transport.set_timeout).
+#define SIXAXIS_DEFAULT_TIMEOUT_MS 3000
+
+// Largest feature report a session accepts (DS3 49, DS4 64 bytes). Reports
+// are built in the session itself, so get/set never touch the heap.
+#define SIXAXIS_REPORT_MAX 512
+
+// ---------- sessions ----------
+// An open device plus everything learned about it once: its profile, the
+// feature length from the HID caps and the exact length of the pairing
+// report. Reads and writes through a session cost only the feature transfers
+// and allocate nothing.
+typedef struct {
+    const hid_transport   *tp;
+    hid_handle             h;          // HID_INVALID_HANDLE when closed
+    hid_device_info        info;
+    const sixaxis_profile *profile;    // table row, looked up once at open
+    uint8_t                report_id;
+    uint16_t               feat_len;   // largest feature report (caps)
+    uint16_t               report_len; // report_id only; profile/caps when unknown
+    unsigned long          last_err;   // transport error of the last failed call
+    uint8_t                old_mac[6]; // what do_update_mac found before writing ...
+    int                    has_old_mac; // ... if it could read it
+    uint8_t                buf[SIXAXIS_REPORT_MAX]; // report scratch for get/set
+    struct hubsched       *hubs;       // per-hub transfer cap (hubsched.h), NULL = none ...
+    int                    hub;        // ... and this device's hub there
+} sixaxis_session;
+
+// Opens d->path and queries caps. On failure s->h is HID_INVALID_HANDLE and
+// s->last_err holds the transport error (HID_ERR_TIMEOUT past the deadline).
+int  sixaxis_session_open(sixaxis_session *s, const hid_transport *tp,
+                          const hid_device_info *d, char *err, size_t errlen);
+// Same with the lengths an earlier session of this device measured (e.g.
+// from devcache.h): no caps or descriptor queries. Out-of-range lengths, or
+// 0, are queried as usual.
+int  sixaxis_session_open_known(sixaxis_session *s, const hid_transport *tp,
+                                const hid_device_info *d, uint16_t feat_len, uint16_t report_len,
+                                char *err, size_t errlen);
+// Same for a handle the caller already opened; the session takes ownership.
+int  sixaxis_session_attach(sixaxis_session *s, const hid_transport *tp, hid_handle h,
+                            const hid_device_info *d, char *err, size_t errlen);
+void sixaxis_session_close(sixaxis_session *s);
+
+// ---------- device selection ----------
+// Enumerates Sony interfaces and picks the preferred one (lowest sony_rank).
+int find_sony_hid(const hid_transport *tp, hid_device_info *out);
+// find_sony_hid + sixaxis_session_open. Returns 1 when open, 0 when no Sony
+// device is attached, -1 when the pick could not be opened (reason in err).
+int open_sony_hid(const hid_transport *tp, sixaxis_session *s, char *err, size_t errlen);
+
+// One specific interface instead of the preferred one. Every field set must
+// match; index counts only controllers (no dongles) that match the rest.
+typedef struct {
+    const char *path;    // opened directly through tp->lookup, no enumeration
+    const char *serial;  // USB serial, ignoring case and ':'/'-'/' ' separators
+    uint16_t    pid;     // 0 = any
+    int         index;   // n-th attached controller from 0, as --all lists them; -1 = any
+} sixaxis_selector;
+
+#define SIXAXIS_SELECT_ANY { NULL, NULL, 0, -1 }
+
+// The serial and PID criteria of sel (path and index are positional).
+int sixaxis_selector_match(const sixaxis_selector *sel, const hid_device_info *d);
+// Fills *out with the interface sel names. A path is looked up alone; the
+// others enumerate Sony interfaces and stop at the first match. Returns 0
+// when nothing matches.
+int sixaxis_select(const hid_transport *tp, const sixaxis_selector *sel, hid_device_info *out);
+
+// ---------- feature I/O ----------
+// All return 1 on success; on failure a one-line reason is left in err.
+int feature_lengths(const hid_transport *tp, hid_handle h, uint16_t *out_feat_len);
+int do_set_mac(sixaxis_session *s, const uint8_t mac6[6], char *err, size_t errlen);
+int do_get_mac(sixaxis_session *s, uint8_t mac6[6], char *err, size_t errlen);
+
+// ---------- verified set ----------
+typedef enum {
+    SIXAXIS_SET_FAILED     = 0, // no SetFeature was accepted
+    SIXAXIS_SET_VERIFIED   = 1, // readback matches the requested MAC
+    SIXAXIS_SET_UNVERIFIED = 2, // written, but readback never matched (replug and re-read)
+    SIXAXIS_SET_UNCHANGED  = 3, // already held the MAC, nothing written
+    SIXAXIS_SET_TIMEOUT    = 4, // a transfer ran past the transport deadline; no retries
+} sixaxis_set_result;
+
+typedef struct {
+    unsigned attempts;        // readbacks before giving up, at least 1
+    unsigned backoff_ms;      // wait before the second readback, doubled after each miss
+    unsigned max_backoff_ms;  // cap on a single wait
+} sixaxis_verify_policy;
+
+#define SIXAXIS_VERIFY_DEFAULT { 5, 20, 500 }
+
+// Writes mac6, reads the report back and compares. A readback of zeros is
+// only re-read (firmware still settling); a different MAC or a failed write is
+// written again. On anything but VERIFIED the last reason is left in err.
+sixaxis_set_result do_set_mac_verified(sixaxis_session *s, const uint8_t mac6[6],
+                                       const sixaxis_verify_policy *pol,
+                                       char *err, size_t errlen);
+// Compare-then-write: reads the current MAC first (kept in s->old_mac) and
+// returns UNCHANGED without a SetFeature when it already matches; otherwise
+// (or when the read fails) behaves like do_set_mac_verified.
+sixaxis_set_result do_update_mac(sixaxis_session *s, const uint8_t mac6[6],
+                                 const sixaxis_verify_policy *pol,
+                                 char *err, size_t errlen);
+const char *sixaxis_set_result_name(sixaxis_set_result r);
+
+// ---------- batch API ----------
+// For station software pairing many controllers per call: everything comes
+// back in caller-provided structs, no process per controller, no stdout.
+typedef struct {
+    hid_device_info    info;      // in: device to work on (sixaxis_enumerate fills it)
+    uint8_t            mac[6];    // out: MAC read, or the one requested for a set
+    sixaxis_set_result result;    // out: a successful read reports VERIFIED
+    char               err[128];  // out: reason unless VERIFIED/UNCHANGED
+    uint8_t            old_mac[6]; // out: MAC held before a set, when has_old_mac
+    uint8_t            has_old_mac;
+    uint32_t           latency_us; // out: open to close
+    uint16_t           feat_len;   // in: known lengths (sixaxis_session_open_known), 0 = query;
+    uint16_t           report_len; // out: the ones the session ended up using
+} sixaxis_device;
+
+// Called on the worker thread as soon as one device is done, e.g. to stream
+// results; calls from different workers may run concurrently.
+typedef void (*sixaxis_done_fn)(const sixaxis_device *dev, void *user);
+
+typedef struct {
+    unsigned              jobs;     // devices in flight, 0 = SIXAXIS_DEFAULT_JOBS
+    sixaxis_verify_policy verify;   // attempts == 0 = SIXAXIS_VERIFY_DEFAULT
+    int                   force;    // write even when the MAC already matches
+    sixaxis_done_fn       on_done;  // optional
+    void                 *user;     // passed to on_done
+    unsigned              per_hub;  // most feature transfers in flight per USB hub; each hub
+                                    // finds its own limit below it (hubsched.h), 0 = SIXAXIS_DEFAULT_PER_HUB
+} sixaxis_batch_opts;
+
+#define SIXAXIS_DEFAULT_JOBS      16
+// Where every hub starts: above what a USB 2.0 hub's control pipe carries, so
+// the first congested transfers measure each hub's own limit (hubsched.h)
+// rather than a guess holding it down.
+#define SIXAXIS_DEFAULT_PER_HUB   8
+#define SIXAXIS_PER_HUB_UNLIMITED 0xFFFFFFFFu
+
+// Lists attached controllers (no dongles or other Sony interfaces) into
+// devs[0..max). Returns how many are attached, which may exceed max.
+size_t sixaxis_enumerate(const hid_transport *tp, sixaxis_device *devs, size_t max);
+// One device: open a session, then read (mac6 NULL) or compare/write/verify.
+void   sixaxis_process_one(const hid_transport *tp, sixaxis_device *dev,
+                           const uint8_t *mac6, const sixaxis_batch_opts *opts);
+// sixaxis_process_one over devs[0..n) on up to opts->jobs threads (opts may
+// be NULL), at most opts->per_hub transfers at a time per USB hub. Devices are
+// started hub by hub in turn so every hub is busy from the first wave; results
+// stay at their index. Return the number read, or set/verified/unchanged,
+// successfully.
+size_t sixaxis_read_many(const hid_transport *tp, sixaxis_device *devs, size_t n,
+                         const sixaxis_batch_opts *opts);
+size_t sixaxis_set_many(const hid_transport *tp, const uint8_t mac6[6],
+                        sixaxis_device *devs, size_t n, const sixaxis_batch_opts *opts);
+// Like sixaxis_set_many, but each device gets its own target: devs[i].mac on entry.
+size_t sixaxis_assign_many(const hid_transport *tp, sixaxis_device *devs, size_t n,
+                           const sixaxis_batch_opts *opts);
+
+#endif // SIXAXIS_PAIR_H
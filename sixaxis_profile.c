@@ -0,0 +1,90 @@
+// sixaxis_profile.c — see sixaxis_profile.h.
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+#include <stddef.h>
+
+#include "hid_transport.h"
+#include "sixaxis_profile.h"
+
+// DS3/Move keep the host MAC in report 0xF5, forward at [2..7]; the DS4 family
+// uses report 0x12 with the MAC reversed at [2..7].
+static const sixaxis_profile profiles[] = {
+    // vid       pid     kind                 name                                   id    off rev len rank
+    { SONY_VID, 0x05C4, SIXAXIS_KIND_DS4,    "DualShock 4 (old)",                    0x12, 2, 1, 16, 0 },
+    { SONY_VID, 0x09CC, SIXAXIS_KIND_DS4,    "DualShock 4 (new)",                    0x12, 2, 1, 16, 0 },
+    { SONY_VID, 0x0CE6, SIXAXIS_KIND_DS4,    "DualShock 4 Slim (some fw)",           0x12, 2, 1, 16, 0 },
+    { SONY_VID, 0x0CDA, SIXAXIS_KIND_DS4,    "DualShock 4 (variant seen in wild)",   0x12, 2, 1, 16, 0 },
+    { SONY_VID, 0x0268, SIXAXIS_KIND_DS3,    "Sixaxis / DualShock 3",                0xF5, 2, 0,  8, 1 },
+    { SONY_VID, 0x042F, SIXAXIS_KIND_DS3,    "Move Motion Controller",               0xF5, 2, 0,  8, 1 },
+    { SONY_VID, 0x0BA0, SIXAXIS_KIND_DONGLE, "DUALSHOCK 4 USB Wireless Adaptor",     0x12, 2, 1, 16, 3 },
+};
+#define NPROFILES (sizeof(profiles) / sizeof(profiles[0]))
+
+static const sixaxis_profile other_sony =
+    { SONY_VID, 0, SIXAXIS_KIND_OTHER, "Sony HID", 0x12, 2, 1, 16, 2 };
+
+// ---------- index ----------
+// Open addressing over (vid << 16 | pid); slots hold row index + 1. Kept at
+// most half full so probes stay short.
+#define SLOTS 64
+typedef char slots_fit_table[NPROFILES * 2 <= SLOTS ? 1 : -1];
+
+static uint8_t slots[SLOTS];
+
+static unsigned slot_of(uint32_t key) {
+    return (unsigned)((key * 2654435761u) >> 26); // top 6 bits: 0..63
+}
+
+static void build_index(void) {
+    for (size_t i = 0; i < NPROFILES; i++) {
+        unsigned k = slot_of((uint32_t)profiles[i].vid << 16 | profiles[i].pid);
+        while (slots[k]) k = (k + 1) % SLOTS;
+        slots[k] = (uint8_t)(i + 1);
+    }
+}
+
+#ifdef _WIN32
+static INIT_ONCE index_once = INIT_ONCE_STATIC_INIT;
+static BOOL CALLBACK build_index_once(PINIT_ONCE o, PVOID p, PVOID *ctx) {
+    (void)o; (void)p; (void)ctx;
+    build_index();
+    return TRUE;
+}
+static void ensure_index(void) { InitOnceExecuteOnce(&index_once, build_index_once, NULL, NULL); }
+#else
+static pthread_once_t index_once = PTHREAD_ONCE_INIT;
+static void ensure_index(void) { pthread_once(&index_once, build_index); }
+#endif
+
+// ---------- lookup ----------
+const sixaxis_profile *sixaxis_profile_find(uint16_t vid, uint16_t pid) {
+    ensure_index();
+    for (unsigned k = slot_of((uint32_t)vid << 16 | pid); slots[k]; k = (k + 1) % SLOTS) {
+        const sixaxis_profile *p = &profiles[slots[k] - 1];
+        if (p->vid == vid && p->pid == pid) return p;
+    }
+    return NULL;
+}
+
+const sixaxis_profile *sixaxis_profile_for(uint16_t vid, uint16_t pid) {
+    const sixaxis_profile *p = sixaxis_profile_find(vid, pid);
+    if (!p && vid == SONY_VID) p = &other_sony;
+    return p;
+}
+
+void sixaxis_profile_put_mac(const sixaxis_profile *p, uint8_t *report, const uint8_t mac6[6]) {
+    uint8_t *dst = report + p->mac_offset;
+    for (int i = 0; i < 6; i++) dst[i] = mac6[p->mac_reversed ? 5 - i : i];
+}
+
+void sixaxis_profile_get_mac(const sixaxis_profile *p, const uint8_t *report, uint8_t mac6[6]) {
+    const uint8_t *src = report + p->mac_offset;
+    for (int i = 0; i < 6; i++) mac6[p->mac_reversed ? 5 - i : i] = src[i];
+}
@@ -0,0 +1,43 @@
+// sixaxis_profile.h — one constant table describing every supported device.
+//
+// A row holds everything the pairing code needs to know about a VID/PID:
+// kind, the feature report carrying the host MAC, where the MAC sits in it
+// and in which byte order, the report length and the selection preference.
+// Supporting a new PID or a variant seen in the field is a one-row change in
+// sixaxis_profile.c.
+
+#ifndef SIXAXIS_PROFILE_H
+#define SIXAXIS_PROFILE_H
+
+#include <stdint.h>
+
+typedef enum {
+    SIXAXIS_KIND_DS3,     // Sixaxis / DualShock 3 / Move
+    SIXAXIS_KIND_DS4,     // DualShock 4 controllers
+    SIXAXIS_KIND_DONGLE,  // DS4 USB wireless adaptor
+    SIXAXIS_KIND_OTHER,   // unknown Sony interface, treated like a DS4
+} sixaxis_kind;
+
+typedef struct {
+    uint16_t     vid, pid;
+    sixaxis_kind kind;
+    const char  *name;
+    uint8_t      report_id;     // feature report holding the host MAC
+    uint8_t      mac_offset;    // first MAC byte in that report
+    uint8_t      mac_reversed;  // 1 = stored last byte first
+    uint16_t     report_len;    // report ID byte included
+    uint8_t      rank;          // selection preference, lower first
+} sixaxis_profile;
+
+// Row for vid/pid, or NULL when the device is not in the table. O(1): a hash
+// index over the table is built on first use.
+const sixaxis_profile *sixaxis_profile_find(uint16_t vid, uint16_t pid);
+// Row for a device that is not in the table: Sony VID gets the DS4 layout
+// with rank 2, anything else NULL.
+const sixaxis_profile *sixaxis_profile_for(uint16_t vid, uint16_t pid);
+
+// Copy a display-order MAC into / out of a feature report laid out per p.
+void sixaxis_profile_put_mac(const sixaxis_profile *p, uint8_t *report, const uint8_t mac6[6]);
+void sixaxis_profile_get_mac(const sixaxis_profile *p, const uint8_t *report, uint8_t mac6[6]);
+
+#endif // SIXAXIS_PROFILE_H
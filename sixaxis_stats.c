@@ -0,0 +1,282 @@
+// sixaxis_stats.c — see sixaxis_stats.h.
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <time.h>
+#endif
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hubsched.h"
+#include "sixaxis_stats.h"
+#include "sixaxis_trace.h"
+
+static const double bucket_s[SIXAXIS_STATS_BUCKETS] = {
+    0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+typedef struct {
+    uint64_t count, errors, timeouts;
+    uint64_t sum_ns, max_ns;
+    uint64_t buckets[SIXAXIS_STATS_BUCKETS + 1];
+} phase_stats;
+
+typedef struct {
+    char     key[HID_PORT_MAX];
+    uint64_t transfers, errors, timeouts, sum_ns;
+} hub_stats;
+
+#define RESULT_COUNT 5 // sixaxis_set_result values
+
+static volatile int enabled;
+static phase_stats  phases[SIXAXIS_PHASE_COUNT];
+static hub_stats    hubs[SIXAXIS_STATS_MAX_HUBS + 1]; // the last one is "other"
+static size_t       nhubs;
+static uint64_t     results[RESULT_COUNT];
+
+#ifdef _WIN32
+static SRWLOCK lock = SRWLOCK_INIT;
+static void lock_stats(void)   { AcquireSRWLockExclusive(&lock); }
+static void unlock_stats(void) { ReleaseSRWLockExclusive(&lock); }
+#else
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static void lock_stats(void)   { pthread_mutex_lock(&lock); }
+static void unlock_stats(void) { pthread_mutex_unlock(&lock); }
+#endif
+
+uint64_t sixaxis_clock_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER f;
+    LARGE_INTEGER c;
+    if (!f.QuadPart) QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return (uint64_t)(c.QuadPart / f.QuadPart) * 1000000000u
+         + (uint64_t)(c.QuadPart % f.QuadPart) * 1000000000u / (uint64_t)f.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void sixaxis_stats_enable(int on) {
+    enabled = on;
+}
+
+int sixaxis_stats_enabled(void) {
+    return enabled;
+}
+
+const char *sixaxis_phase_name(sixaxis_phase ph) {
+    static const char *const names[SIXAXIS_PHASE_COUNT] = {
+        "enumerate", "open", "caps", "get", "set", "verify"
+    };
+    return (unsigned)ph < SIXAXIS_PHASE_COUNT ? names[ph] : "?";
+}
+
+// ---------- recording ----------
+uint64_t sixaxis_stats_begin(void) {
+    if (!enabled && !sixaxis_trace_enabled()) return 0;
+    uint64_t t = sixaxis_clock_ns();
+    return t ? t : 1;
+}
+
+// Called with the lock held.
+static hub_stats *hub_of(const char *port) {
+    char key[HID_PORT_MAX];
+    if (!port || !hubsched_key(port, key)) return NULL;
+    for (size_t i = 0; i < nhubs; i++)
+        if (strcmp(hubs[i].key, key) == 0) return &hubs[i];
+    if (nhubs == SIXAXIS_STATS_MAX_HUBS) {
+        snprintf(hubs[nhubs].key, sizeof(hubs[nhubs].key), "other");
+        return &hubs[nhubs];
+    }
+    memcpy(hubs[nhubs].key, key, sizeof(key));
+    return &hubs[nhubs++];
+}
+
+void sixaxis_stats_end(sixaxis_phase ph, uint64_t t0, int ok, int timed_out,
+                       const hid_device_info *dev) {
+    if (!t0 || (unsigned)ph >= SIXAXIS_PHASE_COUNT) return;
+    uint64_t t1 = sixaxis_clock_ns(), ns = t1 - t0;
+    if (sixaxis_trace_enabled())
+        sixaxis_trace_span(sixaxis_phase_name(ph), t0, t1, dev, ok ? NULL : timed_out ? "timeout" : "failed");
+    if (!enabled) return;
+    int b = 0;
+    while (b < SIXAXIS_STATS_BUCKETS && (double)ns > bucket_s[b] * 1e9) b++;
+
+    lock_stats();
+    phase_stats *p = &phases[ph];
+    p->count++;
+    p->errors += !ok;
+    p->timeouts += !ok && timed_out;
+    p->sum_ns += ns;
+    if (ns > p->max_ns) p->max_ns = ns;
+    p->buckets[b]++;
+    if (ph == SIXAXIS_PHASE_GET || ph == SIXAXIS_PHASE_SET) {
+        hub_stats *h = hub_of(dev ? dev->port : NULL);
+        if (h) {
+            h->transfers++;
+            h->errors += !ok;
+            h->timeouts += !ok && timed_out;
+            h->sum_ns += ns;
+        }
+    }
+    unlock_stats();
+}
+
+void sixaxis_stats_result(sixaxis_set_result r) {
+    if (!enabled || (unsigned)r >= RESULT_COUNT) return;
+    lock_stats();
+    results[r]++;
+    unlock_stats();
+}
+
+// ---------- output ----------
+typedef struct {
+    phase_stats phases[SIXAXIS_PHASE_COUNT];
+    hub_stats   hubs[SIXAXIS_STATS_MAX_HUBS + 1];
+    size_t      nhubs;
+    uint64_t    results[RESULT_COUNT];
+} snapshot;
+
+static void take(snapshot *s) {
+    lock_stats();
+    memcpy(s->phases, phases, sizeof(phases));
+    memcpy(s->hubs, hubs, sizeof(hubs));
+    s->nhubs = nhubs + (hubs[SIXAXIS_STATS_MAX_HUBS].transfers != 0 && nhubs == SIXAXIS_STATS_MAX_HUBS);
+    memcpy(s->results, results, sizeof(results));
+    unlock_stats();
+}
+
+// Hub keys come from device strings: keep quotes and backslashes from
+// breaking either format.
+static void put_label(FILE *f, const char *s) {
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        fputc((unsigned char)*s < 0x20 ? ' ' : *s, f);
+    }
+}
+
+void sixaxis_stats_write_json(FILE *f) {
+    snapshot s;
+    take(&s);
+    fputs("{\"phases\":{", f);
+    for (int ph = 0; ph < SIXAXIS_PHASE_COUNT; ph++) {
+        const phase_stats *p = &s.phases[ph];
+        fprintf(f, "%s\"%s\":{\"count\":%llu,\"errors\":%llu,\"timeouts\":%llu,"
+                   "\"sum_ms\":%.3f,\"max_ms\":%.3f,\"buckets_ms\":[",
+                ph ? "," : "", sixaxis_phase_name((sixaxis_phase)ph),
+                (unsigned long long)p->count, (unsigned long long)p->errors,
+                (unsigned long long)p->timeouts, (double)p->sum_ns / 1e6, (double)p->max_ns / 1e6);
+        for (int b = 0; b < SIXAXIS_STATS_BUCKETS; b++) fprintf(f, "%s%g", b ? "," : "", bucket_s[b] * 1e3);
+        fputs("],\"counts\":[", f);
+        for (int b = 0; b <= SIXAXIS_STATS_BUCKETS; b++)
+            fprintf(f, "%s%llu", b ? "," : "", (unsigned long long)p->buckets[b]);
+        fputs("]}", f);
+    }
+    fputs("},\"results\":{", f);
+    for (int r = 0; r < RESULT_COUNT; r++)
+        fprintf(f, "%s\"%s\":%llu", r ? "," : "", sixaxis_set_result_name((sixaxis_set_result)r),
+                (unsigned long long)s.results[r]);
+    fputs("},\"hubs\":[", f);
+    for (size_t i = 0; i < s.nhubs; i++) {
+        const hub_stats *h = &s.hubs[i];
+        fprintf(f, "%s{\"hub\":\"", i ? "," : "");
+        put_label(f, h->key);
+        fprintf(f, "\",\"transfers\":%llu,\"errors\":%llu,\"timeouts\":%llu,\"sum_ms\":%.3f}",
+                (unsigned long long)h->transfers, (unsigned long long)h->errors,
+                (unsigned long long)h->timeouts, (double)h->sum_ns / 1e6);
+    }
+    fputs("]}\n", f);
+}
+
+// field: offset of a hub_stats counter; seconds converts a sum of nanoseconds.
+static void prom_hub_counter(FILE *f, const snapshot *s, const char *name, const char *help,
+                             size_t field, int seconds) {
+    fprintf(f, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+    for (size_t i = 0; i < s->nhubs; i++) {
+        uint64_t v = *(const uint64_t *)((const char *)&s->hubs[i] + field);
+        fprintf(f, "%s{hub=\"", name);
+        put_label(f, s->hubs[i].key);
+        if (seconds) fprintf(f, "\"} %.6f\n", (double)v / 1e9);
+        else fprintf(f, "\"} %llu\n", (unsigned long long)v);
+    }
+}
+
+static void write_prometheus(FILE *f, const snapshot *s) {
+    fputs("# HELP sixaxis_phase_seconds Time per pairing phase.\n"
+          "# TYPE sixaxis_phase_seconds histogram\n", f);
+    for (int ph = 0; ph < SIXAXIS_PHASE_COUNT; ph++) {
+        const phase_stats *p = &s->phases[ph];
+        const char *name = sixaxis_phase_name((sixaxis_phase)ph);
+        uint64_t cum = 0;
+        for (int b = 0; b < SIXAXIS_STATS_BUCKETS; b++) {
+            cum += p->buckets[b];
+            fprintf(f, "sixaxis_phase_seconds_bucket{phase=\"%s\",le=\"%g\"} %llu\n",
+                    name, bucket_s[b], (unsigned long long)cum);
+        }
+        fprintf(f, "sixaxis_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %llu\n"
+                   "sixaxis_phase_seconds_sum{phase=\"%s\"} %.6f\n"
+                   "sixaxis_phase_seconds_count{phase=\"%s\"} %llu\n",
+                name, (unsigned long long)p->count, name, (double)p->sum_ns / 1e9,
+                name, (unsigned long long)p->count);
+    }
+    fputs("# HELP sixaxis_phase_errors_total Failed phases, timeouts included.\n"
+          "# TYPE sixaxis_phase_errors_total counter\n", f);
+    for (int ph = 0; ph < SIXAXIS_PHASE_COUNT; ph++)
+        fprintf(f, "sixaxis_phase_errors_total{phase=\"%s\"} %llu\n",
+                sixaxis_phase_name((sixaxis_phase)ph), (unsigned long long)s->phases[ph].errors);
+    fputs("# HELP sixaxis_phase_timeouts_total Phases cut off by the transport deadline.\n"
+          "# TYPE sixaxis_phase_timeouts_total counter\n", f);
+    for (int ph = 0; ph < SIXAXIS_PHASE_COUNT; ph++)
+        fprintf(f, "sixaxis_phase_timeouts_total{phase=\"%s\"} %llu\n",
+                sixaxis_phase_name((sixaxis_phase)ph), (unsigned long long)s->phases[ph].timeouts);
+    fputs("# HELP sixaxis_results_total Outcomes of MAC writes.\n"
+          "# TYPE sixaxis_results_total counter\n", f);
+    for (int r = 0; r < RESULT_COUNT; r++)
+        fprintf(f, "sixaxis_results_total{result=\"%s\"} %llu\n",
+                sixaxis_set_result_name((sixaxis_set_result)r), (unsigned long long)s->results[r]);
+    prom_hub_counter(f, s, "sixaxis_hub_transfers_total", "Feature transfers per USB hub.",
+                     offsetof(hub_stats, transfers), 0);
+    prom_hub_counter(f, s, "sixaxis_hub_transfer_errors_total", "Failed feature transfers per USB hub.",
+                     offsetof(hub_stats, errors), 0);
+    prom_hub_counter(f, s, "sixaxis_hub_transfer_timeouts_total", "Feature transfers per USB hub past the deadline.",
+                     offsetof(hub_stats, timeouts), 0);
+    prom_hub_counter(f, s, "sixaxis_hub_transfer_seconds_total", "Time in feature transfers per USB hub.",
+                     offsetof(hub_stats, sum_ns), 1);
+}
+
+int sixaxis_stats_write_prometheus(const char *file, char *err, size_t errlen) {
+    snapshot s;
+    char tmp[1024];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", file) >= (int)sizeof(tmp)) {
+        snprintf(err, errlen, "stats path too long");
+        return 0;
+    }
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        snprintf(err, errlen, "cannot write '%s'", tmp);
+        return 0;
+    }
+    take(&s);
+    write_prometheus(f, &s);
+    int ok = !ferror(f);
+    if (fclose(f) != 0) ok = 0;
+#ifdef _WIN32
+    if (ok) ok = MoveFileExA(tmp, file, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    if (ok) ok = rename(tmp, file) == 0;
+#endif
+    if (!ok) {
+        remove(tmp);
+        snprintf(err, errlen, "cannot replace '%s'", file);
+    }
+    return ok;
+}
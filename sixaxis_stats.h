@@ -0,0 +1,56 @@
+// sixaxis_stats.h — per-phase timings of the pairing path.
+//
+// The core times enumeration, open, caps query, each GetFeature/SetFeature
+// and the whole verified write on a monotonic clock into fixed histograms,
+// counts set outcomes, and keeps transfer counts and time per USB hub so a
+// hub going bad stands out from the station average. Recording is off until
+// sixaxis_stats_enable; then it costs two clock reads and a short lock per
+// phase, next to transfers that take milliseconds.
+//
+// Output: JSON (the CLI's --stats=json) or the Prometheus text format,
+// written to "<file>.tmp" and renamed over file so a node exporter's textfile
+// collector never reads half a file.
+
+#ifndef SIXAXIS_STATS_H
+#define SIXAXIS_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sixaxis_pair.h"
+
+typedef enum {
+    SIXAXIS_PHASE_ENUMERATE, // enumeration or lookup of interfaces
+    SIXAXIS_PHASE_OPEN,
+    SIXAXIS_PHASE_CAPS,      // feature lengths, when not known from the device cache
+    SIXAXIS_PHASE_GET,       // one GetFeature (with its full-length fallback)
+    SIXAXIS_PHASE_SET,       // one SetFeature
+    SIXAXIS_PHASE_VERIFY,    // write + readbacks of do_set_mac_verified
+    SIXAXIS_PHASE_COUNT
+} sixaxis_phase;
+
+// Histogram upper bounds in seconds; one more bucket holds everything slower.
+#define SIXAXIS_STATS_BUCKETS 14
+#define SIXAXIS_STATS_MAX_HUBS 64   // later hubs are counted as "other"
+
+void sixaxis_stats_enable(int on);
+int  sixaxis_stats_enabled(void);
+
+// begin returns 0 while neither stats nor the trace (sixaxis_trace.h) is on,
+// and end ignores a 0 start, so nothing reads the clock then. dev (may be
+// NULL) attributes GET/SET to its hub and labels the trace span.
+uint64_t sixaxis_stats_begin(void);
+void     sixaxis_stats_end(sixaxis_phase ph, uint64_t t0, int ok, int timed_out,
+                           const hid_device_info *dev);
+// Outcome of one compare-then-write or forced write.
+void     sixaxis_stats_result(sixaxis_set_result r);
+
+const char *sixaxis_phase_name(sixaxis_phase ph);
+// The monotonic clock both recorders use, in nanoseconds.
+uint64_t    sixaxis_clock_ns(void);
+
+void sixaxis_stats_write_json(FILE *f);
+// Returns 0 with a reason in err when the file cannot be written.
+int  sixaxis_stats_write_prometheus(const char *file, char *err, size_t errlen);
+
+#endif // SIXAXIS_STATS_H
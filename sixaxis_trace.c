@@ -0,0 +1,186 @@
+// sixaxis_trace.c — see sixaxis_trace.h.
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <stdatomic.h>
+#endif
+#ifdef _MSC_VER
+#  define TRACE_TLS __declspec(thread)
+#else
+#  define TRACE_TLS _Thread_local
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sixaxis_stats.h"
+#include "sixaxis_trace.h"
+
+#define LABEL_MAX 64
+
+typedef struct {
+    const char *name, *detail;
+    uint64_t    t0, t1;
+    uint16_t    pid;
+    char        label[LABEL_MAX]; // serial, else port, else path; "" = no device
+} span;
+
+typedef struct chunk {
+    struct chunk *next;
+    unsigned      lane;  // trace thread id, shared by all chunks of a thread
+    size_t        n;
+    span          spans[SIXAXIS_TRACE_CHUNK];
+} chunk;
+
+static volatile int     on;
+static uint64_t         start_ns;
+static TRACE_TLS chunk *mine;
+static TRACE_TLS unsigned my_lane;
+#ifdef _WIN32
+static chunk * volatile head;
+static volatile LONG    chunks, lanes, dropped;
+#else
+static _Atomic(chunk *) head;
+static atomic_long      chunks, lanes, dropped;
+#endif
+
+void sixaxis_trace_enable(void) {
+    if (!start_ns) start_ns = sixaxis_clock_ns();
+    on = 1;
+}
+
+int sixaxis_trace_enabled(void) {
+    return on;
+}
+
+uint64_t sixaxis_trace_begin(void) {
+    if (!on) return 0;
+    uint64_t t = sixaxis_clock_ns();
+    return t ? t : 1;
+}
+
+static void push(chunk *c) {
+#ifdef _WIN32
+    chunk *old;
+    do {
+        old = head;
+        c->next = old;
+    } while (InterlockedCompareExchangePointer((PVOID volatile *)&head, c, old) != old);
+#else
+    chunk *old = atomic_load(&head);
+    do c->next = old; while (!atomic_compare_exchange_weak(&head, &old, c));
+#endif
+}
+
+// The calling thread's buffer with room for one span, or NULL past the cap.
+static chunk *room(void) {
+    if (mine && mine->n < SIXAXIS_TRACE_CHUNK) return mine;
+#ifdef _WIN32
+    if (InterlockedIncrement(&chunks) > SIXAXIS_TRACE_MAX_CHUNKS) return NULL;
+    if (!my_lane) my_lane = (unsigned)InterlockedIncrement(&lanes);
+#else
+    if (atomic_fetch_add(&chunks, 1) >= SIXAXIS_TRACE_MAX_CHUNKS) return NULL;
+    if (!my_lane) my_lane = (unsigned)atomic_fetch_add(&lanes, 1) + 1;
+#endif
+    chunk *c = (chunk *)malloc(sizeof(*c));
+    if (!c) return NULL;
+    c->lane = my_lane;
+    c->n = 0;
+    push(c); // listed while still filling; only read after the workers finish
+    return mine = c;
+}
+
+void sixaxis_trace_span(const char *name, uint64_t t0, uint64_t t1,
+                        const hid_device_info *dev, const char *detail) {
+    if (!on || !t0) return;
+    chunk *c = room();
+    if (!c) {
+#ifdef _WIN32
+        InterlockedIncrement(&dropped);
+#else
+        atomic_fetch_add(&dropped, 1);
+#endif
+        return;
+    }
+    span *s = &c->spans[c->n];
+    s->name = name;
+    s->detail = detail;
+    s->t0 = t0;
+    s->t1 = t1;
+    s->pid = dev ? dev->pid : 0;
+    s->label[0] = 0;
+    if (dev) {
+        // a long path keeps its tail, where the instance differs
+        const char *l = dev->serial[0] ? dev->serial : dev->port[0] ? dev->port : dev->path;
+        size_t n = strlen(l);
+        if (n >= LABEL_MAX) { l += n - (LABEL_MAX - 1); n = LABEL_MAX - 1; }
+        memcpy(s->label, l, n + 1);
+    }
+    c->n++;
+}
+
+// ---------- output ----------
+static void put_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        fputc((unsigned char)*s < 0x20 ? ' ' : *s, f);
+    }
+    fputc('"', f);
+}
+
+static double rel_us(uint64_t t) {
+    return t > start_ns ? (double)(t - start_ns) / 1e3 : 0.0;
+}
+
+int sixaxis_trace_write(const char *file, char *err, size_t errlen) {
+    FILE *f = fopen(file, "w");
+    if (!f) {
+        snprintf(err, errlen, "cannot write '%s'", file);
+        return 0;
+    }
+#ifdef _WIN32
+    chunk *list = head;
+    long lost = dropped, nlanes = lanes;
+#else
+    chunk *list = atomic_load(&head);
+    long lost = atomic_load(&dropped), nlanes = atomic_load(&lanes);
+#endif
+    int first = 1;
+    fputs("{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_spans\":", f);
+    fprintf(f, "%ld},\"traceEvents\":[\n", lost);
+    for (long lane = 1; lane <= nlanes; lane++) {
+        fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%ld,"
+                   "\"args\":{\"name\":\"thread %ld\"}}", first ? "" : ",\n", lane, lane);
+        first = 0;
+    }
+    for (const chunk *c = list; c; c = c->next) {
+        for (size_t i = 0; i < c->n; i++) {
+            const span *s = &c->spans[i];
+            fprintf(f, "%s{\"ph\":\"X\",\"cat\":\"sixaxis\",\"name\":", first ? "" : ",\n");
+            first = 0;
+            put_string(f, s->name);
+            fprintf(f, ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+                    c->lane, rel_us(s->t0), (double)(s->t1 - s->t0) / 1e3);
+            if (s->label[0]) {
+                fputs("\"device\":", f);
+                put_string(f, s->label);
+                fprintf(f, ",\"pid\":\"%04x\"", s->pid);
+            }
+            if (s->detail) {
+                fputs(s->label[0] ? ",\"result\":" : "\"result\":", f);
+                put_string(f, s->detail);
+            }
+            fputs("}}", f);
+        }
+    }
+    fputs("\n]}\n", f);
+    int ok = !ferror(f);
+    if (fclose(f) != 0) ok = 0;
+    if (!ok) snprintf(err, errlen, "cannot write '%s'", file);
+    return ok;
+}
@@ -0,0 +1,38 @@
+// sixaxis_trace.h — timeline of a pairing run in the Chrome trace format.
+//
+// Every phase sixaxis_stats times (enumeration, open, caps, each get/set,
+// verified write), the verify backoff waits and one "pair" span per device
+// become complete events on the lane of the thread that ran them, labelled
+// with the device. Open the file in chrome://tracing or ui.perfetto.dev to
+// see which controllers overlapped, which waited and where retries went.
+//
+// Each thread appends to its own buffer without locking; full buffers are
+// pushed onto a lock-free list that sixaxis_trace_write walks once the
+// workers are done. While tracing is off a span costs one flag test.
+
+#ifndef SIXAXIS_TRACE_H
+#define SIXAXIS_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hid_transport.h"
+
+#define SIXAXIS_TRACE_CHUNK      1024  // spans per buffer
+#define SIXAXIS_TRACE_MAX_CHUNKS 256   // later spans are dropped and counted
+
+// Turns tracing on for the rest of the process.
+void sixaxis_trace_enable(void);
+int  sixaxis_trace_enabled(void);
+
+// Times on sixaxis_clock_ns. name and detail (may be NULL) must be string
+// literals or otherwise outlive the trace; dev (may be NULL) is copied.
+uint64_t sixaxis_trace_begin(void);   // 0 while off
+void     sixaxis_trace_span(const char *name, uint64_t t0, uint64_t t1,
+                            const hid_device_info *dev, const char *detail);
+
+// Writes every span recorded so far as {"traceEvents":[...]}. Call it when
+// no thread is still recording. Returns 0 with a reason in err.
+int  sixaxis_trace_write(const char *file, char *err, size_t errlen);
+
+#endif // SIXAXIS_TRACE_H
@@ -0,0 +1,83 @@
+// workpool.c — see workpool.h.
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <stdatomic.h>
+#endif
+#include "workpool.h"
+
+#define WORKPOOL_MAX 64
+
+typedef struct {
+    workpool_fn fn;
+    void       *user;
+    size_t      n;
+#ifdef _WIN32
+    volatile LONG next;
+#else
+    atomic_size_t next;
+#endif
+} workpool;
+
+static size_t take(workpool *wp) {
+#ifdef _WIN32
+    return (size_t)InterlockedIncrement(&wp->next) - 1;
+#else
+    return atomic_fetch_add(&wp->next, 1);
+#endif
+}
+
+static void drain(workpool *wp) {
+    for (size_t i = take(wp); i < wp->n; i = take(wp)) wp->fn(i, wp->user);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg) { drain((workpool *)arg); return 0; }
+#else
+static void *worker_main(void *arg) { drain((workpool *)arg); return NULL; }
+#endif
+
+void workpool_run(size_t n, unsigned workers, workpool_fn fn, void *user) {
+    if (n == 0) return;
+    if (workers == 0) workers = 1;
+    if (workers > WORKPOOL_MAX) workers = WORKPOOL_MAX;
+    if (workers > n) workers = (unsigned)n;
+
+    workpool wp;
+    wp.fn = fn; wp.user = user; wp.n = n;
+#ifdef _WIN32
+    wp.next = 0;
+    HANDLE th[WORKPOOL_MAX];
+#else
+    atomic_init(&wp.next, 0);
+    pthread_t th[WORKPOOL_MAX];
+#endif
+
+    // The calling thread is worker 0; spawn the rest.
+    unsigned started = 0;
+    for (unsigned i = 1; i < workers; i++) {
+#ifdef _WIN32
+        th[started] = CreateThread(NULL, 0, worker_main, &wp, 0, NULL);
+        if (th[started] == NULL) break;
+#else
+        if (pthread_create(&th[started], NULL, worker_main, &wp) != 0) break;
+#endif
+        started++;
+    }
+
+    drain(&wp);
+
+    for (unsigned i = 0; i < started; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(th[i], INFINITE);
+        CloseHandle(th[i]);
+#else
+        pthread_join(th[i], NULL);
+#endif
+    }
+}
@@ -0,0 +1,16 @@
+// workpool.h — bounded worker pool over an index range (Win32 threads or pthreads).
+
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <stddef.h>
+
+typedef void (*workpool_fn)(size_t index, void *user);
+
+// Calls fn(i, user) once for every i in [0, n) using at most `workers`
+// threads (the caller included), and returns when all calls have finished.
+// Items are handed out in index order as workers become free. If threads
+// cannot be created, the remaining work runs on fewer of them.
+void workpool_run(size_t n, unsigned workers, workpool_fn fn, void *user);
+
+#endif // WORKPOOL_H